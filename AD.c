@@ -262,6 +262,22 @@ unsigned int AD_ReadADPin(unsigned int Pin)
     return ADValues[PortMapping[TranslatedPin]];
 }
 
+/**
+ * @function AD_ReadBatteryFiltered(void)
+ * @param None
+ * @return filtered 10-bit battery reading or ERROR
+ * @brief Returns the low-passed battery voltage the undervoltage lockout uses. It only changes
+ *        once per battery sample period (about 1Hz), so callers can cache anything derived
+ *        from it until it moves. */
+unsigned int AD_ReadBatteryFiltered(void)
+{
+    if (!ADActive) {
+        dbprintf("%s returning ERROR before enable\r\n", __FUNCTION__);
+        return ERROR;
+    }
+    return CurFilt_BatVoltage;
+}
+
 /**
  * @function AD_End(void)
  * @param None
@@ -101,6 +101,14 @@ char AD_IsNewDataReady(void);
  * @author Max Dunne, 2011.12.10 */
 unsigned int AD_ReadADPin(unsigned int Pin);
 
+/**
+ * @function AD_ReadBatteryFiltered(void)
+ * @param None
+ * @return filtered 10-bit battery reading or ERROR
+ * @brief Returns the low-passed battery voltage, updated once per battery sample period
+ *        (about 1Hz). */
+unsigned int AD_ReadBatteryFiltered(void);
+
 /**
  * @function AD_End(void)
  * @param None
@@ -6,16 +6,21 @@
  */
 
 #include <Bot.h>
+#include <BotDrive.h>
 #include <BOARD.h>
-#include <xc.h>
+#include <HW_Regs.h>
 #include <pwm.h>
 #include <serial.h>
 #include <AD.h>
-#include <peripheral/ports.h>
 #include <IO_Ports.h>
 #include <LED.h>
 #include <RC_Servo.h>
+#include <Stepper.h>
+#include <ES_Timers.h>
+#include <EventRecorder.h>
+#include <Latency.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 /*******************************************************************************
  * PRIVATE #DEFINES                                                            *
@@ -24,38 +29,42 @@
 //#define BOT_TEST
 
 //Directionality Tris
-#define LEFT_DIR_TRIS   PORTY07_TRIS
-#define RIGHT_DIR_TRIS  PORTY08_TRIS
+#define LEFT_DIR_TRIS   HW_PIN(TRISE, 7) //PORTY07_TRIS
+#define RIGHT_DIR_TRIS  HW_PIN(TRISD, 9) //PORTY08_TRIS
 
 //Wheel/motor Directionality
 //Left is a, Right is b
-#define LEFT_DIR    PORTY07_LAT
-#define RIGHT_DIR   PORTY08_LAT
+#define LEFT_DIR    HW_PIN(LATE, 7) //PORTY07_LAT
+#define RIGHT_DIR   HW_PIN(LATD, 9) //PORTY08_LAT
 
 //Wheel PWM signals (These set speed of the DC motors and go to the enable pin on the hbridge)
 //These are the enables for the motors/wheels.
 #define LEFT_WHEEL_PWM      PWM_PORTY10
 #define RIGHT_WHEEL_PWM     PWM_PORTY12
 
+//The PWM runs the output compares off Timer2 and OCxRS latches when TMR2 rolls
+//over. Its period interrupt is on only while a wheel waits to change direction.
+#define Timer2IntEnable() HW_SFR_WRITE(IEC0SET, _IEC0_T2IE_MASK)
+#define Timer2IntDisable() HW_SFR_WRITE(IEC0CLR, _IEC0_T2IE_MASK)
+#define Timer2IntClearFlag() HW_SFR_WRITE(IFS0CLR, _IFS0_T2IF_MASK)
+#define LEFT_DIR_PENDING    0x01
+#define RIGHT_DIR_PENDING   0x02
+
 //RC Servo
 #define RC_SERVO_SIGNAL     RC_PORTZ08
 
-//Stepper Motor
-#define STEPPER_STEP            PWM_PORTZ06
-#define STEPPER_DIR_TRIS        PORTZ04_TRIS
-#define STEPPER_DIR             PORTZ04_LAT
-#define STEPPER_ENABLE_TRIS     PORTZ05_TRIS
-#define STEPPER_ENABLE          PORTZ05_LAT
+//Stepper Motor: the DRV8811 on Z06 (step), Z04 (dir) and Z05 (enable) is
+//run by the Stepper module on Timer3, see Stepper.h
 
 //Bumper Sensor Tris
-#define MICRO_SWITCH_FRONT_LEFT_TRIS    PORTZ07_TRIS
-#define MICRO_SWITCH_FRONT_RIGHT_TRIS   PORTZ11_TRIS
-#define MICRO_SWITCH_FRONT_CENTER_TRIS  PORTZ09_TRIS
+#define MICRO_SWITCH_FRONT_LEFT_TRIS    HW_PIN(TRISE, 2) //PORTZ07_TRIS
+#define MICRO_SWITCH_FRONT_RIGHT_TRIS   HW_PIN(TRISE, 0) //PORTZ11_TRIS
+#define MICRO_SWITCH_FRONT_CENTER_TRIS  HW_PIN(TRISE, 1) //PORTZ09_TRIS
 
 //Bumper Sensors
-#define MICRO_SWITCH_FRONT_LEFT     PORTZ07_BIT
-#define MICRO_SWITCH_FRONT_RIGHT    PORTZ11_BIT
-#define MICRO_SWITCH_FRONT_CENTER   PORTZ09_BIT
+#define MICRO_SWITCH_FRONT_LEFT     HW_PIN(PORTE, 2) //PORTZ07_BIT
+#define MICRO_SWITCH_FRONT_RIGHT    HW_PIN(PORTE, 0) //PORTZ11_BIT
+#define MICRO_SWITCH_FRONT_CENTER   HW_PIN(PORTE, 1) //PORTZ09_BIT
 
 //Analog-Digital Pins
 #define BEACON_DETECTOR BEACON_DET   
@@ -70,12 +79,15 @@
 
 //light bar defines
 #define NUMLEDS 12
+#define NUM_LED_PORTS 4
+#define LED_NIBBLES ((NUMLEDS + 3) / 4)
+
+#define LED_SetPinOutput(i) HW_WRITE(LED_TRISCLR[i], LED_bitsMap[i])
+#define LED_SetPinInput(i) HW_WRITE(LED_TRISSET[i], LED_bitsMap[i]);
+#define LED_On(i) HW_WRITE(LED_LATCLR[(unsigned int)i], LED_bitsMap[(unsigned int)i]);
+#define LED_Off(i) HW_WRITE(LED_LATSET[(unsigned int)i], LED_bitsMap[(unsigned int)i]);
+#define LED_Get(i) (HW_READ(LED_LAT[(unsigned int)i])&LED_bitsMap[(unsigned int)i])
 
-#define LED_SetPinOutput(i) *LED_TRISCLR[i] = LED_bitsMap[i]
-#define LED_SetPinInput(i) *LED_TRISSET[i] = LED_bitsMap[i];
-#define LED_On(i) *LED_LATCLR[(unsigned int)i] = LED_bitsMap[(unsigned int)i];
-#define LED_Off(i) *LED_LATSET[(unsigned int)i] = LED_bitsMap[(unsigned int)i];
-#define LED_Get(i) (*LED_LAT[(unsigned int)i]&LED_bitsMap[(unsigned int)i])
 
 
 /*******************************************************************************
@@ -103,25 +115,84 @@ typedef union {
 } LEDBank_t;
 
 
-static volatile unsigned int * const LED_TRISCLR[] = {&TRISECLR, &TRISDCLR, &TRISDCLR, &TRISDCLR,
-    &TRISDCLR, &TRISDCLR, &TRISDCLR, &TRISFCLR, &TRISFCLR, &TRISGCLR, &TRISFCLR, &TRISFCLR};
+static const HW_Reg_t LED_TRISCLR[] = {HW_REG(TRISECLR), HW_REG(TRISDCLR), HW_REG(TRISDCLR), HW_REG(TRISDCLR),
+    HW_REG(TRISDCLR), HW_REG(TRISDCLR), HW_REG(TRISDCLR), HW_REG(TRISFCLR),
+    HW_REG(TRISFCLR), HW_REG(TRISGCLR), HW_REG(TRISFCLR), HW_REG(TRISFCLR)};
 
-static volatile unsigned int * const LED_TRISSET[] = {&TRISESET, &TRISDSET, &TRISDSET, &TRISDSET,
-    &TRISDSET, &TRISDSET, &TRISDSET, &TRISFSET, &TRISFSET, &TRISGSET, &TRISFSET, &TRISFSET};
+static const HW_Reg_t LED_TRISSET[] = {HW_REG(TRISESET), HW_REG(TRISDSET), HW_REG(TRISDSET), HW_REG(TRISDSET),
+    HW_REG(TRISDSET), HW_REG(TRISDSET), HW_REG(TRISDSET), HW_REG(TRISFSET),
+    HW_REG(TRISFSET), HW_REG(TRISGSET), HW_REG(TRISFSET), HW_REG(TRISFSET)};
 
-static volatile unsigned int * const LED_LATCLR[] = {&LATECLR, &LATDCLR, &LATDCLR, &LATDCLR,
-    &LATDCLR, &LATDCLR, &LATDCLR, &LATFCLR, &LATFCLR, &LATGCLR, &LATFCLR, &LATFCLR};
+static const HW_Reg_t LED_LATCLR[] = {HW_REG(LATECLR), HW_REG(LATDCLR), HW_REG(LATDCLR), HW_REG(LATDCLR),
+    HW_REG(LATDCLR), HW_REG(LATDCLR), HW_REG(LATDCLR), HW_REG(LATFCLR),
+    HW_REG(LATFCLR), HW_REG(LATGCLR), HW_REG(LATFCLR), HW_REG(LATFCLR)};
 
-static volatile unsigned int * const LED_LATSET[] = {&LATESET, &LATDSET, &LATDSET, &LATDSET,
-    &LATDSET, &LATDSET, &LATDSET, &LATFSET, &LATFSET, &LATGSET, &LATFSET, &LATFSET};
+static const HW_Reg_t LED_LATSET[] = {HW_REG(LATESET), HW_REG(LATDSET), HW_REG(LATDSET), HW_REG(LATDSET),
+    HW_REG(LATDSET), HW_REG(LATDSET), HW_REG(LATDSET), HW_REG(LATFSET),
+    HW_REG(LATFSET), HW_REG(LATGSET), HW_REG(LATFSET), HW_REG(LATFSET)};
 
-static volatile unsigned int * const LED_LAT[] = {&LATE, &LATD, &LATD, &LATD,
-    &LATD, &LATD, &LATD, &LATF, &LATF, &LATG, &LATF, &LATF};
+static const HW_Reg_t LED_LAT[] = {HW_REG(LATE), HW_REG(LATD), HW_REG(LATD), HW_REG(LATD),
+    HW_REG(LATD), HW_REG(LATD), HW_REG(LATD), HW_REG(LATF),
+    HW_REG(LATF), HW_REG(LATG), HW_REG(LATF), HW_REG(LATF)};
 
 static unsigned short int LED_bitsMap[] = {BIT_7, BIT_5, BIT_10, BIT_11, BIT_3, BIT_6, BIT_7, BIT_6, BIT_4, BIT_6, BIT_5, BIT_1};
 
 //static unsigned short int LED_ShiftAmount[] = {7, 5, 10, 11, 3, 6, 7, 6, 4, 6, 5, 1};
 
+//the bar only spans four physical ports, so a whole pattern is one LATxINV each
+typedef enum {
+    LED_PORT_E, LED_PORT_D, LED_PORT_F, LED_PORT_G
+} LEDPort_t;
+
+static const uint8_t LED_PortOf[NUMLEDS] = {LED_PORT_E, LED_PORT_D, LED_PORT_D, LED_PORT_D,
+    LED_PORT_D, LED_PORT_D, LED_PORT_D, LED_PORT_F, LED_PORT_F, LED_PORT_G, LED_PORT_F, LED_PORT_F};
+
+static const HW_Reg_t LED_PortLAT[NUM_LED_PORTS] = {HW_REG(LATE), HW_REG(LATD), HW_REG(LATF), HW_REG(LATG)};
+
+static const HW_Reg_t LED_PortLATINV[NUM_LED_PORTS] = {HW_REG(LATEINV), HW_REG(LATDINV), HW_REG(LATFINV), HW_REG(LATGINV)};
+
+//built by Bot_Init from LED_bitsMap: port bits lit by each nibble of a pattern,
+//and all LED bits on each port
+static uint16_t LED_NibbleMask[NUM_LED_PORTS][LED_NIBBLES][16];
+static uint16_t LED_PortMask[NUM_LED_PORTS];
+
+//Inner wheel factors were 1.0, -1.0, 0.9, 0.75 (originally 0.8), 0.5 and -0.3
+//(was 0, then -0.7). Curvature is BOT_DRIVE_ONE minus the factor rounded up to
+//Q12, which truncates to the same wheel speed as the float did for every input.
+static const int16_t TurnCurvature[NUM_TURNS] = {BOT_TURN_CURVATURES};
+
+//last direction and duty commanded for each wheel, and the battery
+//compensated duty that actually went to the PWM
+typedef struct {
+    uint8_t dir;
+    uint16_t duty;
+    uint16_t pwm;
+} WheelCommand_t;
+
+static WheelCommand_t LeftWheel;
+static WheelCommand_t RightWheel;
+//wheels zeroed for a direction change, the Timer2 interrupt finishes them
+static volatile uint8_t DirPending;
+static unsigned int MotorWriteCount;
+static unsigned int MotorSkipCount;
+
+//BotDrive_BatteryScale, recomputed only when the AD's 1Hz filtered reading moves
+static unsigned int BatteryReading;
+static uint32_t BatteryScale;
+
+//dead reckoned from the wheel commands, BotDrive.c does the math
+static BotDrive_Odometry_t Odometry;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static char Bot_DriveTurn(Turn_t turn, char speed);
+static void Bot_SpeedToWheel(int16_t speed, WheelCommand_t *wheel);
+static char Bot_ApplyWheels(const WheelCommand_t *left, const WheelCommand_t *right);
+static void Bot_UpdateBatteryScale(void);
+static void Bot_UpdatePose(void);
+
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
  ******************************************************************************/
@@ -141,35 +212,53 @@ void Bot_Init(void) {
     AD_Init();
     LED_Init();
     PWM_SetFrequency(1000);
-    PWM_AddPins(LEFT_WHEEL_PWM | RIGHT_WHEEL_PWM | RC_SERVO_SIGNAL | STEPPER_STEP);
+    PWM_AddPins(LEFT_WHEEL_PWM | RIGHT_WHEEL_PWM | RC_SERVO_SIGNAL);
     
     AD_AddPins(BC_TAPE_SENSOR | LEFT_BALL_TAPE_SENSOR  |  BEACON_DETECTOR | 
                TRACK_WIRE_DETECTOR | FL_TAPE_SENSOR | FR_TAPE_SENSOR);
 
     //DC Motors (wheels )
-    LEFT_DIR_TRIS = 0;
-    RIGHT_DIR_TRIS = 0;
-    LEFT_DIR = 0;
-    RIGHT_DIR = 0;
+    HW_PIN_WRITE(LEFT_DIR_TRIS, 0);
+    HW_PIN_WRITE(RIGHT_DIR_TRIS, 0);
+    HW_PIN_WRITE(LEFT_DIR, 0);
+    HW_PIN_WRITE(RIGHT_DIR, 0);
+    PWM_SetDutyCycle(LEFT_WHEEL_PWM, 0);
+    PWM_SetDutyCycle(RIGHT_WHEEL_PWM, 0);
+    Timer2IntDisable();
+    Timer2IntClearFlag();
+    HW_FIELD_WRITE(IPC2, T2IP, 3);
+    HW_FIELD_WRITE(IPC2, T2IS, 0);
+    DirPending = 0;
+    LeftWheel.dir = 0;
+    LeftWheel.duty = 0;
+    LeftWheel.pwm = 0;
+    RightWheel = LeftWheel;
+    BatteryReading = 0;
+    BatteryScale = BotDrive_BatteryScale(0);
+    MotorWriteCount = 0;
+    MotorSkipCount = 0;
+    Bot_ResetPose(0, 0, 0);
 
     //Stepper
-    STEPPER_ENABLE_TRIS = 0;      //output
-    STEPPER_DIR_TRIS = 0;         //output
-    //StepperStop();
-    PWM_SetDutyCycle(STEPPER_STEP, 0);
-    STEPPER_ENABLE = 0;
-    STEPPER_DIR = 0;
+    Stepper_Init();
 
     //set up the micro switch sensors (bumpers)
-    MICRO_SWITCH_FRONT_LEFT_TRIS = 1;
-    MICRO_SWITCH_FRONT_RIGHT_TRIS = 1;
-    MICRO_SWITCH_FRONT_CENTER_TRIS = 1;
+    HW_PIN_WRITE(MICRO_SWITCH_FRONT_LEFT_TRIS, 1);
+    HW_PIN_WRITE(MICRO_SWITCH_FRONT_RIGHT_TRIS, 1);
+    HW_PIN_WRITE(MICRO_SWITCH_FRONT_CENTER_TRIS, 1);
 
     //set up the light bank
     uint8_t CurPin;
+    uint8_t Nibble;
     for (CurPin = 0; CurPin < NUMLEDS; CurPin++) {
         LED_SetPinOutput(CurPin);
         LED_Off(CurPin);
+        LED_PortMask[LED_PortOf[CurPin]] |= LED_bitsMap[CurPin];
+        for (Nibble = 0; Nibble < 16; Nibble++) {
+            if (Nibble & (1 << (CurPin & 3))) {
+                LED_NibbleMask[LED_PortOf[CurPin]][CurPin >> 2][Nibble] |= LED_bitsMap[CurPin];
+            }
+        }
     }
 }
 
@@ -186,21 +275,13 @@ void Bot_Init(void) {
  * @brief  This function is used to set the speed and direction of the left motor.
  */
 char Bot_LeftMtrSpeed(char newSpeed) {
+    WheelCommand_t left;
+
     if ((newSpeed < -BOT_MAX_SPEED) || (newSpeed > BOT_MAX_SPEED)) {
         return (ERROR);
     }
-    newSpeed = -newSpeed;
-    if (newSpeed < 0) {
-        LEFT_DIR = 1;
-        newSpeed = newSpeed * (-1); // set speed to a positive value
-    } else {
-        LEFT_DIR = 0;
-    }
-    if (PWM_SetDutyCycle(LEFT_WHEEL_PWM, newSpeed * (MAX_PWM / BOT_MAX_SPEED)) == ERROR) {
-        //printf("ERROR: setting channel 1 speed!\n");
-        return (ERROR);
-    }
-    return (SUCCESS);
+    Bot_SpeedToWheel(-newSpeed, &left);
+    return Bot_ApplyWheels(&left, &RightWheel);
 }
 
 /**
@@ -211,133 +292,143 @@ char Bot_LeftMtrSpeed(char newSpeed) {
  * @brief  This function is used to set the speed and direction of the left motor.
  */
 char Bot_RightMtrSpeed(char newSpeed) {
+    WheelCommand_t right;
+
     if ((newSpeed < -BOT_MAX_SPEED) || (newSpeed > BOT_MAX_SPEED)) {
         return (ERROR);
     }
-    if (newSpeed < 0) {
-        RIGHT_DIR = 1;
-        newSpeed = newSpeed * (-1); // set speed to a positive value
-    } else {
-        RIGHT_DIR = 0;
-    }
-    if (PWM_SetDutyCycle(RIGHT_WHEEL_PWM, newSpeed * (MAX_PWM / BOT_MAX_SPEED)) == ERROR) {
-        //puts("\aERROR: setting channel 1 speed!\n");
-        return (ERROR);
-    }
-    return (SUCCESS);
+    Bot_SpeedToWheel(newSpeed, &right);
+    return Bot_ApplyWheels(&LeftWheel, &right);
+}
+
+/**
+ * @Function Bot_Drive(int16_t speed, int16_t curvature)
+ * @param speed - A value between -100 and 100 for the outer wheel, values
+ * @param beyond that are saturated. A negative value is reverse.
+ * @param curvature - Q12 turn amount. 0 is straight, positive turns right,
+ * @param negative turns left. +-4096 pivots on the inner wheel and +-8192 spins
+ * @param in place; the inner wheel runs at speed * (1 - |curvature|/4096).
+ * @return SUCCESS or ERROR
+ * @brief  Sets both wheels from a speed and curvature using integer math only,
+ * the math itself is BotDrive_Wheels.
+ */
+char Bot_Drive(int16_t speed, int16_t curvature) {
+    WheelCommand_t left;
+    WheelCommand_t right;
+    int16_t leftSpeed;
+    int16_t rightSpeed;
+
+    BotDrive_Wheels(speed, curvature, &leftSpeed, &rightSpeed);
+    //left wheel is mounted mirrored, so its command is negated
+    Bot_SpeedToWheel(-leftSpeed, &left);
+    Bot_SpeedToWheel(rightSpeed, &right);
+    return Bot_ApplyWheels(&left, &right);
+}
+
+/**
+ * @Function Bot_GetMotorWriteCount(void)
+ * @param None.
+ * @return number of wheel direction latch and duty cycle writes since Bot_Init
+ * @brief  Lets a test or the terminal see how often the drive hardware is touched.
+ */
+unsigned int Bot_GetMotorWriteCount(void) {
+    return MotorWriteCount;
+}
+
+/**
+ * @Function Bot_GetMotorSkipCount(void)
+ * @param None.
+ * @return number of wheel commands dropped since Bot_Init because they matched
+ * what the wheels were already doing
+ */
+unsigned int Bot_GetMotorSkipCount(void) {
+    return MotorSkipCount;
 }
 
 char DriveStraight(char speed){
-    if (Bot_LeftMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_STRAIGHT, speed);
 }
 
 char TankRight(char speed){
-    if (Bot_LeftMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(-speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_TANK_RIGHT, speed);
 }
 
 char TurnGentleRight(char speed){
-    if (Bot_LeftMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(0.9*speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_GENTLE_RIGHT, speed);
 }
 
 char TurnNormalRight(char speed){
-    if (Bot_LeftMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    //originally 0.8
-    if (Bot_RightMtrSpeed(0.75*speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_NORMAL_RIGHT, speed);
 }
 
 
 char TurnSharpRight(char speed){
-    if (Bot_LeftMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(0.5*speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_SHARP_RIGHT, speed);
 }
 
 char TankLeft(char speed){
-    if (Bot_LeftMtrSpeed(-speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_TANK_LEFT, speed);
 }
 
 char TurnGentleLeft(char speed){
-    if (Bot_LeftMtrSpeed(0.9*speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_GENTLE_LEFT, speed);
 }
 
 char TurnNormalLeft(char speed){
-    //originally 0.8
-    if (Bot_LeftMtrSpeed(0.75*speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_NORMAL_LEFT, speed);
 }
 
 char TurnSharpLeft(char speed){
-    //was 0.
-    if (Bot_LeftMtrSpeed(0.5*speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_SHARP_LEFT, speed);
 }
 
 char TurnHardLeft(char speed){
-    //was originally 0. Follows nicely, sometimes far from wall.
-    //changed to -0.7. Closer but slow.
-    if (Bot_LeftMtrSpeed(-0.3*speed) == ERROR)
-        return (ERROR);
-    if (Bot_RightMtrSpeed(speed) == ERROR)
-        return (ERROR);
-    return (SUCCESS);
+    return Bot_DriveTurn(TURN_HARD_LEFT, speed);
 }
 
 /*-----------------------------------------------------------------------------
- * Stepper Motor Functions
- * Stepper direction 1 goes down.
- * Stepper direction 0 goes up.
+ * Odometry Functions
+ * x is forward and y is left of where the pose was last reset, theta counts
+ * counterclockwise in BOT_ANGLE units.
  * ----------------------------------------------------------------------------
- */ 
+ */
+
+/**
+ * @Function Bot_GetPose(void)
+ * @param None.
+ * @return current dead-reckoned pose, positions in mm
+ * @brief  Integrates the commanded wheel speeds up to now and returns the pose.
+ */
+BotPose_t Bot_GetPose(void) {
+    BotPose_t pose;
 
-void StepperForward(){
-    PWM_SetDutyCycle(STEPPER_STEP, 100);
-    PWM_SetFrequency(50);
-    STEPPER_ENABLE = 1;
-    STEPPER_DIR = 0;
+    Bot_UpdatePose();
+    pose = BotDrive_GetPose(&Odometry);
+    pose.theta = RECORD_SENSOR(RECORDER_HEADING, pose.theta);
+    return pose;
 }
 
-void StepperReverse(){
-    PWM_SetDutyCycle(STEPPER_STEP, 100);
-    PWM_SetFrequency(50);
-    STEPPER_ENABLE = 1;
-    STEPPER_DIR = 1;
+/**
+ * @Function Bot_ResetPose(int32_t x, int32_t y, uint16_t theta)
+ * @param x, y - known position in mm
+ * @param theta - known heading in BOT_ANGLE units
+ * @return None.
+ * @brief  Snaps the pose to a landmark, e.g. the start position or a tape edge.
+ */
+void Bot_ResetPose(int32_t x, int32_t y, uint16_t theta) {
+    BotDrive_ResetPose(&Odometry, x, y, theta, ES_Timer_GetTime());
 }
 
-void StepperStop(){
-    STEPPER_ENABLE = 0;
-    PWM_SetDutyCycle(STEPPER_STEP, 0);
-    PWM_SetFrequency(1000);
+/**
+ * @Function Bot_ResetPoseHeading(uint16_t theta)
+ * @param theta - known heading in BOT_ANGLE units
+ * @return None.
+ * @brief  Snaps only the heading, for landmarks such as a wall the bot is
+ * parallel to that say nothing about position.
+ */
+void Bot_ResetPoseHeading(uint16_t theta) {
+    Bot_UpdatePose();
+    Odometry.theta = (uint32_t) theta << 16;
 }
 
 /*------------------------------------------------------------------------------
@@ -372,7 +463,7 @@ unsigned int Bot_ReadBeaconVoltage(void) {
  * @brief returns the state of the Track Wire Sensor.
  */
 unsigned int Bot_ReadTrackWireVoltage(void) {
-    return AD_ReadADPin(TRACK_WIRE_DETECTOR);
+    return RECORD_SENSOR(RECORDER_TRACK_WIRE, AD_ReadADPin(TRACK_WIRE_DETECTOR));
 }
 
 /*------------------------------------------------------------------------------
@@ -387,13 +478,16 @@ unsigned int Bot_ReadTrackWireVoltage(void) {
  * @brief  Forces the LEDs in (bank) to on (1) or off (0) to match the pattern.
  * @author Gabriel Hugh Elkaim, 2011.12.25 01:16 Max Dunne 2015.09.18 */
 char Bot_LEDSSet(uint16_t pattern) {
-    char i;
-    for (i = 0; i < NUMLEDS; i++) {
-        if (pattern & (1 << i)) {
-            LED_On(i);
-        } else {
-            LED_Off(i);
-        }
+    uint8_t port;
+    uint16_t lit;
+    for (port = 0; port < NUM_LED_PORTS; port++) {
+        lit = LED_NibbleMask[port][0][pattern & 0xF] |
+                LED_NibbleMask[port][1][(pattern >> 4) & 0xF] |
+                LED_NibbleMask[port][2][(pattern >> 8) & 0xF];
+        //LEDs are active low, so the port should read back as ~lit. Toggling
+        //only the LED bits leaves the rest of the port alone even if an ISR
+        //writes it between the read and the INV.
+        HW_WRITE(LED_PortLATINV[port], (HW_READ(LED_PortLAT[port]) ^ ~lit) & LED_PortMask[port]);
     }
     return SUCCESS;
 }
@@ -402,14 +496,7 @@ char Bot_BarGraph(uint8_t Number) {
     if (Number > NUMLEDS) {
         return ERROR;
     }
-    uint16_t Pattern = 0;
-    uint8_t iterations;
-
-    for (iterations = 0; iterations < Number; iterations++) {
-        Pattern <<= 1;
-        Pattern |= 1;
-    }
-    Bot_LEDSSet(Pattern);
+    Bot_LEDSSet((1 << Number) - 1);
     return SUCCESS;
 }
 
@@ -425,7 +512,7 @@ char Bot_BarGraph(uint8_t Number) {
  * @brief  Returns the state of the front left bumper 
  */
 unsigned char Bot_ReadFrontLeftBumper(void) {
-    return MICRO_SWITCH_FRONT_LEFT;
+    return HW_PIN_READ(MICRO_SWITCH_FRONT_LEFT);
 }
 
 /**
@@ -435,7 +522,7 @@ unsigned char Bot_ReadFrontLeftBumper(void) {
  * @brief  Returns the state of the front right bumper 
  */
 unsigned char Bot_ReadFrontRightBumper(void) {
-    return MICRO_SWITCH_FRONT_RIGHT;
+    return HW_PIN_READ(MICRO_SWITCH_FRONT_RIGHT);
 }
 
 /**
@@ -445,7 +532,7 @@ unsigned char Bot_ReadFrontRightBumper(void) {
  * @brief  Returns the state of the rear left bumper
  */
 unsigned char Bot_ReadFrontCenterBumper(void) {
-    return MICRO_SWITCH_FRONT_CENTER;
+    return HW_PIN_READ(MICRO_SWITCH_FRONT_CENTER);
 }
 
 /**
@@ -457,7 +544,7 @@ unsigned char Bot_ReadFrontCenterBumper(void) {
 unsigned char Bot_ReadBumpers(void) {
     //unsigned char bump_state;
     //bump_state = (!MICRO_SWITCH_FRONT_LEFT + ((!MICRO_SWITCH_FRONT_RIGHT) << 1)+((!MICRO_SWITCH_FRONT_CENTER) << 2));
-    return (!MICRO_SWITCH_FRONT_LEFT + ((!MICRO_SWITCH_FRONT_CENTER) << 1)+((!MICRO_SWITCH_FRONT_RIGHT) << 2));
+    return RECORD_SENSOR(RECORDER_BUMPERS, !HW_PIN_READ(MICRO_SWITCH_FRONT_LEFT) + ((!HW_PIN_READ(MICRO_SWITCH_FRONT_CENTER)) << 1)+((!HW_PIN_READ(MICRO_SWITCH_FRONT_RIGHT)) << 2));
 }
 
 /*------------------------------------------------------------------------------
@@ -505,6 +592,172 @@ unsigned int Bot_ReadLeftBallTapeVoltage(void){
     return AD_ReadADPin(LEFT_BALL_TAPE_SENSOR);
 }
 
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+/**
+ * @Function Bot_DriveTurn(Turn_t turn, char speed)
+ * @param turn - which of the drive helpers
+ * @param speed - as the helper was given it
+ * @return what Bot_Drive returns
+ * @brief Every drive helper comes through here, so EventRecorder sees each command.
+ */
+static char Bot_DriveTurn(Turn_t turn, char speed) {
+    RECORD_COMMAND(turn, speed);
+    return Bot_Drive(speed, TurnCurvature[turn]);
+}
+
+/**
+ * @Function Bot_SpeedToWheel(int16_t speed, WheelCommand_t *wheel)
+ * @param speed - signed wheel speed as seen by the h-bridge, -100 to 100
+ * @param wheel - filled in with the direction latch and duty cycle for speed
+ * @return None.
+ */
+static void Bot_SpeedToWheel(int16_t speed, WheelCommand_t *wheel) {
+    if (speed < 0) {
+        wheel->dir = 1;
+        speed = -speed; // set speed to a positive value
+    } else {
+        wheel->dir = 0;
+    }
+    wheel->duty = speed * (MAX_PWM / BOT_MAX_SPEED);
+}
+
+/**
+ * @Function Bot_ApplyWheels(const WheelCommand_t *left, const WheelCommand_t *right)
+ * @param left, right - new commands for each wheel, pwm is filled in here
+ * @return SUCCESS or ERROR
+ * @brief  Scales the duties for the battery and writes only what changed. The
+ * output compares run off Timer2 and OCxRS only latches when TMR2 rolls over, so
+ * the two duty cycles written back to back take effect together on the next PWM
+ * period. The direction latch would change at once, so a reversing wheel gets a
+ * zero duty instead and the Timer2 interrupt, once that zero is running, flips
+ * the latch and writes the new duty. The wheel coasts for one period, 1ms at
+ * 1kHz, and never runs its old duty backwards.
+ */
+static char Bot_ApplyWheels(const WheelCommand_t *left, const WheelCommand_t *right) {
+    uint16_t leftPwm, rightPwm;
+    uint8_t pwmChanged, dirChanged;
+    uint8_t zeroed = 0;
+    char result = SUCCESS;
+
+    Bot_UpdateBatteryScale();
+    leftPwm = BotDrive_CompensateDuty(left->duty, BatteryScale);
+    rightPwm = BotDrive_CompensateDuty(right->duty, BatteryScale);
+    pwmChanged = (leftPwm != LeftWheel.pwm) || (rightPwm != RightWheel.pwm);
+    dirChanged = (left->dir != LeftWheel.dir) || (right->dir != RightWheel.dir);
+
+    if (!pwmChanged && !dirChanged &&
+            (left->duty == LeftWheel.duty) && (right->duty == RightWheel.duty)) {
+        MotorSkipCount++;
+        return (SUCCESS);
+    }
+    //close out the pose at the old speeds before they change
+    Bot_UpdatePose();
+    //the period interrupt reads the wheels, keep it out while they change
+    Timer2IntDisable();
+    LeftWheel.duty = left->duty;
+    RightWheel.duty = right->duty;
+    if (left->dir != LeftWheel.dir) {
+        if (!(DirPending & LEFT_DIR_PENDING)) {
+            result |= PWM_SetDutyCycle(LEFT_WHEEL_PWM, 0);
+            zeroed |= LEFT_DIR_PENDING;
+        }
+        LeftWheel.dir = left->dir;
+        LeftWheel.pwm = leftPwm;
+        MotorWriteCount++;
+    } else if (leftPwm != LeftWheel.pwm) {
+        if (!(DirPending & LEFT_DIR_PENDING)) {
+            result |= PWM_SetDutyCycle(LEFT_WHEEL_PWM, leftPwm);
+        }
+        LeftWheel.pwm = leftPwm;
+        MotorWriteCount++;
+    }
+    if (right->dir != RightWheel.dir) {
+        if (!(DirPending & RIGHT_DIR_PENDING)) {
+            result |= PWM_SetDutyCycle(RIGHT_WHEEL_PWM, 0);
+            zeroed |= RIGHT_DIR_PENDING;
+        }
+        RightWheel.dir = right->dir;
+        RightWheel.pwm = rightPwm;
+        MotorWriteCount++;
+    } else if (rightPwm != RightWheel.pwm) {
+        if (!(DirPending & RIGHT_DIR_PENDING)) {
+            result |= PWM_SetDutyCycle(RIGHT_WHEEL_PWM, rightPwm);
+        }
+        RightWheel.pwm = rightPwm;
+        MotorWriteCount++;
+    }
+    if (zeroed) {
+        //only a rollover after the zero was written may flip the latch
+        Timer2IntClearFlag();
+        DirPending |= zeroed;
+    }
+    if (DirPending) {
+        Timer2IntEnable();
+    }
+    Latency_Actuated();
+    return (result);
+}
+
+/**
+ * @Function Bot_UpdateBatteryScale(void)
+ * @param None.
+ * @return None.
+ * @brief  Picks up a new filtered battery reading. The divide only happens when
+ * the reading changes, which the AD does about once a second.
+ */
+static void Bot_UpdateBatteryScale(void) {
+    unsigned int battery = AD_ReadBatteryFiltered();
+
+    if (battery != BatteryReading) {
+        BatteryReading = battery;
+        BatteryScale = BotDrive_BatteryScale(battery);
+    }
+}
+
+/**
+ * @Function Bot_UpdatePose(void)
+ * @param None.
+ * @return None.
+ * @brief  Advances the pose up to the current time using the wheel speeds last
+ * written, so it has to run before they change.
+ */
+static void Bot_UpdatePose(void) {
+    int16_t left = LeftWheel.duty / (MAX_PWM / BOT_MAX_SPEED);
+    int16_t right = RightWheel.duty / (MAX_PWM / BOT_MAX_SPEED);
+
+    //the left wheel runs forward with its direction latch set
+    if (!LeftWheel.dir) {
+        left = -left;
+    }
+    if (RightWheel.dir) {
+        right = -right;
+    }
+    BotDrive_UpdatePose(&Odometry, left, right, ES_Timer_GetTime());
+}
+
+/**
+ * @Function Timer2IntHandler(void)
+ * @brief  Finishes the direction changes Bot_ApplyWheels started. The zero duty
+ * it wrote took at this rollover, so the reversing wheels are off for the whole
+ * period now starting: flip their latches and queue the new duties for the next.
+ */
+void __ISR(_TIMER_2_VECTOR, ipl3auto) Timer2IntHandler(void) {
+    Timer2IntClearFlag();
+    Timer2IntDisable();
+    if (DirPending & LEFT_DIR_PENDING) {
+        HW_PIN_WRITE(LEFT_DIR, LeftWheel.dir);
+        PWM_SetDutyCycle(LEFT_WHEEL_PWM, LeftWheel.pwm);
+    }
+    if (DirPending & RIGHT_DIR_PENDING) {
+        HW_PIN_WRITE(RIGHT_DIR, RightWheel.dir);
+        PWM_SetDutyCycle(RIGHT_WHEEL_PWM, RightWheel.pwm);
+    }
+    DirPending = 0;
+}
+
 #ifdef BOT_TEST
 
 // These are the different possible tests
@@ -515,6 +768,7 @@ unsigned int Bot_ReadLeftBallTapeVoltage(void){
 //#define BEACON_DETECTOR_TEST
 //#define TRACK_WIRE_TEST
 //#define STEPPER_TEST
+//#define DRIVE_TEST
 
 #define DELAY(x)    for (wait = 0; wait <= x; wait++) {asm("nop");}
 #define ONE_SECOND          666667
@@ -603,18 +857,47 @@ int main(void) {
             printf("Error: Motor not ran properly\r\n");
         else
             printf("Success: Motor ran properly\r\n");
+        printf("Motor writes: %d, skipped commands: %d\r\n",
+                Bot_GetMotorWriteCount(), Bot_GetMotorSkipCount());
         DELAY(250000);
         Battery = Bot_BatteryVoltage();
         printf("Battery Voltage is: %d\r\n", Battery);
     }
     #endif 
 
+    #ifdef DRIVE_TEST
+    {
+        //the wheel math itself is checked on the host by BOT_DRIVE_TEST in
+        //BotDrive.c, this only times it against the float it replaced
+        int16_t curSpeed;
+        volatile int16_t sink = 0;
+        unsigned int start, floatTicks, fixedTicks;
+
+        start = _CP0_GET_COUNT();
+        for (curSpeed = -BOT_MAX_SPEED; curSpeed <= BOT_MAX_SPEED; curSpeed++) {
+            sink = (char) (0.9 * curSpeed);
+        }
+        floatTicks = _CP0_GET_COUNT() - start;
+        start = _CP0_GET_COUNT();
+        for (curSpeed = -BOT_MAX_SPEED; curSpeed <= BOT_MAX_SPEED; curSpeed++) {
+            sink = BotDrive_ScaleSpeed(curSpeed, BOT_DRIVE_ONE - TurnCurvature[TURN_GENTLE_RIGHT]);
+        }
+        fixedTicks = _CP0_GET_COUNT() - start;
+        printf("201 scales: float %d core ticks, Q12 %d core ticks\r\n", floatTicks, fixedTicks);
+        while (1);
+    }
+    #endif
+
     #ifdef STEPPER_TEST
+    Stepper_SetRate(50);
     while (1){
-        StepperForward();
-        DELAY(250000);
-        StepperReverse();
-        DELAY(250000);
+        if (!Stepper_IsStepping()) {
+            if (Stepper_GetDirection() == FORWARD) {
+                Stepper_InitSteps(REVERSE, 50);
+            } else {
+                Stepper_InitSteps(FORWARD, 50);
+            }
+        }
     }
     #endif
     
@@ -22,6 +22,38 @@
 
 #define BOT_MAX_SPEED 100 
 
+//headings are binary angles, 65536 per full turn
+#define BOT_ANGLE_FULL_TURN 65536L
+#define BOT_DEGREES(d) ((uint16_t) (((d) * BOT_ANGLE_FULL_TURN) / 360))
+
+//the drive helpers below, in the order of BOT_TURN_CURVATURES
+typedef enum {
+    TURN_STRAIGHT,
+    TURN_TANK_RIGHT,
+    TURN_GENTLE_RIGHT,
+    TURN_NORMAL_RIGHT,
+    TURN_SHARP_RIGHT,
+    TURN_TANK_LEFT,
+    TURN_GENTLE_LEFT,
+    TURN_NORMAL_LEFT,
+    TURN_SHARP_LEFT,
+    TURN_HARD_LEFT,
+    NUM_TURNS
+} Turn_t;
+
+//Bot_Drive curvature of each Turn_t, BOT_CURVATURE_SPIN spins in place. Shared
+//with the field simulator so it turns the way the robot does.
+#define BOT_CURVATURE_SPIN 8192
+#define BOT_TURN_CURVATURES \
+    0, BOT_CURVATURE_SPIN, 409, 1024, 2048, \
+    -BOT_CURVATURE_SPIN, -409, -1024, -2048, -5325
+
+typedef struct {
+    int32_t x;          //mm forward of the last reset
+    int32_t y;          //mm left of the last reset
+    uint16_t theta;     //counterclockwise, see BOT_DEGREES
+} BotPose_t;
+
 /**
  * @Function Bot_Init(void)
  * @param None.
@@ -52,6 +84,62 @@ char Bot_LeftMtrSpeed(char newSpeed);
  */
 char Bot_RightMtrSpeed(char newSpeed);
 
+/**
+ * @Function Bot_Drive(int16_t speed, int16_t curvature)
+ * @param speed - A value between -100 and 100 for the outer wheel, values
+ * @param beyond that are saturated. A negative value is reverse.
+ * @param curvature - Q12 turn amount. 0 is straight, positive turns right,
+ * @param negative turns left. +-4096 pivots on the inner wheel and +-8192 spins
+ * @param in place; the inner wheel runs at speed * (1 - |curvature|/4096).
+ * @return SUCCESS or ERROR
+ * @brief  Sets both wheels from a speed and curvature using integer math only.
+ * The turn helpers below are fixed curvatures passed through this function.
+ */
+char Bot_Drive(int16_t speed, int16_t curvature);
+
+/**
+ * @Function Bot_GetMotorWriteCount(void)
+ * @param None.
+ * @return number of wheel direction latch and duty cycle writes since Bot_Init
+ * @brief  Repeated commands are cached away, so this only counts real changes.
+ */
+unsigned int Bot_GetMotorWriteCount(void);
+
+/**
+ * @Function Bot_GetMotorSkipCount(void)
+ * @param None.
+ * @return number of wheel commands dropped since Bot_Init because they matched
+ * what the wheels were already doing
+ */
+unsigned int Bot_GetMotorSkipCount(void);
+
+/**
+ * @Function Bot_GetPose(void)
+ * @param None.
+ * @return current dead-reckoned pose, positions in mm
+ * @brief  Integrated from the commanded wheel speeds in fixed 10ms steps, there
+ * are no encoders. Good for ending a move on distance or angle, reset it on
+ * landmarks to keep the drift down.
+ */
+BotPose_t Bot_GetPose(void);
+
+/**
+ * @Function Bot_ResetPose(int32_t x, int32_t y, uint16_t theta)
+ * @param x, y - known position in mm
+ * @param theta - known heading, see BOT_DEGREES
+ * @return None.
+ * @brief  Snaps the pose to a landmark, e.g. the start position or a tape edge.
+ */
+void Bot_ResetPose(int32_t x, int32_t y, uint16_t theta);
+
+/**
+ * @Function Bot_ResetPoseHeading(uint16_t theta)
+ * @param theta - known heading, see BOT_DEGREES
+ * @return None.
+ * @brief  Snaps only the heading, e.g. once the bot is parallel to a wall.
+ */
+void Bot_ResetPoseHeading(uint16_t theta);
+
 /**
  * @Function DriveStraight(char speed)
  * @param newSpeed - A value between -100 and 100 which is the new speed
@@ -121,7 +209,7 @@ char TankLeft(char speed);
  * @brief  This function is used to set the speed and direction of the both motors.
  * This will cause the bot to take a gentle left turn.
  */
-char TurnGentleRight(char speed);
+char TurnGentleLeft(char speed);
 
 /**
  * @Function TurnNormalLeft(char speed)
@@ -144,28 +232,14 @@ char TurnNormalLeft(char speed);
 char TurnSharpLeft(char speed);
 
 /**
- * @Function StepperForward()
- * @param none
- * @return none
- * @brief  This function is used to set the direction of the stepper to forward.
- */
-void StepperForward();
-
-/**
- * @Function StepperReverse()
- * @param none
- * @return none
- * @brief  This function is used to set the direction of the stepper to reverse.
- */
-void StepperReverse();
-
-/**
- * @Function StepperStop()
- * @param none
- * @return none
- * @brief  This function is used to set the direction of the stepper to reverse.
+ * @Function TurnHardLeft(char speed)
+ * @param newSpeed - A value between -100 and 100 which is the new speed
+ * @param of the motor. 0 stops the motor. A negative value is reverse.
+ * @return SUCCESS or ERROR
+ * @brief  This function is used to set the speed and direction of the both motors.
+ * The left wheel runs slowly backwards so the bot swings left around it.
  */
-void StepperStop();
+char TurnHardLeft(char speed);
 
 /**
  * @Function Bot_BatteryVoltage(void)
@@ -0,0 +1,353 @@
+/*
+ * File:   BotDrive.c
+ *
+ * Speed and curvature to wheel speeds for Bot_Drive, see BotDrive.h.
+ */
+
+#include "BOARD.h"
+#include "BotDrive.h"
+#include "pwm.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define BOT_DRIVE_TEST
+
+//Battery feed-forward. Duty is scaled by full/filtered battery so a command gives
+//the full charge wheel speed all through a discharge. Readings are the 10:1 AD
+//counts; a full pack sits near 310 and the AD lockout is 263. Below
+//BATTERY_COMP_MIN there is no pack (USB power) and duty goes out unscaled.
+#define BATTERY_FULL            310
+#define BATTERY_COMP_MIN        169
+#define BATTERY_COMP_MAX        1023
+#define BATTERY_SCALE_SHIFT     16
+#define BATTERY_SCALE_ONE       (1UL << BATTERY_SCALE_SHIFT)
+
+//Odometry, FieldSim's wheel model: a wheel runs at ODOM_FULL_SPEED_MM_PER_S at
+//BOT_MAX_SPEED, falling off straight to nothing at ODOM_DEAD_BAND
+#define ODOM_FULL_SPEED_MM_PER_S    300
+#define ODOM_DEAD_BAND              15
+#define ODOM_WHEEL_BASE_MM          210
+#define ODOM_STEP_MS                10
+#define ODOM_UM_PER_MM              1000
+#define ODOM_RADIAN_Q32             683565276LL     //2^32 / (2 * pi)
+#define ODOM_QUADRANT               0x4000
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+//sin() from 0 to 90 degrees in 64 steps, Q15
+static const int16_t SineTable[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767
+};
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static int32_t BotDrive_WheelStep(int16_t speed);
+static int16_t BotDrive_Sin(uint16_t angle);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void BotDrive_Wheels(int16_t speed, int16_t curvature, int16_t *left, int16_t *right)
+{
+    int16_t inner;
+
+    if (speed > BOT_MAX_SPEED) {
+        speed = BOT_MAX_SPEED;
+    } else if (speed < -BOT_MAX_SPEED) {
+        speed = -BOT_MAX_SPEED;
+    }
+    if (curvature > BOT_CURVATURE_SPIN) {
+        curvature = BOT_CURVATURE_SPIN;
+    } else if (curvature < -BOT_CURVATURE_SPIN) {
+        curvature = -BOT_CURVATURE_SPIN;
+    }
+
+    if (curvature < 0) {
+        inner = BotDrive_ScaleSpeed(speed, BOT_DRIVE_ONE + curvature);
+        *left = inner;
+        *right = speed;
+    } else {
+        inner = BotDrive_ScaleSpeed(speed, BOT_DRIVE_ONE - curvature);
+        *left = speed;
+        *right = inner;
+    }
+}
+
+int16_t BotDrive_ScaleSpeed(int16_t speed, int16_t scale)
+{
+    int32_t product = (int32_t) speed * scale;
+
+    if (product < 0) {
+        return -((-product) >> BOT_DRIVE_SHIFT);
+    }
+    return product >> BOT_DRIVE_SHIFT;
+}
+
+uint32_t BotDrive_BatteryScale(unsigned int battery)
+{
+    // over full charge the duty is left alone rather than cut
+    if ((battery < BATTERY_COMP_MIN) || (battery > BATTERY_COMP_MAX) || (battery >= BATTERY_FULL)) {
+        return BATTERY_SCALE_ONE;
+    }
+    return (BATTERY_FULL << BATTERY_SCALE_SHIFT) / battery;
+}
+
+uint16_t BotDrive_CompensateDuty(uint16_t duty, uint32_t scale)
+{
+    uint32_t pwm = ((duty * scale) + (BATTERY_SCALE_ONE >> 1)) >> BATTERY_SCALE_SHIFT;
+
+    if (pwm > MAX_PWM) {
+        pwm = MAX_PWM;
+    }
+    return pwm;
+}
+
+void BotDrive_ResetPose(BotDrive_Odometry_t *odometry, int32_t x, int32_t y, uint16_t theta, uint32_t now)
+{
+    odometry->x = x * ODOM_UM_PER_MM;
+    odometry->y = y * ODOM_UM_PER_MM;
+    odometry->theta = (uint32_t) theta << 16;
+    odometry->time = now;
+}
+
+void BotDrive_UpdatePose(BotDrive_Odometry_t *odometry, int16_t left, int16_t right, uint32_t now)
+{
+    uint32_t steps = (now - odometry->time) / ODOM_STEP_MS;
+    int32_t leftStep, rightStep, centerStep, thetaStep;
+    uint16_t heading;
+
+    if (steps == 0) {
+        return;
+    }
+    odometry->time += steps * ODOM_STEP_MS;
+    leftStep = BotDrive_WheelStep(left);
+    rightStep = BotDrive_WheelStep(right);
+    if ((leftStep == 0) && (rightStep == 0)) {
+        return;
+    }
+    centerStep = (leftStep + rightStep) / 2;
+    thetaStep = (int32_t) ((rightStep - leftStep) * ODOM_RADIAN_Q32
+            / (ODOM_WHEEL_BASE_MM * ODOM_UM_PER_MM));
+
+    while (steps--) {
+        // move along the heading halfway through the step
+        heading = (odometry->theta + (thetaStep / 2)) >> 16;
+        odometry->x += (centerStep * BotDrive_Sin(heading + ODOM_QUADRANT)) >> 15;
+        odometry->y += (centerStep * BotDrive_Sin(heading)) >> 15;
+        odometry->theta += thetaStep;
+    }
+}
+
+BotPose_t BotDrive_GetPose(const BotDrive_Odometry_t *odometry)
+{
+    BotPose_t pose;
+
+    pose.x = odometry->x / ODOM_UM_PER_MM;
+    pose.y = odometry->y / ODOM_UM_PER_MM;
+    pose.theta = odometry->theta >> 16;
+    return pose;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+// micrometers a wheel covers in one ODOM_STEP_MS step, forward positive
+static int32_t BotDrive_WheelStep(int16_t speed)
+{
+    int32_t step = (speed < 0) ? -speed : speed;
+
+    if (step <= ODOM_DEAD_BAND) {
+        return 0;
+    }
+    step = (step - ODOM_DEAD_BAND) * ODOM_FULL_SPEED_MM_PER_S * ODOM_STEP_MS
+            / (BOT_MAX_SPEED - ODOM_DEAD_BAND);
+    return (speed < 0) ? -step : step;
+}
+
+// sin(angle) in Q15 for BOT_ANGLE units, interpolated from the quarter wave table
+static int16_t BotDrive_Sin(uint16_t angle)
+{
+    uint16_t quadrant = angle >> 14;
+    uint16_t offset = angle & (ODOM_QUADRANT - 1);
+    uint16_t index;
+    int16_t value;
+
+    if (quadrant & 1) {
+        offset = ODOM_QUADRANT - offset;
+    }
+    index = offset >> 8;
+    value = SineTable[index];
+    if (index < 64) {
+        value += ((SineTable[index + 1] - value) * (offset & 0xFF)) >> 8;
+    }
+    if (quadrant & 2) {
+        value = -value;
+    }
+    return value;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef BOT_DRIVE_TEST
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "TestHarness.h"
+
+// Every turn helper at every speed, and past both ends, against the float
+// expressions the helpers used before: the outer wheel at speed, the inner one
+// at (char)(factor * speed). Plain C, so it runs on the host as well.
+#define TEST_SPEED_PAST 20
+
+// Then the odometry against FieldSim's wheel model worked out in closed form,
+// each wheel pair held for TEST_POSE_MS: within TEST_POSE_MM and TEST_POSE_DEGREES
+#define TEST_POSE_MS 2000
+#define TEST_POSE_MM 3
+#define TEST_POSE_DEGREES 1.0
+#define TEST_FULL_SPEED 300.0
+#define TEST_DEAD_BAND 0.15
+#define TEST_WHEEL_BASE 210.0
+
+// Then the battery compensation as the pack sags from over full to the AD
+// lockout, wheel speed modelled as duty * battery / full: it must hold the full
+// charge speed to within 1/1000 until the duty saturates, and never drop below
+// the uncompensated speed
+#define TEST_BATTERY_HIGH 330
+#define TEST_BATTERY_LOW 263
+
+//inner wheel factor of each Turn_t, in the order of BOT_TURN_CURVATURES
+static const double TurnFactor[NUM_TURNS] = {
+    1.0, -1.0, 0.9, 0.75, 0.5, -1.0, 0.9, 0.75, 0.5, -0.3
+};
+
+//left and right wheel speeds for the odometry check
+static const int16_t PoseWheels[][2] = {
+    {100, 100}, {-40, -40}, {100, -100}, {-60, 60}, {100, 50}, {30, 90}, {10, 100}
+};
+
+static double TestWheelSpeed(int16_t speed)
+{
+    double duty = abs(speed) / (double) BOT_MAX_SPEED;
+
+    if (duty <= TEST_DEAD_BAND) {
+        return 0;
+    }
+    duty = TEST_FULL_SPEED * (duty - TEST_DEAD_BAND) / (1 - TEST_DEAD_BAND);
+    return (speed < 0) ? -duty : duty;
+}
+
+int main(void)
+{
+    static const int16_t curvatures[NUM_TURNS] = {BOT_TURN_CURVATURES};
+    int16_t speed, outer, inner, left, right;
+    unsigned int checked = 0, mismatches = 0, battery;
+    uint8_t turn;
+    uint32_t scale;
+    uint16_t duty;
+    int32_t pwm, effective, target;
+
+    BOARD_Init();
+    printf("\nBotDrive test harness");
+    for (turn = 0; turn < NUM_TURNS; turn++) {
+        for (speed = -BOT_MAX_SPEED - TEST_SPEED_PAST; speed <= BOT_MAX_SPEED + TEST_SPEED_PAST; speed++) {
+            outer = speed;
+            if (outer > BOT_MAX_SPEED) {
+                outer = BOT_MAX_SPEED;
+            } else if (outer < -BOT_MAX_SPEED) {
+                outer = -BOT_MAX_SPEED;
+            }
+            inner = (char) (TurnFactor[turn] * outer);
+            BotDrive_Wheels(speed, curvatures[turn], &left, &right);
+            // right turns slow the right wheel, left turns the left one
+            if ((curvatures[turn] < 0) ? ((left != inner) || (right != outer)) :
+                    ((left != outer) || (right != inner))) {
+                if (mismatches < 10) {
+                    printf("\nturn %u speed %d: %d/%d, expected %d/%d", turn, speed, left, right,
+                            (curvatures[turn] < 0) ? inner : outer, (curvatures[turn] < 0) ? outer : inner);
+                }
+                mismatches++;
+            }
+            checked++;
+        }
+    }
+    printf("\n%u wheel pairs checked, %u mismatches\n", checked, mismatches);
+
+    for (turn = 0; turn < sizeof(PoseWheels) / sizeof(PoseWheels[0]); turn++) {
+        BotDrive_Odometry_t odometry;
+        BotPose_t pose;
+        double vl = TestWheelSpeed(PoseWheels[turn][0]), vr = TestWheelSpeed(PoseWheels[turn][1]);
+        double seconds = TEST_POSE_MS / 1000.0, omega = (vr - vl) / TEST_WHEEL_BASE;
+        double v = (vl + vr) / 2, x, y, theta = omega * seconds, degrees, modelDegrees;
+        uint32_t ms;
+
+        if (fabs(omega) < 1e-9) {
+            x = v * seconds;
+            y = 0;
+        } else {
+            x = v / omega * sin(theta);
+            y = v / omega * (1 - cos(theta));
+        }
+        BotDrive_ResetPose(&odometry, 0, 0, 0, 0);
+        // uneven updates, as the wheels change at any time
+        for (ms = 0; ms < TEST_POSE_MS; ms += 7) {
+            BotDrive_UpdatePose(&odometry, PoseWheels[turn][0], PoseWheels[turn][1], ms);
+        }
+        BotDrive_UpdatePose(&odometry, PoseWheels[turn][0], PoseWheels[turn][1], TEST_POSE_MS);
+        pose = BotDrive_GetPose(&odometry);
+        degrees = (int16_t) pose.theta * 360.0 / BOT_ANGLE_FULL_TURN;
+        modelDegrees = remainder(theta * 180 / M_PI, 360);
+        printf("\nwheels %d/%d: %ld,%ld mm %.1f degrees, model %.0f,%.0f mm %.1f degrees",
+                PoseWheels[turn][0], PoseWheels[turn][1], (long) pose.x, (long) pose.y, degrees,
+                x, y, modelDegrees);
+        if ((fabs(pose.x - x) > TEST_POSE_MM) || (fabs(pose.y - y) > TEST_POSE_MM) ||
+                (fabs(remainder(degrees - modelDegrees, 360)) > TEST_POSE_DEGREES)) {
+            printf(" MISMATCH");
+            mismatches++;
+        }
+    }
+    printf("\n");
+
+    for (battery = TEST_BATTERY_HIGH; battery >= TEST_BATTERY_LOW; battery--) {
+        scale = BotDrive_BatteryScale(battery);
+        for (duty = 0; duty <= MAX_PWM; duty += 50) {
+            pwm = BotDrive_CompensateDuty(duty, scale);
+            effective = pwm * battery / BATTERY_FULL;
+            target = (battery >= BATTERY_FULL) ? (int32_t) duty * battery / BATTERY_FULL : duty;
+            if ((pwm < duty) || ((pwm < MAX_PWM) && (abs(effective - target) > 1))) {
+                if (mismatches < 10) {
+                    printf("\nbattery %u duty %u: pwm %ld, speed %ld/1000", battery, duty, (long) pwm,
+                            (long) effective);
+                }
+                mismatches++;
+            }
+        }
+    }
+    if ((BotDrive_BatteryScale(0) != BATTERY_SCALE_ONE) ||
+            (BotDrive_CompensateDuty(MAX_PWM / 2, BotDrive_BatteryScale(100)) != MAX_PWM / 2)) {
+        printf("\nno pack: duty scaled");
+        mismatches++;
+    }
+    printf("\nbattery %d to %d checked, %u mismatches in all\n", TEST_BATTERY_HIGH, TEST_BATTERY_LOW,
+            mismatches);
+    TEST_HARNESS_END();
+    return mismatches != 0;
+}
+
+#endif // BOT_DRIVE_TEST
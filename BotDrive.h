@@ -0,0 +1,102 @@
+/*
+ * File:   BotDrive.h
+ *
+ * The wheel math behind Bot_Drive, apart from Bot.c so that it has no hardware
+ * in it and the field simulator (FieldSim.c) can link the very same code. A
+ * speed and a Q12 curvature become a speed for each wheel, in integer math only.
+ * Wheel speeds here are forward positive for both wheels, Bot.c negates the left
+ * one for its mirrored motor.
+ *
+ * Battery compensation of the wheel duties is here for the same reason, and so
+ * is the dead reckoning behind Bot_GetPose. With
+ * no encoders it integrates the commanded wheel speeds, and its wheel model is
+ * the simulator's: FULL_SPEED, WHEEL_BASE and DEAD_BAND in FieldSim.c.
+ */
+
+#ifndef BOT_DRIVE_H
+#define BOT_DRIVE_H
+
+#include "Bot.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// curvature and scale factors are Q12, BOT_DRIVE_ONE pivots on the inner wheel
+#define BOT_DRIVE_SHIFT 12
+#define BOT_DRIVE_ONE (1 << BOT_DRIVE_SHIFT)
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+// dead reckoned pose in micrometers with a 32 bit heading, so slow turns don't
+// round away
+typedef struct {
+    int32_t x;
+    int32_t y;
+    uint32_t theta;     // BOT_ANGLE units in the top 16 bits
+    uint32_t time;      // ms, end of the last whole step integrated
+} BotDrive_Odometry_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function BotDrive_Wheels(int16_t speed, int16_t curvature, int16_t *left, int16_t *right)
+ * @param speed - outer wheel speed, saturated at +-BOT_MAX_SPEED
+ * @param curvature - as for Bot_Drive, saturated at +-BOT_CURVATURE_SPIN
+ * @param left, right - filled in with each wheel's speed, forward positive
+ * @return None.
+ * @brief The inner wheel runs at speed * (1 - |curvature|/4096), truncated toward
+ *        zero so it matches the old (char)(factor * speed) float expressions. */
+void BotDrive_Wheels(int16_t speed, int16_t curvature, int16_t *left, int16_t *right);
+
+/**
+ * @Function BotDrive_ScaleSpeed(int16_t speed, int16_t scale)
+ * @param speed - wheel speed, -100 to 100
+ * @param scale - Q12 factor between -BOT_DRIVE_ONE and BOT_DRIVE_ONE
+ * @return speed * scale, truncated toward zero like a float to char cast */
+int16_t BotDrive_ScaleSpeed(int16_t speed, int16_t scale);
+
+/**
+ * @Function BotDrive_BatteryScale(unsigned int battery)
+ * @param battery - filtered battery reading in AD counts, 0 for none yet
+ * @return full pack / battery in Q16, 1.0 for a pack at or over full charge and
+ *         with no usable pack (USB power) */
+uint32_t BotDrive_BatteryScale(unsigned int battery);
+
+/**
+ * @Function BotDrive_CompensateDuty(uint16_t duty, uint32_t scale)
+ * @param duty - commanded duty, 0 to MAX_PWM
+ * @param scale - from BotDrive_BatteryScale
+ * @return duty * scale rounded, saturated at MAX_PWM */
+uint16_t BotDrive_CompensateDuty(uint16_t duty, uint32_t scale);
+
+/**
+ * @Function BotDrive_ResetPose(BotDrive_Odometry_t *odometry, int32_t x, int32_t y, uint16_t theta, uint32_t now)
+ * @param odometry - pose to reset
+ * @param x, y - known position in mm
+ * @param theta - known heading, see BOT_DEGREES
+ * @param now - current time in ms
+ * @return None. */
+void BotDrive_ResetPose(BotDrive_Odometry_t *odometry, int32_t x, int32_t y, uint16_t theta, uint32_t now);
+
+/**
+ * @Function BotDrive_UpdatePose(BotDrive_Odometry_t *odometry, int16_t left, int16_t right, uint32_t now)
+ * @param odometry - pose to advance
+ * @param left, right - wheel speeds since the last update, -100 to 100 forward positive
+ * @param now - current time in ms
+ * @return None.
+ * @brief Advances the pose in fixed 10ms steps up to now, call it before the wheel
+ *        speeds change. Leftover time carries to the next call. */
+void BotDrive_UpdatePose(BotDrive_Odometry_t *odometry, int16_t left, int16_t right, uint32_t now);
+
+/**
+ * @Function BotDrive_GetPose(const BotDrive_Odometry_t *odometry)
+ * @param odometry - pose as last updated
+ * @return the pose in mm and BOT_ANGLE units */
+BotPose_t BotDrive_GetPose(const BotDrive_Odometry_t *odometry);
+
+#endif /* BOT_DRIVE_H */
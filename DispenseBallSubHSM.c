@@ -33,6 +33,9 @@
 #include "ProjectHSM.h"
 #include "DispenseBallSubHSM.h"
 #include "Bot.h"
+#include "Stepper.h"
+#include "HSM_Engine.h"
+#include "TimerWheel.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -62,11 +65,24 @@ static const char *StateNames[] = {
 	"ReverseFromTower",
 	"RepositionFromTower",
 };
+STATE_STATS_DECLARE(Stats, "DispenseBallSubHSM", StateNames);
 
 //Include any defines you need to do
 #define OFFSET_TICKS 70
-#define DISPENSE_BALL_TICKS 1000
-#define DESCEND_STEPPER_TICKS 940
+//Lift positions are absolute steps up from the bottom, where the lift sits
+//when the bot is turned on. The top is 50 steps up, as far as the old 1000ms
+//lift at 50Hz went, and the descent is 47 steps, a little short of the bottom.
+//Lift moves ramp from DISPENSE_START_RATE toward DISPENSE_CRUISE_RATE (steps
+//per second) at DISPENSE_ACCEL. Neither move is long enough to reach cruise,
+//so they peak near 190Hz; the lift takes about 350ms and the descent about
+//330ms. DeliverBall and DescendStepper wait on STEPPER_DONE_EVENT, not a
+//timer, and the ball gets AT_TOP_TICKS to roll out before the descent.
+#define DISPENSE_START_RATE 100
+#define DISPENSE_CRUISE_RATE 250
+#define DISPENSE_ACCEL 500
+#define LIFT_BOTTOM_POSITION 0
+#define LIFT_TOP_POSITION 50
+#define DESCEND_STEPPER_STEPS 47
 #define AT_TOP_TICKS 500
 #define BACK_UP_FOR_BRIDGE_TICKS 125
 #define DISPENSE_TANK_TO_FRONT 575
@@ -81,6 +97,18 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void StartLift(ES_Event *ThisEvent);
+static void MoveLift(int32_t position);
+static void StopAtTape(ES_Event *ThisEvent);
+static void ReportDispensed(ES_Event *ThisEvent);
+static void EnterFixOffset(void);
+static void EnterTankToFront(void);
+static void EnterRamWall(void);
+static void EnterDeliverBall(void);
+static void EnterStayAtTop(void);
+static void EnterDescendStepper(void);
+static void EnterReverseFromTower(void);
+static void EnterRepositionFromTower(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -88,8 +116,94 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static DispenseBallSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a DispenseBallSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
+//the timed states share one timer, leaving one stops it, named before ProjectHSM
+//verifies the machine
+static TimerWheel_Timer_t DispenseTimer = TIMER_WHEEL_TIMER(DISPENSE_BALL_TIMER, PostProjectHSM);
+
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, FixOffset, NULL, StartLift},
+};
+
+static const HSM_Transition_t FixOffsetTransitions[] = {
+    {ES_TIMEOUT, DISPENSE_BALL_TIMER, TankToFront, NULL, NULL},
+};
+
+static const HSM_Transition_t TankToFrontTransitions[] = {
+    {ES_TIMEOUT, DISPENSE_BALL_TIMER, RamWall, NULL, NULL},
+};
+
+static const HSM_Transition_t RamWallTransitions[] = {
+    {ES_TIMEOUT, DISPENSE_BALL_TIMER, DeliverBall, NULL, NULL},
+};
+
+static const HSM_Transition_t DeliverBallTransitions[] = {
+    {STEPPER_DONE_EVENT, HSM_ANY_PARAM, StayAtTop, NULL, NULL},
+};
+
+static const HSM_Transition_t StayAtTopTransitions[] = {
+    {ES_TIMEOUT, DISPENSE_BALL_TIMER, DescendStepper, NULL, NULL},
+};
+
+//Stopping on tape leaves the event for the levels above
+static const HSM_Transition_t DescendStepperTransitions[] = {
+    {BC_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, HSM_NO_TARGET, NULL, StopAtTape},
+    {STEPPER_DONE_EVENT, HSM_ANY_PARAM, ReverseFromTower, NULL, NULL},
+};
+
+static const HSM_Transition_t ReverseFromTowerTransitions[] = {
+    {ES_TIMEOUT, DISPENSE_BALL_TIMER, RepositionFromTower, NULL, NULL},
+    {BC_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, HSM_NO_TARGET, NULL, StopAtTape},
+};
+
+//Turns until the beacon is out of sight, then tells ProjectHSM it is done
+static const HSM_Transition_t RepositionFromTowerTransitions[] = {
+    {NO_BEACON_EVENT, HSM_ANY_PARAM, HSM_NO_TARGET, NULL, ReportDispensed},
+};
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [FixOffset] =
+    {EnterFixOffset, NULL, NULL, NULL, HSM_TRANSITIONS(FixOffsetTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT), &DispenseTimer},
+    [TankToFront] =
+    {EnterTankToFront, NULL, NULL, NULL, HSM_TRANSITIONS(TankToFrontTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT), &DispenseTimer},
+    [RamWall] =
+    {EnterRamWall, NULL, NULL, NULL, HSM_TRANSITIONS(RamWallTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT), &DispenseTimer},
+    //not used
+    [BackUpForDrawbridge] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [DeliverBall] =
+    {EnterDeliverBall, NULL, NULL, NULL, HSM_TRANSITIONS(DeliverBallTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(STEPPER_DONE_EVENT)},
+    [StayAtTop] =
+    {EnterStayAtTop, NULL, NULL, NULL, HSM_TRANSITIONS(StayAtTopTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT), &DispenseTimer},
+    [DescendStepper] =
+    {EnterDescendStepper, NULL, NULL, NULL, HSM_TRANSITIONS(DescendStepperTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(STEPPER_DONE_EVENT)},
+    [ReverseFromTower] =
+    {EnterReverseFromTower, NULL, NULL, NULL, HSM_TRANSITIONS(ReverseFromTowerTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT), &DispenseTimer},
+    [RepositionFromTower] =
+    {EnterRepositionFromTower, NULL, NULL, NULL, HSM_TRANSITIONS(RepositionFromTowerTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(NO_BEACON_EVENT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t DispenseBallSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
 
 
 /*******************************************************************************
@@ -110,6 +224,9 @@ uint8_t InitDispenseBallSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&DispenseBallSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunDispenseBallSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -133,175 +250,8 @@ uint8_t InitDispenseBallSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunDispenseBallSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    DispenseBallSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                nextState = FixOffset;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case FixOffset:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(60);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, OFFSET_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = TankToFront;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case TankToFront: // in the first state, replace this with correct names
-            if (ThisEvent.EventType == ES_ENTRY) {
-                TankLeft(100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, DISPENSE_TANK_TO_FRONT);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = RamWall;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case RamWall:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                DriveStraight(100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, DISPENSE_RAM_WALL_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&(ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = DeliverBall;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case DeliverBall:
-            //Have stepper move upward.
-            if (ThisEvent.EventType == ES_ENTRY) {
-                StepperForward();
-                //StepperReverse();
-                DriveStraight(0);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, DISPENSE_BALL_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = StayAtTop;
-                makeTransition = TRUE;
-                ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case StayAtTop:
-            if (ThisEvent.EventType == ES_ENTRY){
-                StepperStop();
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, AT_TOP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = DescendStepper;
-                makeTransition = TRUE;
-                ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case DescendStepper:
-            /*
-             * We will need to do more than just reverse from the tower as there
-             * is a possibility that a tower is behind the tower that we just
-             * dispensed a ball into. Thus, we will continuously hit the tower that
-             * we just finished and never get to the next towers.
-             */
-            if (ThisEvent.EventType == ES_ENTRY) {
-                DriveStraight(0);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, DESCEND_STEPPER_TICKS);
-                StepperReverse();
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = ReverseFromTower;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT) {
-                DriveStraight(0);
-            }
-            break;
-            
-            case ReverseFromTower:
-            /*
-             * We will need to do more than just reverse from the tower as there
-             * is a possibility that a tower is behind the tower that we just
-             * dispensed a ball into. Thus, we will continuously hit the tower that
-             * we just finished and never get to the next towers.
-             */
-            if (ThisEvent.EventType == ES_ENTRY) {
-                StepperStop();
-                DriveStraight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, DISPENSE_RAM_WALL_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = RepositionFromTower;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT) {
-                DriveStraight(0);
-            }
-            break;
-
-        case RepositionFromTower:
-            //Turn away from tower.
-            if (ThisEvent.EventType == ES_ENTRY) {
-                TankRight(85); 
-            }
-            
-            if (ThisEvent.EventType == NO_BEACON_EVENT) {
-                ThisEvent.EventType = BALL_DISPENSED_EVENT;
-            }
-            break;
-
-        default: // all unhandled states fall into here
-            break;
-            
-            //        case BackUpForDrawbridge:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                //Have stepper move downward here. Stepper starts at the bottom.
-//                //StepperReverse();
-//                DriveStraight(-90);
-//                ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, BACK_UP_FOR_BRIDGE_TICKS);
-//            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = DeliverBall;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            if (ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT) {
-//                DriveStraight(0);
-//            }
-//            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunDispenseBallSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunDispenseBallSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&DispenseBallSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -309,4 +259,89 @@ ES_Event RunDispenseBallSubHSM(ES_Event ThisEvent) {
 
 /*******************************************************************************
  * PRIVATE FUNCTIONS                                                           *
- ******************************************************************************/
\ No newline at end of file
+ ******************************************************************************/
+
+/**
+ * @Function StartLift(ES_Event *ThisEvent)
+ * @brief Action out of the initial pseudo-state. Lift travel is bounded, and a
+ *        lift left up by an interrupted dispense goes back down on the way in.
+ *        Lift moves are profiled; a lift still moving from before keeps the
+ *        same profile, which can't change under it.
+ */
+static void StartLift(ES_Event *ThisEvent) {
+    Stepper_SetProfile(DISPENSE_START_RATE, DISPENSE_CRUISE_RATE, DISPENSE_ACCEL);
+    Stepper_SetLimits(LIFT_BOTTOM_POSITION, LIFT_TOP_POSITION);
+    Stepper_MoveTo(LIFT_BOTTOM_POSITION);
+}
+
+/**
+ * @Function MoveLift(int32_t position)
+ * @brief Moves the lift for the states that wait on STEPPER_DONE_EVENT. When
+ *        no move starts, because the stepper is off, homing or already there,
+ *        the checker will never see one end, so the event is posted here.
+ *        A move under way that stops where it is ends on its own.
+ */
+static void MoveLift(int32_t position) {
+    uint8_t wasStepping = Stepper_IsStepping();
+
+    if ((Stepper_MoveTo(position) == ERROR) || (!wasStepping && !Stepper_IsStepping())) {
+        ES_Event DoneEvent;
+        DoneEvent.EventType = STEPPER_DONE_EVENT;
+        DoneEvent.EventParam = Stepper_GetDirection();
+        PostProjectHSM(DoneEvent);
+    }
+}
+
+static void StopAtTape(ES_Event *ThisEvent) {
+    DriveStraight(0);
+}
+
+static void ReportDispensed(ES_Event *ThisEvent) {
+    ThisEvent->EventType = BALL_DISPENSED_EVENT;
+}
+
+static void EnterFixOffset(void) {
+    DriveStraight(60);
+    TimerWheel_Start(&DispenseTimer, OFFSET_TICKS);
+}
+
+static void EnterTankToFront(void) {
+    TankLeft(100);
+    TimerWheel_Start(&DispenseTimer, DISPENSE_TANK_TO_FRONT);
+}
+
+static void EnterRamWall(void) {
+    DriveStraight(100);
+    TimerWheel_Start(&DispenseTimer, DISPENSE_RAM_WALL_TICKS);
+}
+
+//Have stepper move upward.
+static void EnterDeliverBall(void) {
+    DriveStraight(0);
+    MoveLift(LIFT_TOP_POSITION);
+}
+
+static void EnterStayAtTop(void) {
+    TimerWheel_Start(&DispenseTimer, AT_TOP_TICKS);
+}
+
+/*
+ * We will need to do more than just reverse from the tower as there
+ * is a possibility that a tower is behind the tower that we just
+ * dispensed a ball into. Thus, we will continuously hit the tower that
+ * we just finished and never get to the next towers.
+ */
+static void EnterDescendStepper(void) {
+    DriveStraight(0);
+    MoveLift(LIFT_TOP_POSITION - DESCEND_STEPPER_STEPS);
+}
+
+static void EnterReverseFromTower(void) {
+    DriveStraight(-100);
+    TimerWheel_Start(&DispenseTimer, DISPENSE_RAM_WALL_TICKS);
+}
+
+//Turn away from tower.
+static void EnterRepositionFromTower(void) {
+    TankRight(85);
+}
@@ -26,6 +26,7 @@
  ******************************************************************************/
 
 #include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
@@ -36,6 +37,8 @@
  * PUBLIC TYPEDEFS                                                             *
  ******************************************************************************/
 
+// the machine itself, for a converted machine above to dispatch to directly
+extern const HSM_Machine_t DispenseBallSubHSM;
 
 /*******************************************************************************
  * PUBLIC FUNCTION PROTOTYPES                                                  *
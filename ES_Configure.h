@@ -74,6 +74,8 @@ typedef enum {
     GOT_PARALLEL_EVENT,
     CORRECT_HOLE_FOUND_EVENT,
     BALL_DISPENSED_EVENT,
+    STEPPER_DONE_EVENT,
+    LANE_WAKE_EVENT, /* a service has an event waiting in its EventLanes */
 } ES_EventTyp_t;
 
 static const char *EventNames[] = {
@@ -117,6 +119,8 @@ static const char *EventNames[] = {
 	"GOT_PARALLEL_EVENT",
 	"CORRECT_HOLE_FOUND_EVENT",
 	"BALL_DISPENSED_EVENT",
+	"STEPPER_DONE_EVENT",
+	"LANE_WAKE_EVENT",
 };
 
 
@@ -127,8 +131,9 @@ static const char *EventNames[] = {
 #define EVENT_CHECK_HEADER "ProjectEventChecker.h"
 
 /****************************************************************************/
-// This is the list of event checking functions
-#define EVENT_CHECK_LIST WireSensorChecker, BeaconDetectorChecker, FLTapeChecker, FRTapeChecker, BCTapeChecker, LeftBallTapeChecker,
+// This is the list of event checking functions. IdleChecker has to stay last,
+// it waits for the next interrupt (see Idle.h)
+#define EVENT_CHECK_LIST WireSensorChecker, BeaconDetectorChecker, FLTapeChecker, FRTapeChecker, BCTapeChecker, LeftBallTapeChecker, StepperDoneChecker, TimerWheelChecker, IdleChecker,
 
 /****************************************************************************/
 // These are the definitions for the post functions to be executed when the
@@ -167,6 +172,10 @@ static const char *EventNames[] = {
 #define SUB_TRANSITION_TIMER 2
 #define SUB_SUB_TRANSITION_TIMER 3
 
+// TimerWheel timers, as many as needed, numbered from TIMER_WHEEL_FIRST_ID up
+// (see TimerWheel.h). Each one's post function is given where it is set up
+#define DISPENSE_BALL_TIMER 16
+
 /****************************************************************************/
 // The maximum number of services sets an upper bound on the number of 
 // services that the framework will handle. Reasonable values are 8 and 16
@@ -201,7 +210,8 @@ static const char *EventNames[] = {
 #define SERV_1_INIT InitBumperService
 // the name of the run function
 #define SERV_1_RUN RunBumperService
-// How big should this services Queue be?
+// How big should this services Queue be? Size it from a recorded run with
+// the QueueStats replay tool, see QueueStats.h
 #define SERV_1_QUEUE_SIZE 3
 #endif
 
@@ -213,8 +223,14 @@ static const char *EventNames[] = {
 #define SERV_2_INIT InitProjectHSM
 // the name of the run function
 #define SERV_2_RUN RunProjectHSM
-// How big should this services Queue be?
-#define SERV_2_QUEUE_SIZE 3
+// How big should this services Queue be? Size it from a recorded run with
+// the QueueStats replay tool, see QueueStats.h. ProjectHSM's events wait in its
+// EventLanes, the queue only holds the one LANE_WAKE_EVENT for them: it held
+// at most 1 over 100 FieldSim matches, the other slot is for an ES_PostAll
+#define SERV_2_QUEUE_SIZE 2
+// Events ProjectHSM runs ahead of everything else it has queued, see
+// EventLanes.h. Both edges of a sensor go in together so they stay in order.
+#define SERV_2_URGENT_EVENTS FL_BUMP_EVENT, FR_BUMP_EVENT, FC_BUMP_EVENT, NO_FL_BUMP_EVENT, NO_FR_BUMP_EVENT, NO_FC_BUMP_EVENT, FL_TAPE_SEE_BLACK_EVENT, FL_TAPE_SEE_WHITE_EVENT, FR_TAPE_SEE_BLACK_EVENT, FR_TAPE_SEE_WHITE_EVENT, BC_TAPE_SEE_BLACK_EVENT, BC_TAPE_SEE_WHITE_EVENT,
 #endif
 
 
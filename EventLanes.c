@@ -0,0 +1,318 @@
+/*
+ * File:   EventLanes.c
+ *
+ * Two lane event queue for urgent events, see EventLanes.h.
+ */
+
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "EventLanes.h"
+#include "HW_Regs.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define EVENT_LANES_TEST
+
+#define LANE_MASK (EVENT_LANE_SIZE - 1)
+#define EVENT_BIT(event) ((uint64_t) 1 << (event))
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void EventLanes_Init(EventLanes_t *lanes, const ES_EventTyp_t *urgent, uint8_t numUrgent)
+{
+    uint8_t i;
+
+    for (i = 0; i < EVENT_LANES; i++) {
+        lanes->lane[i].head = 0;
+        lanes->lane[i].count = 0;
+    }
+    lanes->urgent = 0;
+    for (i = 0; i < numUrgent; i++) {
+        lanes->urgent |= EVENT_BIT(urgent[i]);
+    }
+    lanes->headOvertaken = 0;
+    lanes->maxOvertaken = 0;
+    lanes->overtaken = 0;
+    lanes->overflows = 0;
+    lanes->highWater = 0;
+    lanes->poppedAt = 0;
+}
+
+int8_t EventLanes_Push(EventLanes_t *lanes, ES_Event ThisEvent)
+{
+    EventLane_t *lane = &lanes->lane[(lanes->urgent & EVENT_BIT(ThisEvent.EventType)) ?
+            EVENT_LANE_URGENT : EVENT_LANE_NORMAL];
+
+    if (lane->count == EVENT_LANE_SIZE) {
+        lanes->overflows++;
+        return ERROR;
+    }
+    lane->events[(lane->head + lane->count) & LANE_MASK] = ThisEvent;
+    lane->pushedAt[(lane->head + lane->count) & LANE_MASK] = _CP0_GET_COUNT();
+    lane->count++;
+    if (lane->count > lanes->highWater) {
+        lanes->highWater = lane->count;
+    }
+    return SUCCESS;
+}
+
+int8_t EventLanes_Pop(EventLanes_t *lanes, ES_Event *ThisEvent)
+{
+    EventLane_t *urgent = &lanes->lane[EVENT_LANE_URGENT];
+    EventLane_t *normal = &lanes->lane[EVENT_LANE_NORMAL];
+    EventLane_t *lane;
+
+    if ((urgent->count > 0) &&
+            ((normal->count == 0) || (lanes->headOvertaken < EVENT_LANES_MAX_OVERTAKE))) {
+        lane = urgent;
+        if (normal->count > 0) {
+            lanes->overtaken++;
+            lanes->headOvertaken++;
+            if (lanes->headOvertaken > lanes->maxOvertaken) {
+                lanes->maxOvertaken = lanes->headOvertaken;
+            }
+        }
+    } else if (normal->count > 0) {
+        lane = normal;
+        lanes->headOvertaken = 0;
+    } else {
+        return ERROR;
+    }
+    *ThisEvent = lane->events[lane->head];
+    lanes->poppedAt = lane->pushedAt[lane->head];
+    lane->head = (lane->head + 1) & LANE_MASK;
+    lane->count--;
+    return SUCCESS;
+}
+
+uint8_t EventLanes_Count(const EventLanes_t *lanes)
+{
+    return lanes->lane[EVENT_LANE_URGENT].count + lanes->lane[EVENT_LANE_NORMAL].count;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef EVENT_LANES_TEST
+
+#include <stdio.h>
+#include <string.h>
+#include "ProjectHSM.h"
+#include "Bot.h"
+#include "Stepper.h"
+
+// The framework takes one event from ProjectHSM's queue per tick, or one every
+// few ticks when the other services keep it busy. Beacon and track wire edges
+// come in bursts, and tape and bump edges turn up in the middle of them. Waits
+// are in ticks from post to run.
+#define TRACE_TICKS 10000
+#define BURST_EVERY 40
+#define BURST_LENGTH 6
+#define SAFETY_EVERY 7
+
+static const ES_EventTyp_t noise[] = {
+    BEACON_FOUND_EVENT, NO_BEACON_EVENT, TRACK_WIRE_FOUND_EVENT, NO_TRACK_WIRE_EVENT,
+};
+static const ES_EventTyp_t safety[] = {
+    FL_TAPE_SEE_BLACK_EVENT, FL_TAPE_SEE_WHITE_EVENT, FC_BUMP_EVENT, NO_FC_BUMP_EVENT,
+};
+
+typedef struct {
+    uint32_t runs, totalWait;
+    uint16_t maxWait;
+} WaitStats_t;
+
+// the time, ProjectHSM's framework queue, and the waits of what it ran
+static uint32_t Tick;
+static ES_Event FrameworkQueue[SERV_2_QUEUE_SIZE];
+static uint8_t QueueHead, QueueCount;
+static WaitStats_t Stats[EVENT_LANES];
+static uint32_t LastSafety;
+static uint8_t OutOfOrder;
+
+/* No drivers, and the core timer counts ticks. RunProjectHSM opens a latency
+ * measurement for every event it takes from the lanes, which is where the
+ * waits are counted. */
+uint32_t HW_RegsCoreTicks(void)
+{
+    return Tick;
+}
+
+void Latency_Open(ES_EventTyp_t type, uint32_t postedAt)
+{
+    WaitStats_t *s = &Stats[EVENT_LANE_NORMAL];
+    uint16_t wait = Tick - postedAt;
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        if (type == safety[i]) {
+            s = &Stats[EVENT_LANE_URGENT];
+            // edges of one sensor have to come out in order, the ones the
+            // machine had no use for never went in
+            OutOfOrder += (postedAt < LastSafety);
+            LastSafety = postedAt;
+        }
+    }
+    s->runs++;
+    s->totalWait += wait;
+    if (wait > s->maxWait) {
+        s->maxWait = wait;
+    }
+}
+
+void Latency_Close(void)
+{
+}
+
+uint8_t ES_PostToService(uint8_t WhichService, ES_Event TheEvent)
+{
+    if (QueueCount == SERV_2_QUEUE_SIZE) {
+        return FALSE;
+    }
+    FrameworkQueue[(QueueHead + QueueCount++) % SERV_2_QUEUE_SIZE] = TheEvent;
+    return TRUE;
+}
+
+int8_t ES_Timer_InitTimer(uint8_t Num, uint32_t NewTime)
+{
+    return SUCCESS;
+}
+
+int8_t ES_Timer_StopTimer(uint8_t Num)
+{
+    return SUCCESS;
+}
+
+uint32_t ES_Timer_GetTime(void)
+{
+    return Tick;
+}
+
+unsigned char Bot_ReadBumpers(void)
+{
+    return 0;
+}
+
+unsigned int Bot_ReadTrackWireVoltage(void)
+{
+    return 0;
+}
+
+char Bot_LEDSSet(uint16_t pattern)
+{
+    return SUCCESS;
+}
+
+BotPose_t Bot_GetPose(void)
+{
+    BotPose_t pose = {0, 0, 0};
+
+    return pose;
+}
+
+void Bot_ResetPose(int32_t x, int32_t y, uint16_t theta)
+{
+}
+
+int8_t Stepper_SetProfile(uint16_t startRate, uint16_t cruiseRate, uint16_t accel)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_SetLimits(int32_t minPosition, int32_t maxPosition)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_MoveTo(int32_t position)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_GetDirection(void)
+{
+    return 0;
+}
+
+int8_t Stepper_IsStepping(void)
+{
+    return FALSE;
+}
+
+#define DRIVE_STUB(name) \
+    char name(char speed) \
+    { \
+        return SUCCESS; \
+    }
+
+DRIVE_STUB(DriveStraight)
+DRIVE_STUB(TankRight)
+DRIVE_STUB(TurnGentleRight)
+DRIVE_STUB(TurnNormalRight)
+DRIVE_STUB(TurnSharpRight)
+DRIVE_STUB(TankLeft)
+DRIVE_STUB(TurnGentleLeft)
+DRIVE_STUB(TurnNormalLeft)
+DRIVE_STUB(TurnSharpLeft)
+DRIVE_STUB(TurnHardLeft)
+
+static void Post(ES_EventTyp_t type, uint32_t *lost)
+{
+    ES_Event ThisEvent = {type, 0};
+
+    *lost += (PostProjectHSM(ThisEvent) == FALSE);
+}
+
+static void Replay(uint8_t runEvery)
+{
+    const EventLanes_t *lanes = GetProjectHSMLanes();
+    ES_Event ThisEvent;
+    uint32_t lost = 0;
+    uint8_t i, safetyNext = 0;
+
+    Tick = 0;
+    QueueHead = 0;
+    QueueCount = 0;
+    memset(Stats, 0, sizeof(Stats));
+    LastSafety = 0;
+    OutOfOrder = 0;
+    InitProjectHSM(0);
+    for (Tick = 0; Tick < TRACE_TICKS; Tick++) {
+        if (Tick % BURST_EVERY < BURST_LENGTH) {
+            for (i = 0; i < 2; i++) {
+                Post(noise[(Tick + i) % 4], &lost);
+            }
+        }
+        if (Tick % SAFETY_EVERY == 0) {
+            Post(safety[safetyNext++ % 4], &lost);
+        }
+        if ((Tick % runEvery == 0) && (QueueCount > 0)) {
+            ThisEvent = FrameworkQueue[QueueHead];
+            QueueHead = (QueueHead + 1) % SERV_2_QUEUE_SIZE;
+            QueueCount--;
+            RunProjectHSM(ThisEvent);
+        }
+    }
+    printf("\nrun every %u: safety edges: worst %2u ticks, mean %lu.%02lu; others: worst %2u ticks;"
+            " %lu overtakes, %lu lost, %u out of order; queue held %u of %u",
+            runEvery, Stats[EVENT_LANE_URGENT].maxWait,
+            (unsigned long) (Stats[EVENT_LANE_URGENT].totalWait / Stats[EVENT_LANE_URGENT].runs),
+            (unsigned long) ((Stats[EVENT_LANE_URGENT].totalWait * 100 / Stats[EVENT_LANE_URGENT].runs) % 100),
+            Stats[EVENT_LANE_NORMAL].maxWait, (unsigned long) lanes->overtaken, (unsigned long) lost,
+            OutOfOrder, GetProjectHSMQueueStats()->highWater, SERV_2_QUEUE_SIZE);
+}
+
+int main(void)
+{
+    printf("\nProjectHSM bursty trace replay, %u ticks", TRACE_TICKS);
+    Replay(1);
+    Replay(4);
+    printf("\n");
+    return 0;
+}
+
+#endif // EVENT_LANES_TEST
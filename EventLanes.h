@@ -0,0 +1,114 @@
+/*
+ * File:   EventLanes.h
+ *
+ * Two priority lanes for a service's pending events. The framework's queues are
+ * one FIFO each, so an urgent event waits behind everything posted before it.
+ * A service that keeps its events here instead, and only posts to its framework
+ * queue to be woken, runs the urgent lane first:
+ *   Post:  EventLanes_Push(&Lanes, ThisEvent), and post to the framework queue
+ *          if EventLanes_Count was 0 before it and no run is under way
+ *   Run:   EventLanes_Pop(&Lanes, &ThisEvent) until it returns ERROR
+ * Only the first event into empty lanes wakes the service, and that run takes
+ * every event there, so the framework queue never fills up with wakes while an
+ * urgent event is left with nowhere to go.
+ *
+ * Which events are urgent is a list of event types. Each lane stays in order, so
+ * both edges of a sensor (FL_BUMP_EVENT and NO_FL_BUMP_EVENT) have to be in the
+ * same lane or a release could be run before the bump it ends.
+ *
+ * Push and pop are O(1). Urgent events never wait behind normal ones, except
+ * that a normal event is taken anyway once EVENT_LANES_MAX_OVERTAKE urgent
+ * events have gone ahead of it, so neither lane can starve the other. The
+ * overtake counts are kept for checking how close that comes.
+ *
+ * Each event is stamped with the core timer as it is pushed, and the stamp of
+ * the one Pop last took is kept in poppedAt, for Latency.
+ *
+ * EVENT_LANES_TEST (in the .c file) conditionally compiles a replay of a bursty
+ * event trace through PostProjectHSM and RunProjectHSM, built on the PC with the
+ * machine code and no drivers:
+ *   gcc -DEVENT_LANES_TEST -I. EventLanes.c ProjectHSM.c ProjectInitialSubHSM.c \
+ *       ProjectBeaconFindingSubHSM.c TapeFollowingSubSubHSM.c WallFollowingSubHSM.c \
+ *       StayingInBoundsTowerSubHSM.c GetParallelSubHSM.c FindingCorrectHoleSubHSM.c \
+ *       DispenseBallSubHSM.c HSM_Engine.c QueueStats.c TimerWheel.c -o lanes && ./lanes
+ */
+
+#ifndef EVENT_LANES_H
+#define EVENT_LANES_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// events each lane holds, a power of two
+#define EVENT_LANE_SIZE 8
+// urgent events a waiting normal event lets past before it is taken anyway
+#define EVENT_LANES_MAX_OVERTAKE 8
+
+#define EVENT_LANE_URGENT 0
+#define EVENT_LANE_NORMAL 1
+#define EVENT_LANES 2
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct {
+    ES_Event events[EVENT_LANE_SIZE];
+    uint32_t pushedAt[EVENT_LANE_SIZE]; // core timer at the push
+    uint8_t head;
+    uint8_t count;
+} EventLane_t;
+
+typedef struct {
+    EventLane_t lane[EVENT_LANES];
+    uint64_t urgent; // bit per urgent event type
+    uint8_t headOvertaken; // urgent events run ahead of the oldest normal one
+    uint8_t maxOvertaken; // most any normal event has let past
+    uint32_t overtaken; // urgent events run while a normal one waited
+    uint16_t overflows; // pushes a full lane refused
+    uint8_t highWater; // most events one lane has held
+    uint32_t poppedAt; // core timer when the last event popped was pushed
+} EventLanes_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function EventLanes_Init(EventLanes_t *lanes, const ES_EventTyp_t *urgent, uint8_t numUrgent)
+ * @param lanes - the lanes to set up, empty afterwards
+ * @param urgent, numUrgent - the event types that go in the urgent lane
+ * @return None.
+ */
+void EventLanes_Init(EventLanes_t *lanes, const ES_EventTyp_t *urgent, uint8_t numUrgent);
+
+/**
+ * @Function EventLanes_Push(EventLanes_t *lanes, ES_Event ThisEvent)
+ * @param lanes - the lanes
+ * @param ThisEvent - the event to queue, its type picks the lane
+ * @return SUCCESS, or ERROR if that lane is full
+ */
+int8_t EventLanes_Push(EventLanes_t *lanes, ES_Event ThisEvent);
+
+/**
+ * @Function EventLanes_Pop(EventLanes_t *lanes, ES_Event *ThisEvent)
+ * @param lanes - the lanes
+ * @param ThisEvent - filled in with the next event to run
+ * @return SUCCESS, or ERROR and ThisEvent and poppedAt untouched if both lanes
+ *         are empty
+ * @brief The oldest urgent event, or the oldest normal one if there are no
+ *        urgent ones or it has waited out EVENT_LANES_MAX_OVERTAKE of them.
+ */
+int8_t EventLanes_Pop(EventLanes_t *lanes, ES_Event *ThisEvent);
+
+/**
+ * @Function EventLanes_Count(const EventLanes_t *lanes)
+ * @param lanes - the lanes
+ * @return the events waiting in both of them
+ */
+uint8_t EventLanes_Count(const EventLanes_t *lanes);
+
+#endif /* EVENT_LANES_H */
@@ -0,0 +1,489 @@
+/*
+ * File:   EventRecorder.c
+ *
+ * Records ProjectHSM's events, sensor reads and commands, see EventRecorder.h.
+ * The same file built with EVENT_RECORDER_REPLAY is the replay tool.
+ */
+
+#include <stdio.h>
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "EventRecorder.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+// a record is a tag byte, kind in the top 3 bits and the milliseconds since the
+// record before in the rest, then an id byte and a 16 bit value, low byte first.
+// A tag with RECORD_TIME_FOLLOWS for the milliseconds is followed by the whole
+// time first, low byte first, so is the first record.
+#define KIND_POST 0 // posted from outside a run, id the type, value the param
+#define KIND_RUN 1 // a run, with the event the framework passed in
+#define KIND_INNER_POST 2 // posted during a run, the replay posts it itself
+#define KIND_SENSOR 3 // id a RECORDER_ sensor, value what was read
+#define KIND_COMMAND 4 // id a Turn_t or RECORDER_STEPPER_MOVE, value signed
+
+#define RECORD_KIND_SHIFT 5
+#define RECORD_TIME_FOLLOWS 0x1F
+#define RECORD_SIZE 4
+#define RECORD_TIME_SIZE 4
+
+#define DUMP_LINE_BYTES 32
+
+// without EVENT_RECORDER nothing calls the recorder, and the buffer stays out of RAM
+#if defined(EVENT_RECORDER) && !defined(EVENT_RECORDER_REPLAY)
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static void Record(uint8_t kind, uint8_t id, uint16_t value);
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+static uint8_t Buffer[RECORDER_BUFFER_SIZE];
+static uint16_t Length;
+static uint32_t LastTime;
+static uint8_t InRun = FALSE;
+// records after the buffer filled, nothing is recorded once one is dropped
+static uint32_t Dropped;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void Recorder_Post(ES_Event ThisEvent)
+{
+    Record((InRun == TRUE) ? KIND_INNER_POST : KIND_POST, ThisEvent.EventType,
+            ThisEvent.EventParam);
+}
+
+void Recorder_Run(ES_Event ThisEvent)
+{
+    Record(KIND_RUN, ThisEvent.EventType, ThisEvent.EventParam);
+    InRun = TRUE;
+}
+
+void Recorder_RunDone(void)
+{
+    InRun = FALSE;
+}
+
+uint16_t Recorder_Sensor(uint8_t sensor, uint16_t value)
+{
+    if (InRun == TRUE) {
+        Record(KIND_SENSOR, sensor, value);
+    }
+    return value;
+}
+
+void Recorder_Command(uint8_t command, int16_t value)
+{
+    if (InRun == TRUE) {
+        Record(KIND_COMMAND, command, (uint16_t) value);
+    }
+}
+
+void Recorder_Dump(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < Length; i++) {
+        if ((i % DUMP_LINE_BYTES) == 0) {
+            printf("R:");
+        }
+        printf("%02X", Buffer[i]);
+        if (((i % DUMP_LINE_BYTES) == DUMP_LINE_BYTES - 1) || (i == Length - 1)) {
+            printf("\r\n");
+        }
+    }
+    printf("R:END %lu dropped\r\n", (unsigned long) Dropped);
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static void Record(uint8_t kind, uint8_t id, uint16_t value)
+{
+    uint32_t now = ES_Timer_GetTime();
+    uint32_t elapsed = now - LastTime;
+    uint16_t size = RECORD_SIZE;
+
+    if ((Length == 0) || (elapsed >= RECORD_TIME_FOLLOWS)) {
+        elapsed = RECORD_TIME_FOLLOWS;
+        size += RECORD_TIME_SIZE;
+    }
+    // stop at the first record that does not fit, a replay can only use the start
+    if ((Dropped > 0) || (Length + size > RECORDER_BUFFER_SIZE)) {
+        Dropped++;
+        return;
+    }
+    Buffer[Length++] = (kind << RECORD_KIND_SHIFT) | elapsed;
+    if (elapsed == RECORD_TIME_FOLLOWS) {
+        Buffer[Length++] = now;
+        Buffer[Length++] = now >> 8;
+        Buffer[Length++] = now >> 16;
+        Buffer[Length++] = now >> 24;
+    }
+    Buffer[Length++] = id;
+    Buffer[Length++] = value;
+    Buffer[Length++] = value >> 8;
+    LastTime = now;
+}
+
+#elif defined(EVENT_RECORDER_REPLAY)
+
+/*******************************************************************************
+ * REPLAY TOOL                                                                 *
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ProjectHSM.h"
+#include "Bot.h"
+#include "Stepper.h"
+
+#define LINE_LENGTH 256
+#define SENSORS 5
+
+typedef struct {
+    uint32_t time;
+    uint8_t kind;
+    uint8_t id;
+    uint16_t value;
+} Record_t;
+
+static uint8_t *Bytes;
+static uint32_t NumBytes;
+static Record_t *Records;
+static uint32_t NumRecords;
+
+// the record the replay is at, the run it is in, and its time
+static uint32_t Next;
+static uint32_t RunRecord;
+static uint8_t InRun = FALSE;
+static uint32_t Now;
+
+static uint16_t LastSensor[SENSORS];
+static uint32_t Runs, Commands, Matched, Differences;
+
+static const char *EventName(uint8_t type)
+{
+    return (type < sizeof(EventNames) / sizeof(EventNames[0])) ? EventNames[type] : "?";
+}
+
+static void Difference(const char *what, unsigned int id, int value, const Record_t *recorded)
+{
+    Differences++;
+    printf("%lu ms, running %s %u: %s %u %d", (unsigned long) Now,
+            EventName(Records[RunRecord].id), Records[RunRecord].value, what, id, value);
+    if (recorded != NULL) {
+        printf(", recorded %u %d", recorded->id,
+                (recorded->kind == KIND_COMMAND) ? (int16_t) recorded->value : recorded->value);
+    }
+    printf("\n");
+}
+
+/* The replay side of the hooks. Inside a run each read, command or post has to
+ * be the next record of the run, a record of a different kind is left for
+ * what the machine does next. */
+void Recorder_Post(ES_Event ThisEvent)
+{
+    if (InRun == FALSE) {
+        return;
+    }
+    if ((Next < NumRecords) && (Records[Next].kind == KIND_INNER_POST)) {
+        if ((Records[Next].id != ThisEvent.EventType) ||
+                (Records[Next].value != ThisEvent.EventParam)) {
+            Difference("posted", ThisEvent.EventType, ThisEvent.EventParam, &Records[Next]);
+        }
+        Next++;
+    } else {
+        Difference("posted, not recorded", ThisEvent.EventType, ThisEvent.EventParam, NULL);
+    }
+}
+
+void Recorder_Run(ES_Event ThisEvent)
+{
+}
+
+void Recorder_RunDone(void)
+{
+}
+
+uint16_t Recorder_Sensor(uint8_t sensor, uint16_t value)
+{
+    if ((Next < NumRecords) && (Records[Next].kind == KIND_SENSOR) &&
+            (Records[Next].id == sensor)) {
+        value = Records[Next++].value;
+        if (sensor < SENSORS) {
+            LastSensor[sensor] = value;
+        }
+        return value;
+    }
+    Difference("read sensor, not recorded", sensor, 0, NULL);
+    return (sensor < SENSORS) ? LastSensor[sensor] : value;
+}
+
+void Recorder_Command(uint8_t command, int16_t value)
+{
+    Commands++;
+    if ((Next < NumRecords) && (Records[Next].kind == KIND_COMMAND)) {
+        if ((Records[Next].id == command) && ((int16_t) Records[Next].value == value)) {
+            Matched++;
+        } else {
+            Difference("commanded", command, value, &Records[Next]);
+        }
+        Next++;
+    } else {
+        Difference("commanded, not recorded", command, value, NULL);
+    }
+}
+
+void Recorder_Dump(void)
+{
+}
+
+/* No drivers, the machine's reads are answered from the recording and its
+ * commands checked against it. */
+uint8_t ES_PostToService(uint8_t WhichService, ES_Event TheEvent)
+{
+    return TRUE;
+}
+
+int8_t ES_Timer_InitTimer(uint8_t Num, uint32_t NewTime)
+{
+    return SUCCESS;
+}
+
+int8_t ES_Timer_StopTimer(uint8_t Num)
+{
+    return SUCCESS;
+}
+
+uint32_t ES_Timer_GetTime(void)
+{
+    return Now;
+}
+
+unsigned char Bot_ReadBumpers(void)
+{
+    return Recorder_Sensor(RECORDER_BUMPERS, 0);
+}
+
+unsigned int Bot_ReadTrackWireVoltage(void)
+{
+    return Recorder_Sensor(RECORDER_TRACK_WIRE, 0);
+}
+
+BotPose_t Bot_GetPose(void)
+{
+    BotPose_t pose = {0, 0, 0};
+
+    pose.theta = Recorder_Sensor(RECORDER_HEADING, 0);
+    return pose;
+}
+
+void Bot_ResetPose(int32_t x, int32_t y, uint16_t theta)
+{
+}
+
+char Bot_LEDSSet(uint16_t pattern)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_SetRate(uint16_t rate)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_SetLimits(int32_t minPos, int32_t maxPos)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_SetProfile(uint16_t startRate, uint16_t cruiseRate, uint16_t accel)
+{
+    return SUCCESS;
+}
+
+int8_t Stepper_IsStepping(void)
+{
+    return Recorder_Sensor(RECORDER_STEPPING, FALSE);
+}
+
+int8_t Stepper_GetDirection(void)
+{
+    return (int8_t) Recorder_Sensor(RECORDER_STEP_DIRECTION, 0);
+}
+
+int8_t Stepper_MoveTo(int32_t position)
+{
+    Recorder_Command(RECORDER_STEPPER_MOVE, position);
+    return SUCCESS;
+}
+
+#define DRIVE_STUB(name, turn) \
+    char name(char speed) \
+    { \
+        Recorder_Command((turn), speed); \
+        return SUCCESS; \
+    }
+
+DRIVE_STUB(DriveStraight, TURN_STRAIGHT)
+DRIVE_STUB(TankRight, TURN_TANK_RIGHT)
+DRIVE_STUB(TurnGentleRight, TURN_GENTLE_RIGHT)
+DRIVE_STUB(TurnNormalRight, TURN_NORMAL_RIGHT)
+DRIVE_STUB(TurnSharpRight, TURN_SHARP_RIGHT)
+DRIVE_STUB(TankLeft, TURN_TANK_LEFT)
+DRIVE_STUB(TurnGentleLeft, TURN_GENTLE_LEFT)
+DRIVE_STUB(TurnNormalLeft, TURN_NORMAL_LEFT)
+DRIVE_STUB(TurnSharpLeft, TURN_SHARP_LEFT)
+DRIVE_STUB(TurnHardLeft, TURN_HARD_LEFT)
+
+static int HexDigit(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// the "R:" lines of stdin up to "R:END", as bytes
+static void ReadCapture(void)
+{
+    char line[LINE_LENGTH];
+    char *hex;
+    uint32_t size = RECORDER_BUFFER_SIZE;
+
+    Bytes = malloc(size);
+    while ((Bytes != NULL) && (fgets(line, sizeof(line), stdin) != NULL)) {
+        if ((hex = strstr(line, "R:")) == NULL) {
+            continue;
+        }
+        hex += 2;
+        if (strncmp(hex, "END", 3) == 0) {
+            printf("capture: %s", hex + 4);
+            break;
+        }
+        for (; (HexDigit(hex[0]) >= 0) && (HexDigit(hex[1]) >= 0); hex += 2) {
+            if (NumBytes == size) {
+                size *= 2;
+                Bytes = realloc(Bytes, size);
+                if (Bytes == NULL) {
+                    return;
+                }
+            }
+            Bytes[NumBytes++] = (HexDigit(hex[0]) << 4) | HexDigit(hex[1]);
+        }
+    }
+}
+
+// the bytes as records with their whole times, a record cut off ends them
+static void DecodeCapture(void)
+{
+    uint32_t i = 0, time = 0;
+    uint8_t elapsed;
+
+    Records = malloc((NumBytes / RECORD_SIZE + 1) * sizeof(Record_t));
+    if (Records == NULL) {
+        return;
+    }
+    while (i + RECORD_SIZE <= NumBytes) {
+        elapsed = Bytes[i] & RECORD_TIME_FOLLOWS;
+        Records[NumRecords].kind = Bytes[i++] >> RECORD_KIND_SHIFT;
+        if (elapsed == RECORD_TIME_FOLLOWS) {
+            if (i + RECORD_TIME_SIZE + RECORD_SIZE - 1 > NumBytes) {
+                break;
+            }
+            time = Bytes[i] | (Bytes[i + 1] << 8) | (Bytes[i + 2] << 16) |
+                    ((uint32_t) Bytes[i + 3] << 24);
+            i += RECORD_TIME_SIZE;
+        } else {
+            time += elapsed;
+        }
+        Records[NumRecords].time = time;
+        Records[NumRecords].id = Bytes[i];
+        Records[NumRecords].value = Bytes[i + 1] | (Bytes[i + 2] << 8);
+        i += RECORD_SIZE - 1;
+        NumRecords++;
+    }
+}
+
+/**
+ * @Function main(void)
+ * @brief Reads a Recorder_Dump capture on stdin, other lines are skipped, and
+ *        replays it into ProjectHSM: posts are posted and runs run, each at its
+ *        recorded time as far as ES_Timer_GetTime goes. Reads, commands and
+ *        posts a run left in the recording that the replay did not make are
+ *        differences too. Prints them all, then how fast the replay went.
+ */
+int main(void)
+{
+    ES_Event ThisEvent;
+    uint32_t i, unreplayed = 0;
+    clock_t start, ticks;
+    double span, took;
+
+    ReadCapture();
+    DecodeCapture();
+    if ((Records == NULL) || (NumRecords == 0)) {
+        printf("no records on stdin\n");
+        return 1;
+    }
+    Now = Records[0].time;
+    if (InitProjectHSM(0) == FALSE) {
+        printf("InitProjectHSM failed\n");
+        return 1;
+    }
+
+    start = clock();
+    for (i = 0; i < NumRecords; i = Next) {
+        Now = Records[i].time;
+        ThisEvent.EventType = Records[i].id;
+        ThisEvent.EventParam = Records[i].value;
+        Next = i + 1;
+        if (Records[i].kind == KIND_POST) {
+            PostProjectHSM(ThisEvent);
+        } else if (Records[i].kind == KIND_RUN) {
+            RunRecord = i;
+            Runs++;
+            InRun = TRUE;
+            RunProjectHSM(ThisEvent);
+            InRun = FALSE;
+            for (; (Next < NumRecords) && (Records[Next].kind != KIND_POST) &&
+                    (Records[Next].kind != KIND_RUN); Next++) {
+                Difference("recorded, not replayed", Records[Next].kind, 0, &Records[Next]);
+                unreplayed++;
+            }
+        }
+    }
+    ticks = clock() - start;
+
+    span = Records[NumRecords - 1].time - Records[0].time;
+    took = (double) ticks * 1000 / CLOCKS_PER_SEC;
+    printf("%lu records, %lu runs, %lu of %lu commands matched, %lu differences"
+            " (%lu recorded, not replayed)\n", (unsigned long) NumRecords,
+            (unsigned long) Runs, (unsigned long) Matched, (unsigned long) Commands,
+            (unsigned long) Differences, (unsigned long) unreplayed);
+    printf("replayed %.0f ms of recording in %.3f ms", span, took);
+    if (took > 0) {
+        printf(", %.0fx real time", span / took);
+    }
+    printf("\n");
+    return (Differences > 0);
+}
+
+#endif // EVENT_RECORDER
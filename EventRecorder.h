@@ -0,0 +1,134 @@
+/*
+ * File:   EventRecorder.h
+ *
+ * Records what goes in and out of ProjectHSM so a run that went wrong can be
+ * played back on a PC. With EVENT_RECORDER defined below, RAM holds a compact
+ * binary stream of:
+ *   - every event posted to ProjectHSM, timer expiries included, since both
+ *     the ES_Framework timers and the TimerWheel post their timeouts
+ *   - every run of ProjectHSM, with the event the framework woke it with
+ *   - every sensor value the state machines read while running, the bumpers
+ *     and the A/D track wire reading, as they read it
+ *   - every drive and lift command they give, as they give it
+ * each stamped with the ES_Timer_GetTime() milliseconds since the one before.
+ * A record is 4 bytes, 8 when it is more than 30ms after the last one.
+ *
+ * Sensors and commands are only recorded during a run, so the event checkers
+ * reading the same sensors add nothing. Recording stops when the buffer is full,
+ * a replay needs the start. Recorder_Dump prints the buffer over the serial
+ * port as "R:" lines of hex, call it once the run is over.
+ *
+ * Replay: build EventRecorder.c on the PC with EVENT_RECORDER_REPLAY, linked
+ * with the real machine code and no drivers, and feed it the capture:
+ *   gcc -DEVENT_RECORDER_REPLAY -I. EventRecorder.c ProjectHSM.c \
+ *       ProjectInitialSubHSM.c ProjectBeaconFindingSubHSM.c TapeFollowingSubSubHSM.c \
+ *       WallFollowingSubHSM.c StayingInBoundsTowerSubHSM.c GetParallelSubHSM.c \
+ *       FindingCorrectHoleSubHSM.c DispenseBallSubHSM.c HSM_Engine.c EventLanes.c \
+ *       QueueStats.c TimerWheel.c Latency.c HW_Regs.c -o replay && ./replay < capture.txt
+ * It posts and runs the recorded events as fast as it can, answers the sensor
+ * reads with the recorded values, and prints every drive or lift command that
+ * differs from the recording, plus any the recording has and the replay does
+ * not give, with the time and the event being run.
+ */
+
+#ifndef EVENT_RECORDER_H
+#define EVENT_RECORDER_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "ES_Events.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// record ProjectHSM's events, sensor reads and commands
+//#define EVENT_RECORDER
+
+// bytes of RAM for the recording, a little over 1000 records
+#define RECORDER_BUFFER_SIZE 4096
+
+// sensors, the id in a sensor record. The machine also decides on the pose
+// heading and the lift stepper's state, so those reads are sensors too
+#define RECORDER_BUMPERS 0
+#define RECORDER_TRACK_WIRE 1
+#define RECORDER_HEADING 2 // Bot_GetPose's theta, the one part the machine uses
+#define RECORDER_STEPPING 3 // Stepper_IsStepping
+#define RECORDER_STEP_DIRECTION 4 // Stepper_GetDirection, signed
+
+// commands, the id in a command record: the Turn_t of a drive (Bot.h), or a
+// move of the ball lift
+#define RECORDER_STEPPER_MOVE 0x80
+
+#ifdef EVENT_RECORDER_REPLAY
+#define EVENT_RECORDER
+#endif
+
+// the hooks, nothing at all without EVENT_RECORDER, and EventRecorder.c compiles
+// to nothing either so its buffer takes no RAM
+#ifdef EVENT_RECORDER
+#define RECORD_POST(event) Recorder_Post(event)
+#define RECORD_RUN(event) Recorder_Run(event)
+#define RECORD_RUN_DONE() Recorder_RunDone()
+#define RECORD_SENSOR(sensor, value) Recorder_Sensor((sensor), (value))
+#define RECORD_COMMAND(command, value) Recorder_Command((command), (value))
+#else
+#define RECORD_POST(event)
+#define RECORD_RUN(event)
+#define RECORD_RUN_DONE()
+#define RECORD_SENSOR(sensor, value) (value)
+#define RECORD_COMMAND(command, value)
+#endif
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function Recorder_Post(ES_Event ThisEvent)
+ * @param ThisEvent - an event posted to ProjectHSM
+ * @return None.
+ */
+void Recorder_Post(ES_Event ThisEvent);
+
+/**
+ * @Function Recorder_Run(ES_Event ThisEvent)
+ * @param ThisEvent - the event ProjectHSM is being run with
+ * @return None.
+ * @brief Starts a run, sensor reads and commands are recorded until
+ *        Recorder_RunDone.
+ */
+void Recorder_Run(ES_Event ThisEvent);
+
+/**
+ * @Function Recorder_RunDone(void)
+ * @param None.
+ * @return None.
+ */
+void Recorder_RunDone(void);
+
+/**
+ * @Function Recorder_Sensor(uint8_t sensor, uint16_t value)
+ * @param sensor - one of the RECORDER_ sensors
+ * @param value - what the driver read
+ * @return the value to hand the caller: value, or in a replay the recorded one
+ */
+uint16_t Recorder_Sensor(uint8_t sensor, uint16_t value);
+
+/**
+ * @Function Recorder_Command(uint8_t command, int16_t value)
+ * @param command - a Turn_t for a drive, or RECORDER_STEPPER_MOVE
+ * @param value - the speed, or the lift position
+ * @return None.
+ */
+void Recorder_Command(uint8_t command, int16_t value);
+
+/**
+ * @Function Recorder_Dump(void)
+ * @param None.
+ * @return None.
+ * @brief Prints the recording as "R:" lines of hex for the replay, ending with
+ *        "R:END" and the number of records that did not fit.
+ */
+void Recorder_Dump(void);
+
+#endif /* EVENT_RECORDER_H */
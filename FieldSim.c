@@ -0,0 +1,1011 @@
+/*
+ * File:   FieldSim.c
+ *
+ * A headless field to tune the timings and thresholds on without the robot.
+ * The unmodified ProjectHSM and sub machines run on a PC, together with
+ * ProjectService's bumper debounce, the event checkers, the TimerWheel and the
+ * stepper driver, against a 2D model of the field in 1ms steps, as fast as the
+ * PC goes: a two minute match takes tens of milliseconds.
+ *
+ * The model:
+ *   drive       a round body on a differential drive, each wheel a first order
+ *               lag towards the speed it is commanded, less a dead band. The ten
+ *               drive helpers are replaced here with the same curvatures
+ *               (BOT_TURN_CURVATURES) through Bot_Drive's own BotDrive.c. A
+ *               step that would run the body into a wall or tower slides it along
+ *               what it hit instead, or only turns it in a corner.
+ *   bumpers     three arcs across the front, each pressed while a wall or tower
+ *               is within BUMPER_TRAVEL of it. Bot_ReadBumpers packs them the way
+ *               Bot.c does, inverted bits and all.
+ *   tape        FL, FR and BC look down and read TAPE_BLACK over a tape line,
+ *               TAPE_WHITE anywhere else, the tape sensors being digital now.
+ *   ball tape   looks left, out to BALL_TAPE_RANGE: TAPE_WHITE off a tower face,
+ *               TAPE_BLACK off the marker under its hole or with nothing in range.
+ *   track wire  along the base of each tower's hole face, read at the front left
+ *               of the robot, falling off with the distance to the wire.
+ *   beacon      on top of a tower, seen by a forward detector within
+ *               BEACON_HALF_ANGLE of straight ahead, fading with the angle and
+ *               the distance. Towers do not hide each other's beacons.
+ *   lift        the real Stepper.c, with Timer3 counted out from PR3 and its
+ *               prescale and Timer3IntHandler called at each rollover. A ball
+ *               drops when the lift reaches BALL_RELEASE_STEPS and scores if the
+ *               front of the robot is square against a tower's hole face, within
+ *               HOLE_TOLERANCE of the hole.
+ * Sensor reads get NOISE of uniform noise on top.
+ *
+ * The framework is the part of ES_Framework the machines use: the services
+ * with the queue sizes in ES_Configure.h, run highest priority first, the 16
+ * timers posting to their TIMERn_RESP_FUNC, and EVENT_CHECK_LIST checked each
+ * time the queues are empty, until a pass finds nothing. The keyboard service
+ * is left out.
+ *
+ * The field, where the sensors sit and the model constants are below. The
+ * timings and thresholds being tuned are #defines in the machines and the event
+ * checker, so change them there, rebuild and run again, and try the start over
+ * a few seeds with a shell loop.
+ *
+ * Build and run on a PC, with the ES_Framework and library headers on the path:
+ *   gcc -O2 -DFIELD_SIM -I. FieldSim.c ProjectHSM.c ProjectInitialSubHSM.c \
+ *       ProjectBeaconFindingSubHSM.c TapeFollowingSubSubHSM.c WallFollowingSubHSM.c \
+ *       StayingInBoundsTowerSubHSM.c GetParallelSubHSM.c FindingCorrectHoleSubHSM.c \
+ *       DispenseBallSubHSM.c HSM_Engine.c EventLanes.c QueueStats.c TimerWheel.c \
+ *       Latency.c StateStats.c EventRecorder.c ProjectEventChecker.c ProjectService.c \
+ *       Idle.c Stepper.c BotDrive.c HW_Regs.c -lm -o fieldsim
+ *   ./fieldsim [-r seed] [-t seconds] [-s] [-c trace.csv]
+ *     -r  seed for the start pose and the noise, 0 (the default) starts at
+ *         START_X, START_Y, START_HEADING, any other anywhere in the start box
+ *     -t  match length, MATCH_SECONDS by default
+ *     -s  let the machines' serial output through, it is thrown away otherwise
+ *     -c  write the pose, wheels, sensors and lift every TRACE_PERIOD ms as CSV
+ * It prints each ball delivered, how much of the match was spent out of bounds
+ * or pushing against a wall or tower, how far Bot_GetPose had drifted from the
+ * model since its last reset, the deepest the service queues and ProjectHSM's
+ * lanes got and what they refused, and how many times faster than real time
+ * the match ran. Built with STATE_STATS as well it adds the time in each state,
+ * and with EVENT_RECORDER a capture for the replay tool (EventRecorder.h).
+ */
+
+#ifdef FIELD_SIM
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "Bot.h"
+#include "BotDrive.h"
+#include "EventRecorder.h"
+#include "HW_Regs.h"
+#include "ProjectHSM.h"
+#include "ProjectService.h"
+#include "StateStats.h"
+#include "Stepper.h"
+#include EVENT_CHECK_HEADER
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+
+#define MATCH_SECONDS 120
+#define TRACE_PERIOD 10 // ms
+
+// the field, mm from its bottom left corner, walls all round
+#define FIELD_SIZE 2440
+#define TAPE_WIDTH 50
+#define TAPE_INSET 200 // wall to the middle of the boundary tape
+#define TOWER_SIDE 400
+
+// the start box, headings are radians counterclockwise from +x
+#define START_X 450
+#define START_Y 450
+#define START_HEADING (M_PI / 4)
+#define START_JITTER 60 // mm either way, seeded starts only
+
+// the robot is round, its sensors are mm from the middle of the axle, x forward
+// and y left
+#define BOT_RADIUS 140
+#define WHEEL_BASE 210
+// a 90 degree tank turn at full speed takes 550ms (ROTATE_90_DEGREES_TICKS)
+#define FULL_SPEED 300.0 // mm/s
+// TankRight(50) for ROTATE_TO_SIDE_TICKS turns 90 degrees
+#define DEAD_BAND 0.15
+#define WHEEL_LAG 40.0 // ms
+#define BUMPER_TRAVEL 8
+#define BUMPER_SPLIT (20 * M_PI / 180) // the middle bumper either side of ahead
+#define BUMPER_EDGE (90 * M_PI / 180) // where the outer bumpers end
+#define FL_TAPE_X 100
+#define FL_TAPE_Y 60
+#define BC_TAPE_X -110
+#define BALL_TAPE_X -20 // on the left side
+#define BALL_TAPE_RANGE 50
+#define WIRE_X 120 // the track wire inductor, towards the left
+#define WIRE_Y 70
+#define BALL_RELEASE_STEPS 50
+#define HOLE_TOLERANCE 25 // mm along the face
+#define HOLE_SQUARE 0.35 // radians off square to the face
+#define FACE_CONTACT 15 // mm
+
+// sensor readings, 10 bit A/D
+#define AD_MAX 1023
+#define NOISE 20
+#define TAPE_WHITE 120
+#define TAPE_BLACK 880
+#define MARKER_HALF_WIDTH 25
+#define WIRE_FLOOR 50
+#define WIRE_PEAK 950
+#define WIRE_FALLOFF 100.0 // mm, half the peak
+#define BEACON_PEAK 1000
+#define BEACON_HALF_ANGLE (15 * M_PI / 180)
+#define BEACON_RANGE 5000.0 // mm, half the peak
+
+// Timer3 runs off the 40MHz peripheral bus
+#define PB_TICKS_PER_MS 40000
+
+#define TIMERS 16
+#define SERVICES 3
+#define QUEUE_ROOM 16
+#define MAX_BALLS 32
+
+#define FACES 4
+#define NUM_TOWERS (sizeof(Towers) / sizeof(Towers[0]))
+#define NUM_TAPES (sizeof(Tapes) / sizeof(Tapes[0]))
+#define NUM_CHECKERS (sizeof(Checkers) / sizeof(Checkers[0]))
+
+/*******************************************************************************
+ * PRIVATE TYPEDEFS                                                            *
+ ******************************************************************************/
+
+typedef enum {
+    FACE_EAST, FACE_NORTH, FACE_WEST, FACE_SOUTH
+} Face_t;
+
+typedef struct {
+    double x, y; // middle, mm
+    double half; // half a side
+    uint8_t beacon; // TRUE with a beacon on top
+    Face_t holeFace; // the face with the track wire and the hole
+    double hole; // hole and marker, mm along the face counterclockwise of its middle
+} Tower_t;
+
+typedef struct {
+    double x1, y1, x2, y2; // the middle of the line, mm
+} Tape_t;
+
+typedef struct {
+    uint8_t(*init)(uint8_t Priority);
+    ES_Event(*run)(ES_Event ThisEvent);
+    uint8_t size;
+} Service_t;
+
+typedef struct {
+    uint32_t time;
+    int8_t tower; // -1 for nowhere near one
+    uint8_t scored;
+    double miss; // mm from the hole along the face
+} Ball_t;
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+void Timer3IntHandler(void);
+
+static char Drive(Turn_t turn, char speed);
+static double WheelSpeed(int16_t command);
+static void MoveBot(void);
+static double Clearance(double x, double y, double *normalX, double *normalY);
+static void ReadBumpers(void);
+static void Touch(double x, double y);
+static void ToField(double forward, double left, double *x, double *y);
+static uint16_t TapeLevel(double forward, double left);
+static uint16_t BallTapeLevel(void);
+static uint16_t WireLevel(void);
+static uint16_t BeaconLevel(void);
+static uint16_t Noisy(uint16_t level);
+static double Random(void);
+static void RunTimer3(void);
+static void DropBall(void);
+static void ExpireTimers(void);
+static void RunServices(void);
+static uint8_t CheckUserEvents(void);
+static void Trace(FILE *trace);
+static void Report(uint32_t ms, double seconds);
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+static const Tower_t Towers[] = {
+    // close enough to the top tape that going round it crosses the tape
+    {1220, 1900, TOWER_SIDE / 2, TRUE, FACE_SOUTH, 0},
+    {650, 1150, TOWER_SIDE / 2, TRUE, FACE_EAST, 0},
+    {1750, 850, TOWER_SIDE / 2, TRUE, FACE_NORTH, 0},
+};
+
+static const Tape_t Tapes[] = {
+    {TAPE_INSET, TAPE_INSET, FIELD_SIZE - TAPE_INSET, TAPE_INSET},
+    {FIELD_SIZE - TAPE_INSET, TAPE_INSET, FIELD_SIZE - TAPE_INSET, FIELD_SIZE - TAPE_INSET},
+    {FIELD_SIZE - TAPE_INSET, FIELD_SIZE - TAPE_INSET, TAPE_INSET, FIELD_SIZE - TAPE_INSET},
+    {TAPE_INSET, FIELD_SIZE - TAPE_INSET, TAPE_INSET, TAPE_INSET},
+};
+
+// outward normal of each Face_t, counterclockwise along it is (-ny, nx)
+static const double Normals[FACES][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+static const Service_t Services[SERVICES] = {
+    {NULL, NULL, 0}, // SERV_0, no keyboard on the field
+    {SERV_1_INIT, SERV_1_RUN, SERV_1_QUEUE_SIZE},
+    {SERV_2_INIT, SERV_2_RUN, SERV_2_QUEUE_SIZE},
+};
+
+static pPostFunc const TimerPost[TIMERS] = {
+    TIMER0_RESP_FUNC, TIMER1_RESP_FUNC, TIMER2_RESP_FUNC, TIMER3_RESP_FUNC,
+    TIMER4_RESP_FUNC, TIMER5_RESP_FUNC, TIMER6_RESP_FUNC, TIMER7_RESP_FUNC,
+    TIMER8_RESP_FUNC, TIMER9_RESP_FUNC, TIMER10_RESP_FUNC, TIMER11_RESP_FUNC,
+    TIMER12_RESP_FUNC, TIMER13_RESP_FUNC, TIMER14_RESP_FUNC, TIMER15_RESP_FUNC
+};
+
+static uint8_t(* const Checkers[])(void) = {EVENT_CHECK_LIST};
+
+static uint32_t Now;
+static uint32_t Seed;
+
+static ES_Event Queues[SERVICES][QUEUE_ROOM];
+static uint8_t QueueHead[SERVICES], QueueCount[SERVICES];
+static uint32_t TimerDeadline[TIMERS];
+static uint8_t TimerRunning[TIMERS];
+
+static double X, Y, Heading;
+static double Cos, Sin; // of Heading
+static int16_t LeftCommand, RightCommand; // percent, forward positive
+static BotDrive_Odometry_t Odometry; // Bot_GetPose's, through BotDrive.c
+static double ResetX, ResetY, ResetHeading; // where the robot was at the last pose reset
+static double LeftSpeed, RightSpeed; // mm/s
+static uint8_t Bumped[3]; // pressed, left, center and right
+static uint32_t Timer3Carry;
+static int32_t LastLift;
+
+static Ball_t Balls[MAX_BALLS];
+static uint8_t NumBalls;
+static uint32_t OutOfBoundsMs, PushingMs, Bumps;
+
+/*******************************************************************************
+ * THE ROBOT                                                                   *
+ ******************************************************************************/
+
+void Bot_Init(void)
+{
+    Stepper_Init();
+    Bot_ResetPose(0, 0, 0);
+}
+
+char DriveStraight(char speed)
+{
+    return Drive(TURN_STRAIGHT, speed);
+}
+
+char TankRight(char speed)
+{
+    return Drive(TURN_TANK_RIGHT, speed);
+}
+
+char TurnGentleRight(char speed)
+{
+    return Drive(TURN_GENTLE_RIGHT, speed);
+}
+
+char TurnNormalRight(char speed)
+{
+    return Drive(TURN_NORMAL_RIGHT, speed);
+}
+
+char TurnSharpRight(char speed)
+{
+    return Drive(TURN_SHARP_RIGHT, speed);
+}
+
+char TankLeft(char speed)
+{
+    return Drive(TURN_TANK_LEFT, speed);
+}
+
+char TurnGentleLeft(char speed)
+{
+    return Drive(TURN_GENTLE_LEFT, speed);
+}
+
+char TurnNormalLeft(char speed)
+{
+    return Drive(TURN_NORMAL_LEFT, speed);
+}
+
+char TurnSharpLeft(char speed)
+{
+    return Drive(TURN_SHARP_LEFT, speed);
+}
+
+char TurnHardLeft(char speed)
+{
+    return Drive(TURN_HARD_LEFT, speed);
+}
+
+char Bot_LEDSSet(uint16_t pattern)
+{
+    return SUCCESS;
+}
+
+unsigned char Bot_ReadFrontLeftBumper(void)
+{
+    return Bumped[0] ? BUMPER_TRIPPED : BUMPER_NOT_TRIPPED;
+}
+
+unsigned char Bot_ReadFrontCenterBumper(void)
+{
+    return Bumped[1] ? BUMPER_TRIPPED : BUMPER_NOT_TRIPPED;
+}
+
+unsigned char Bot_ReadFrontRightBumper(void)
+{
+    return Bumped[2] ? BUMPER_TRIPPED : BUMPER_NOT_TRIPPED;
+}
+
+unsigned char Bot_ReadBumpers(void)
+{
+    return RECORD_SENSOR(RECORDER_BUMPERS, !Bot_ReadFrontLeftBumper() +
+            ((!Bot_ReadFrontCenterBumper()) << 1) + ((!Bot_ReadFrontRightBumper()) << 2));
+}
+
+unsigned int Bot_ReadFLTapeVoltage(void)
+{
+    return Noisy(TapeLevel(FL_TAPE_X, FL_TAPE_Y));
+}
+
+unsigned int Bot_ReadFRTapeVoltage(void)
+{
+    return Noisy(TapeLevel(FL_TAPE_X, -FL_TAPE_Y));
+}
+
+unsigned int Bot_ReadBCTapeVoltage(void)
+{
+    return Noisy(TapeLevel(BC_TAPE_X, 0));
+}
+
+unsigned int Bot_ReadLeftBallTapeVoltage(void)
+{
+    return Noisy(BallTapeLevel());
+}
+
+unsigned int Bot_ReadTrackWireVoltage(void)
+{
+    return RECORD_SENSOR(RECORDER_TRACK_WIRE, Noisy(WireLevel()));
+}
+
+unsigned int Bot_ReadBeaconVoltage(void)
+{
+    return Noisy(BeaconLevel());
+}
+
+BotPose_t Bot_GetPose(void)
+{
+    BotPose_t pose;
+
+    BotDrive_UpdatePose(&Odometry, LeftCommand, RightCommand, Now);
+    pose = BotDrive_GetPose(&Odometry);
+    pose.theta = RECORD_SENSOR(RECORDER_HEADING, pose.theta);
+    return pose;
+}
+
+void Bot_ResetPose(int32_t x, int32_t y, uint16_t theta)
+{
+    BotDrive_ResetPose(&Odometry, x, y, theta, Now);
+    // the report measures the drift from here, in the frame the reset gives
+    ResetHeading = Heading - theta * 2 * M_PI / BOT_ANGLE_FULL_TURN;
+    ResetX = X - (x * cos(ResetHeading) - y * sin(ResetHeading));
+    ResetY = Y - (x * sin(ResetHeading) + y * cos(ResetHeading));
+}
+
+void Bot_ResetPoseHeading(uint16_t theta)
+{
+    BotPose_t pose = Bot_GetPose();
+
+    Odometry.theta = (uint32_t) theta << 16;
+    ResetHeading = Heading - theta * 2 * M_PI / BOT_ANGLE_FULL_TURN;
+    ResetX = X - (pose.x * cos(ResetHeading) - pose.y * sin(ResetHeading));
+    ResetY = Y - (pose.x * sin(ResetHeading) + pose.y * cos(ResetHeading));
+}
+
+// Bot_Drive's wheel speeds
+static char Drive(Turn_t turn, char speed)
+{
+    static const int16_t curvatures[NUM_TURNS] = {BOT_TURN_CURVATURES};
+
+    RECORD_COMMAND(turn, speed);
+    BotDrive_UpdatePose(&Odometry, LeftCommand, RightCommand, Now);
+    BotDrive_Wheels(speed, curvatures[turn], &LeftCommand, &RightCommand);
+    return SUCCESS;
+}
+
+static double WheelSpeed(int16_t command)
+{
+    double duty = abs(command) / (double) BOT_MAX_SPEED;
+    double speed;
+
+    if (duty <= DEAD_BAND) {
+        return 0;
+    }
+    speed = FULL_SPEED * (duty - DEAD_BAND) / (1 - DEAD_BAND);
+    return (command < 0) ? -speed : speed;
+}
+
+/*******************************************************************************
+ * THE FIELD                                                                   *
+ ******************************************************************************/
+
+// one millisecond of driving, then what the bumpers touch
+static void MoveBot(void)
+{
+    double forward, turn, c, s, dx, dy, into, normalX, normalY;
+
+    LeftSpeed += (WheelSpeed(LeftCommand) - LeftSpeed) / WHEEL_LAG;
+    RightSpeed += (WheelSpeed(RightCommand) - RightSpeed) / WHEEL_LAG;
+    forward = (LeftSpeed + RightSpeed) / 2000;
+    turn = (RightSpeed - LeftSpeed) / (WHEEL_BASE * 1000.0);
+    if ((fabs(forward) < 1e-6) && (fabs(turn) < 1e-9)) {
+        return;
+    }
+    Heading += turn;
+    c = cos(Heading);
+    s = sin(Heading);
+    // along the heading halfway through the step
+    dx = forward * (Cos + c) / 2;
+    dy = forward * (Sin + s) / 2;
+    Cos = c;
+    Sin = s;
+    if (Clearance(X + dx, Y + dy, &normalX, &normalY) < 0) {
+        // slides along what it hit, or stops in a corner
+        PushingMs++;
+        into = dx * normalX + dy * normalY;
+        if (into < 0) {
+            dx -= into * normalX;
+            dy -= into * normalY;
+        }
+        if (Clearance(X + dx, Y + dy, &normalX, &normalY) < 0) {
+            dx = dy = 0;
+        }
+    }
+    X += dx;
+    Y += dy;
+    ReadBumpers();
+}
+
+// how far the body at x, y is from the nearest wall or tower, negative into it,
+// and the direction from that to the body
+static double Clearance(double x, double y, double *normalX, double *normalY)
+{
+    double dx, dy, distance, nearest = x;
+    uint8_t i;
+
+    *normalX = 1;
+    *normalY = 0;
+    if (FIELD_SIZE - x < nearest) {
+        nearest = FIELD_SIZE - x;
+        *normalX = -1;
+    }
+    if (y < nearest) {
+        nearest = y;
+        *normalX = 0;
+        *normalY = 1;
+    }
+    if (FIELD_SIZE - y < nearest) {
+        nearest = FIELD_SIZE - y;
+        *normalX = 0;
+        *normalY = -1;
+    }
+    for (i = 0; i < NUM_TOWERS; i++) {
+        dx = x - fmin(fmax(x, Towers[i].x - Towers[i].half), Towers[i].x + Towers[i].half);
+        dy = y - fmin(fmax(y, Towers[i].y - Towers[i].half), Towers[i].y + Towers[i].half);
+        distance = sqrt(dx * dx + dy * dy);
+        if ((distance < nearest) && (distance > 0)) {
+            nearest = distance;
+            *normalX = dx / distance;
+            *normalY = dy / distance;
+        }
+    }
+    return nearest - BOT_RADIUS;
+}
+
+// the bumpers the nearest point of each wall and tower presses
+static void ReadBumpers(void)
+{
+    uint8_t wasBumped = Bumped[0] || Bumped[1] || Bumped[2];
+    double half;
+    uint8_t i;
+
+    Bumped[0] = Bumped[1] = Bumped[2] = FALSE;
+    Touch(0, Y);
+    Touch(FIELD_SIZE, Y);
+    Touch(X, 0);
+    Touch(X, FIELD_SIZE);
+    for (i = 0; i < NUM_TOWERS; i++) {
+        half = Towers[i].half;
+        Touch(fmin(fmax(X, Towers[i].x - half), Towers[i].x + half),
+                fmin(fmax(Y, Towers[i].y - half), Towers[i].y + half));
+    }
+    if (!wasBumped && (Bumped[0] || Bumped[1] || Bumped[2])) {
+        Bumps++;
+    }
+}
+
+static void Touch(double x, double y)
+{
+    double dx = x - X, dy = y - Y, angle;
+
+    if (dx * dx + dy * dy >= (BOT_RADIUS + BUMPER_TRAVEL) * (BOT_RADIUS + BUMPER_TRAVEL)) {
+        return;
+    }
+    // left of ahead is positive
+    angle = atan2(dy * Cos - dx * Sin, dx * Cos + dy * Sin);
+    if (fabs(angle) <= BUMPER_SPLIT) {
+        Bumped[1] = TRUE;
+    } else if ((angle > 0) && (angle <= BUMPER_EDGE)) {
+        Bumped[0] = TRUE;
+    } else if ((angle < 0) && (angle >= -BUMPER_EDGE)) {
+        Bumped[2] = TRUE;
+    }
+}
+
+static void ToField(double forward, double left, double *x, double *y)
+{
+    *x = X + forward * Cos - left * Sin;
+    *y = Y + forward * Sin + left * Cos;
+}
+
+static uint16_t TapeLevel(double forward, double left)
+{
+    double x, y, dx, dy, lx, ly, t;
+    uint8_t i;
+
+    ToField(forward, left, &x, &y);
+    for (i = 0; i < NUM_TAPES; i++) {
+        lx = Tapes[i].x2 - Tapes[i].x1;
+        ly = Tapes[i].y2 - Tapes[i].y1;
+        t = ((x - Tapes[i].x1) * lx + (y - Tapes[i].y1) * ly) / (lx * lx + ly * ly);
+        t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+        dx = x - (Tapes[i].x1 + t * lx);
+        dy = y - (Tapes[i].y1 + t * ly);
+        if (dx * dx + dy * dy <= (TAPE_WIDTH / 2.0) * (TAPE_WIDTH / 2.0)) {
+            return TAPE_BLACK;
+        }
+    }
+    return TAPE_WHITE;
+}
+
+// the nearest tower face to the left, white except for the marker
+static uint16_t BallTapeLevel(void)
+{
+    double x, y, rayX = -Sin, rayY = Cos;
+    double nearest = BALL_TAPE_RANGE, enterX, enterY, enter, along;
+    uint16_t level = TAPE_BLACK;
+    const Tower_t *tower;
+    Face_t face;
+    uint8_t i;
+
+    ToField(BALL_TAPE_X, BOT_RADIUS, &x, &y);
+    for (i = 0; i < NUM_TOWERS; i++) {
+        tower = &Towers[i];
+        // where the ray crosses into each slab, the later one is the face it hits
+        enterX = (rayX == 0) ? -INFINITY : ((tower->x - x - copysign(tower->half, rayX)) / rayX);
+        enterY = (rayY == 0) ? -INFINITY : ((tower->y - y - copysign(tower->half, rayY)) / rayY);
+        if (enterX > enterY) {
+            enter = enterX;
+            face = (rayX > 0) ? FACE_WEST : FACE_EAST;
+        } else {
+            enter = enterY;
+            face = (rayY > 0) ? FACE_SOUTH : FACE_NORTH;
+        }
+        if ((enter < 0) || (enter >= nearest) ||
+                (fabs(x + enter * rayX - tower->x) > tower->half + 0.001) ||
+                (fabs(y + enter * rayY - tower->y) > tower->half + 0.001)) {
+            continue;
+        }
+        nearest = enter;
+        level = TAPE_WHITE;
+        if (face == tower->holeFace) {
+            along = (x + enter * rayX - tower->x) * -Normals[face][1] +
+                    (y + enter * rayY - tower->y) * Normals[face][0];
+            if (fabs(along - tower->hole) <= MARKER_HALF_WIDTH) {
+                level = TAPE_BLACK;
+            }
+        }
+    }
+    return level;
+}
+
+static uint16_t WireLevel(void)
+{
+    double x, y, along, out, distance, nearest = INFINITY;
+    const Tower_t *tower;
+    uint8_t i;
+
+    ToField(WIRE_X, WIRE_Y, &x, &y);
+    for (i = 0; i < NUM_TOWERS; i++) {
+        tower = &Towers[i];
+        out = (x - tower->x) * Normals[tower->holeFace][0] +
+                (y - tower->y) * Normals[tower->holeFace][1] - tower->half;
+        along = fabs((x - tower->x) * -Normals[tower->holeFace][1] +
+                (y - tower->y) * Normals[tower->holeFace][0]) - tower->half;
+        distance = hypot(out, (along > 0) ? along : 0);
+        if (distance < nearest) {
+            nearest = distance;
+        }
+    }
+    return WIRE_FLOOR + WIRE_PEAK * WIRE_FALLOFF / (WIRE_FALLOFF + nearest);
+}
+
+static uint16_t BeaconLevel(void)
+{
+    double dx, dy, distance, ahead, off, level, brightest = 0;
+    uint8_t i;
+
+    for (i = 0; i < NUM_TOWERS; i++) {
+        if (Towers[i].beacon == FALSE) {
+            continue;
+        }
+        dx = Towers[i].x - X;
+        dy = Towers[i].y - Y;
+        distance = sqrt(dx * dx + dy * dy);
+        ahead = dx * Cos + dy * Sin;
+        // the angle only for a beacon inside the cone
+        if (ahead <= distance * cos(BEACON_HALF_ANGLE)) {
+            continue;
+        }
+        off = acos(ahead / distance) / BEACON_HALF_ANGLE;
+        level = BEACON_PEAK * (1 - off * off) /
+                (1 + distance * distance / (BEACON_RANGE * BEACON_RANGE));
+        if (level > brightest) {
+            brightest = level;
+        }
+    }
+    return brightest;
+}
+
+static uint16_t Noisy(uint16_t level)
+{
+    int16_t reading = level + (int16_t) (Random() * (2 * NOISE + 1)) - NOISE;
+
+    return (reading < 0) ? 0 : ((reading > AD_MAX) ? AD_MAX : reading);
+}
+
+// [0, 1)
+static double Random(void)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 8) / (double) (1UL << 24);
+}
+
+// a millisecond of Timer3, with the step interrupt at each period
+static void RunTimer3(void)
+{
+    static const uint16_t prescales[8] = {1, 2, 4, 8, 16, 32, 64, 256};
+    uint32_t ticks = PB_TICKS_PER_MS + Timer3Carry;
+    uint32_t prescale, count, period;
+
+    while (HW_FIELD_READ(T3CON, ON)) {
+        prescale = prescales[HW_FIELD_READ(T3CON, TCKPS)];
+        count = HW_SFR_READ(TMR3);
+        period = HW_SFR_READ(PR3) + 1;
+        if (count > period) {
+            count = period;
+        }
+        if ((period - count) * prescale > ticks) {
+            HW_SFR_WRITE(TMR3, count + ticks / prescale);
+            Timer3Carry = ticks % prescale;
+            return;
+        }
+        ticks -= (period - count) * prescale;
+        HW_SFR_WRITE(TMR3, 0);
+        HW_SFR_WRITE(IFS0SET, _IFS0_T3IF_MASK);
+        if (HW_FIELD_READ(IEC0, T3IE)) {
+            Timer3IntHandler();
+        }
+    }
+    Timer3Carry = 0;
+}
+
+static void DropBall(void)
+{
+    Ball_t *ball = &Balls[NumBalls];
+    const Tower_t *tower;
+    double x, y, out, along;
+    uint8_t i, face;
+
+    if (NumBalls == MAX_BALLS) {
+        return;
+    }
+    NumBalls++;
+    ball->time = Now;
+    ball->tower = -1;
+    ball->scored = FALSE;
+    ToField(BOT_RADIUS, 0, &x, &y);
+    for (i = 0; i < NUM_TOWERS; i++) {
+        tower = &Towers[i];
+        for (face = 0; face < FACES; face++) {
+            out = (x - tower->x) * Normals[face][0] + (y - tower->y) * Normals[face][1] -
+                    tower->half;
+            along = (x - tower->x) * -Normals[face][1] + (y - tower->y) * Normals[face][0];
+            if ((out < -1) || (out > FACE_CONTACT) || (fabs(along) > tower->half)) {
+                continue;
+            }
+            ball->tower = i;
+            ball->miss = along - tower->hole;
+            // square on, facing into the face
+            ball->scored = (face == tower->holeFace) && (fabs(ball->miss) <= HOLE_TOLERANCE) &&
+                    (fabs(remainder(Heading - atan2(-Normals[face][1], -Normals[face][0]),
+                    2 * M_PI)) <= HOLE_SQUARE);
+            if (face != tower->holeFace) {
+                ball->miss = INFINITY;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * THE FRAMEWORK                                                               *
+ ******************************************************************************/
+
+uint8_t ES_PostToService(uint8_t WhichService, ES_Event TheEvent)
+{
+    if ((WhichService >= SERVICES) || (Services[WhichService].run == NULL) ||
+            (QueueCount[WhichService] >= Services[WhichService].size)) {
+        return FALSE;
+    }
+    Queues[WhichService][(QueueHead[WhichService] + QueueCount[WhichService]) % QUEUE_ROOM] =
+            TheEvent;
+    QueueCount[WhichService]++;
+    return TRUE;
+}
+
+uint8_t ES_PostAll(ES_Event TheEvent)
+{
+    uint8_t service, posted = TRUE;
+
+    for (service = 0; service < SERVICES; service++) {
+        if ((Services[service].run != NULL) && (ES_PostToService(service, TheEvent) == FALSE)) {
+            posted = FALSE;
+        }
+    }
+    return posted;
+}
+
+int8_t ES_Timer_InitTimer(uint8_t Num, uint32_t NewTime)
+{
+    if ((Num >= TIMERS) || (TimerPost[Num] == NULL) || (NewTime == 0)) {
+        return ERROR;
+    }
+    TimerDeadline[Num] = Now + NewTime;
+    TimerRunning[Num] = TRUE;
+    return SUCCESS;
+}
+
+int8_t ES_Timer_StopTimer(uint8_t Num)
+{
+    if (Num >= TIMERS) {
+        return ERROR;
+    }
+    TimerRunning[Num] = FALSE;
+    return SUCCESS;
+}
+
+uint32_t ES_Timer_GetTime(void)
+{
+    return Now;
+}
+
+static void ExpireTimers(void)
+{
+    ES_Event timeout = {ES_TIMEOUT, 0};
+    uint8_t i;
+
+    for (i = 0; i < TIMERS; i++) {
+        if (TimerRunning[i] && (TimerDeadline[i] <= Now)) {
+            TimerRunning[i] = FALSE;
+            timeout.EventParam = i;
+            TimerPost[i](timeout);
+        }
+    }
+}
+
+// one event at a time to the highest priority service with any waiting
+static void RunServices(void)
+{
+    ES_Event event;
+    int8_t service = SERVICES - 1;
+
+    while (service >= 0) {
+        if (QueueCount[service] == 0) {
+            service--;
+            continue;
+        }
+        event = Queues[service][QueueHead[service]];
+        QueueHead[service] = (QueueHead[service] + 1) % QUEUE_ROOM;
+        QueueCount[service]--;
+        Services[service].run(event);
+        service = SERVICES - 1;
+    }
+}
+
+// like ES_CheckUserEvents, stops at the first checker that found something
+static uint8_t CheckUserEvents(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUM_CHECKERS; i++) {
+        if (Checkers[i]() == TRUE) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*******************************************************************************
+ * THE MATCH                                                                   *
+ ******************************************************************************/
+
+static void Trace(FILE *trace)
+{
+    fprintf(trace, "%lu,%.1f,%.1f,%.1f,%.0f,%.0f,%u,%u,%u,%u,%u,%u,%u,%ld\n",
+            (unsigned long) Now, X, Y, remainder(Heading, 2 * M_PI) * 180 / M_PI,
+            LeftSpeed, RightSpeed, Bumped[0] | (Bumped[1] << 1) | (Bumped[2] << 2),
+            TapeLevel(FL_TAPE_X, FL_TAPE_Y), TapeLevel(FL_TAPE_X, -FL_TAPE_Y),
+            TapeLevel(BC_TAPE_X, 0), BallTapeLevel(), WireLevel(), BeaconLevel(),
+            (long) LastLift);
+}
+
+static void Report(uint32_t ms, double seconds)
+{
+    const Ball_t *ball;
+    uint8_t i, scored = 0;
+    BotPose_t pose = Bot_GetPose();
+    const QueueStats_t *bumper = GetBumperServiceQueueStats();
+    const QueueStats_t *project = GetProjectHSMQueueStats();
+    const EventLanes_t *lanes = GetProjectHSMLanes();
+    double dx = X - ResetX, dy = Y - ResetY;
+    double poseX = pose.x * cos(ResetHeading) - pose.y * sin(ResetHeading);
+    double poseY = pose.x * sin(ResetHeading) + pose.y * cos(ResetHeading);
+
+    for (i = 0; i < NumBalls; i++) {
+        ball = &Balls[i];
+        scored += ball->scored;
+        printf("ball at %lu ms: ", (unsigned long) ball->time);
+        if (ball->tower < 0) {
+            printf("nowhere near a tower\n");
+        } else if (ball->scored) {
+            printf("tower %d, scored %.0f mm off the hole\n", ball->tower, ball->miss);
+        } else if (isinf(ball->miss)) {
+            printf("tower %d, on a face with no hole\n", ball->tower);
+        } else {
+            printf("tower %d, missed, %.0f mm off the hole\n", ball->tower, ball->miss);
+        }
+    }
+    printf("%u balls, %u scored, %lu ms out of bounds, %lu ms pushing, %lu bumps\n",
+            NumBalls, scored, (unsigned long) OutOfBoundsMs, (unsigned long) PushingMs,
+            (unsigned long) Bumps);
+    printf("pose off by %.0f mm and %.1f degrees since its last reset\n", hypot(poseX - dx, poseY - dy),
+            fabs(remainder((Heading - ResetHeading) * 180 / M_PI - (int16_t) pose.theta * 360.0 /
+            BOT_ANGLE_FULL_TURN, 360)));
+    printf("queues held at most: bumper %u of %u, ProjectHSM %u of %u and its lanes %u of %u, "
+            "%u refused\n", bumper->highWater, SERV_1_QUEUE_SIZE, project->highWater,
+            SERV_2_QUEUE_SIZE, lanes->highWater, EVENT_LANE_SIZE,
+            bumper->overflows + project->overflows + lanes->overflows);
+    printf("%lu ms of match in %.1f ms, %.0fx real time\n", (unsigned long) ms,
+            seconds * 1000, (seconds > 0) ? ms / (seconds * 1000) : 0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t matchMs = MATCH_SECONDS * 1000, seed = 0;
+    uint8_t serial = FALSE, service;
+    FILE *trace = NULL;
+    int option, console = -1, null;
+    clock_t start;
+
+    while ((option = getopt(argc, argv, "r:t:sc:")) != -1) {
+        switch (option) {
+        case 'r':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            matchMs = strtod(optarg, NULL) * 1000;
+            break;
+        case 's':
+            serial = TRUE;
+            break;
+        case 'c':
+            trace = fopen(optarg, "w");
+            if (trace == NULL) {
+                perror(optarg);
+                return 1;
+            }
+            fprintf(trace, "ms,x,y,heading,left,right,bumpers,fl,fr,bc,ball,wire,beacon,lift\n");
+            break;
+        default:
+            printf("usage: %s [-r seed] [-t seconds] [-s] [-c trace.csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    X = START_X;
+    Y = START_Y;
+    Heading = START_HEADING;
+    // mixed, so seeds next to each other start far apart
+    Seed = (seed ^ (seed >> 16)) * 0x45D9F3B;
+    Seed ^= Seed >> 16;
+    if (seed != 0) {
+        X += (2 * Random() - 1) * START_JITTER;
+        Y += (2 * Random() - 1) * START_JITTER;
+        Heading = 2 * M_PI * Random();
+    }
+    Cos = cos(Heading);
+    Sin = sin(Heading);
+    printf("seed %lu, start %.0f, %.0f heading %.0f degrees\n", (unsigned long) seed, X, Y,
+            Heading * 180 / M_PI);
+    fflush(stdout);
+    if (serial == FALSE) {
+        console = dup(STDOUT_FILENO);
+        null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+
+    start = clock();
+    HW_RegsReset();
+    Bot_Init();
+    for (service = 0; service < SERVICES; service++) {
+        if (Services[service].init != NULL) {
+            Services[service].init(service);
+        }
+    }
+    RunServices();
+    while (Now < matchMs) {
+        Now++;
+        MoveBot();
+        if ((X < TAPE_INSET) || (Y < TAPE_INSET) || (X > FIELD_SIZE - TAPE_INSET) ||
+                (Y > FIELD_SIZE - TAPE_INSET)) {
+            OutOfBoundsMs++;
+        }
+        RunTimer3();
+        if ((Stepper_GetPosition() >= BALL_RELEASE_STEPS) && (LastLift < BALL_RELEASE_STEPS)) {
+            DropBall();
+        }
+        LastLift = Stepper_GetPosition();
+        ExpireTimers();
+        do {
+            RunServices();
+        } while (CheckUserEvents() == TRUE);
+        if ((trace != NULL) && (Now % TRACE_PERIOD == 0)) {
+            Trace(trace);
+        }
+    }
+
+    fflush(stdout);
+    if (console >= 0) {
+        dup2(console, STDOUT_FILENO);
+        close(console);
+    }
+    Report(matchMs, (clock() - start) / (double) CLOCKS_PER_SEC);
+#ifdef STATE_STATS
+    StateStats_PrintAll();
+#endif
+#ifdef EVENT_RECORDER
+    Recorder_Dump();
+#endif
+    if (trace != NULL) {
+        fclose(trace);
+    }
+    return 0;
+}
+
+#endif // FIELD_SIM
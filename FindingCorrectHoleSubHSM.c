@@ -32,6 +32,8 @@
 #include "BOARD.h"
 #include "ProjectHSM.h"
 #include "FindingCorrectHoleSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -63,6 +65,7 @@ static const char *StateNames[] = {
 	"OffEdge",
 	"BackingIntoTape",
 };
+STATE_STATS_DECLARE(Stats, "FindingCorrectHoleSubHSM", StateNames);
 
 //Include any defines you need to do
 //was 900
@@ -85,6 +88,15 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void StopAtTape(ES_Event *ThisEvent);
+static void ReportHole(ES_Event *ThisEvent);
+static void EnterReverse(void);
+static void EnterRotateToSide(void);
+static void EnterWait(void);
+static void EnterForward(void);
+static void EnterStop(void);
+static void EnterStayingInBounds(void);
+static void EnterBackingIntoTape(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -92,9 +104,87 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static FindingCorrectHoleSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a FindingCorrectHoleSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, Reverse, NULL, NULL},
+};
+
+static const HSM_Transition_t ReverseTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RotateToSide, NULL, NULL},
+};
+
+static const HSM_Transition_t RotateToSideTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, Wait, NULL, NULL},
+};
+
+static const HSM_Transition_t WaitTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, Forward, NULL, NULL},
+};
+
+static const HSM_Transition_t ForwardTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, Stop, NULL, NULL},
+};
+
+//Stop has always fallen through into StayingInBounds, so it takes its row as well
+static const HSM_Transition_t StopTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, StayingInBounds, NULL, NULL},
+    {L_BALL_TAPE_SEE_WHITE_EVENT, HSM_ANY_PARAM, BackingIntoTape, NULL, NULL},
+};
+
+static const HSM_Transition_t StayingInBoundsTransitions[] = {
+    {L_BALL_TAPE_SEE_WHITE_EVENT, HSM_ANY_PARAM, BackingIntoTape, NULL, NULL},
+};
+
+static const HSM_Transition_t BackingIntoTapeTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, ReportHole},
+    {L_BALL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, HSM_NO_TARGET, NULL, StopAtTape},
+};
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [Reverse] =
+    {EnterReverse, NULL, NULL, NULL, HSM_TRANSITIONS(ReverseTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+    [RotateToSide] =
+    {EnterRotateToSide, NULL, NULL, NULL, HSM_TRANSITIONS(RotateToSideTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+    [Wait] =
+    {EnterWait, NULL, NULL, NULL, HSM_TRANSITIONS(WaitTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+    [Forward] =
+    {EnterForward, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+    [Stop] =
+    {EnterStop, NULL, NULL, NULL, HSM_TRANSITIONS(StopTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(L_BALL_TAPE_SEE_WHITE_EVENT)},
+    [IgnoringBoundaries] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [SeeBlack] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [StayingInBounds] =
+    {EnterStayingInBounds, NULL, NULL, NULL, HSM_TRANSITIONS(StayingInBoundsTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(L_BALL_TAPE_SEE_WHITE_EVENT)},
+    [OffEdge] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [BackingIntoTape] =
+    {EnterBackingIntoTape, NULL, NULL, NULL, HSM_TRANSITIONS(BackingIntoTapeTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(L_BALL_TAPE_SEE_BLACK_EVENT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t FindingCorrectHoleSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -114,6 +204,9 @@ uint8_t InitFindingCorrectHoleSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&FindingCorrectHoleSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunFindingCorrectHoleSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -137,179 +230,8 @@ uint8_t InitFindingCorrectHoleSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunFindingCorrectHoleSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    FindingCorrectHoleSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                nextState = Reverse;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case Reverse:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-40);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, BACK_UP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = RotateToSide;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            /*if (ThisEvent.EventType == ES_EXIT){
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ROTATE_90_DEGREES_TICKS);
-            }*/
-            break;
-            
-        case RotateToSide:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //DriveStraight(0);
-                TankRight(50);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ROTATE_TO_SIDE_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = Wait;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case Wait:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(0);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_WAIT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = Forward;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case Forward: // in the first state, replace this with correct names
-            //We want to go past the edge of the tower.
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(75);
-                //DriveStraight(0);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_FORWARD_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = Stop;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            //Added to reduce slipping of wheels when going forward and reversing.
-        case Stop:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(0);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_WAIT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = StayingInBounds;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-        /*
-        case IgnoringBoundaries:
-            if (ThisEvent.EventType == ES_ENTRY){
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IGNORING_BOUNDRIES_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = OffEdge;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-       
-        case SeeBlack:
-            if (ThisEvent.EventType == ES_ENTRY){
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_SEE_BLACK_TICKS);
-            }
-            //Saw the black tape and is now off the tower.
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                nextState = StayingInBounds;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            //Went past the black tape.
-            if (ThisEvent.EventType = L_BALL_TAPE_SEE_WHITE_EVENT) {
-                nextState = BackingIntoTape;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            //Went off the edge and needs to now come back.
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-               (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = OffEdge;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-        */
-        case StayingInBounds:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-40);
-            }
-            if (ThisEvent.EventType == L_BALL_TAPE_SEE_WHITE_EVENT) {
-                nextState = BackingIntoTape;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-/*
-        case OffEdge:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-40);
-            }
-            if (ThisEvent.EventType == L_BALL_TAPE_SEE_WHITE_EVENT) {
-                nextState = BackingIntoTape;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-*/
-        case BackingIntoTape:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-40);
-            }
-            if (ThisEvent.EventType == L_BALL_TAPE_SEE_BLACK_EVENT) {
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, BACKING_INTO_TAPE_TICKS);
-                ThisEvent.EventType = CORRECT_HOLE_FOUND_EVENT;
-                DriveStraight(0);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-               (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                ThisEvent.EventType = CORRECT_HOLE_FOUND_EVENT;
-            }
-            break;
-            
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunFindingCorrectHoleSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunFindingCorrectHoleSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&FindingCorrectHoleSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -317,4 +239,54 @@ ES_Event RunFindingCorrectHoleSubHSM(ES_Event ThisEvent) {
 
 /*******************************************************************************
  * PRIVATE FUNCTIONS                                                           *
- ******************************************************************************/
\ No newline at end of file
+ ******************************************************************************/
+
+//internal transitions, ProjectHSM leaves FindingCorrectHole on the event they hand back
+static void StopAtTape(ES_Event *ThisEvent) {
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, BACKING_INTO_TAPE_TICKS);
+    ThisEvent->EventType = CORRECT_HOLE_FOUND_EVENT;
+    DriveStraight(0);
+}
+
+static void ReportHole(ES_Event *ThisEvent) {
+    ThisEvent->EventType = CORRECT_HOLE_FOUND_EVENT;
+}
+
+static void EnterReverse(void) {
+    DriveStraight(-40);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, BACK_UP_TICKS);
+}
+
+static void EnterRotateToSide(void) {
+    //DriveStraight(0);
+    TankRight(50);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ROTATE_TO_SIDE_TICKS);
+}
+
+static void EnterWait(void) {
+    DriveStraight(0);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_WAIT_TICKS);
+}
+
+//We want to go past the edge of the tower.
+static void EnterForward(void) {
+    DriveStraight(75);
+    //DriveStraight(0);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_FORWARD_TICKS);
+}
+
+//Added to reduce slipping of wheels when going forward and reversing.
+static void EnterStop(void) {
+    DriveStraight(0);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORRECT_HOLE_WAIT_TICKS);
+    //and StayingInBounds' entry, which Stop has always fallen through into
+    EnterStayingInBounds();
+}
+
+static void EnterStayingInBounds(void) {
+    DriveStraight(-40);
+}
+
+static void EnterBackingIntoTape(void) {
+    DriveStraight(-40);
+}
\ No newline at end of file
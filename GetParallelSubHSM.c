@@ -33,6 +33,7 @@
 #include "ProjectHSM.h"
 #include "GetParallelSubHSM.h"
 #include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -78,6 +79,7 @@ static const char *StateNames[] = {
 	"RForwardOneMore",
 	"ForwardFast",
 };
+STATE_STATS_DECLARE(Stats, "GetParallelSubHSM", StateNames);
 
 //Include any defines you need to do
 #define GET_PARALLEL_HARD_LEFT_TICKS 1000
@@ -104,6 +106,23 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void ReportParallel(ES_Event *ThisEvent);
+static void EnterHardLeft(void);
+static void EnterTurnLeft(void);
+static void EnterLeftBump(void);
+static void EnterLeftRightBump(void);
+static void EnterLeftCenterBump(void);
+static void EnterLBackingUp(void);
+static void EnterTurnRight(void);
+static void EnterRightBump(void);
+static void EnterRightCenterBump(void);
+static void EnterRBackingUp(void);
+static void EnterLAllBump(void);
+static void EnterLBackOneMore(void);
+static void EnterLForwardOneMore(void);
+static void EnterRAllBump(void);
+static void EnterRBackOneMore(void);
+static void EnterRForwardOneMore(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -111,9 +130,158 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static GetParallelSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a GetParallelSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, HardLeft, NULL, NULL},
+};
+
+static const HSM_Transition_t HardLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LBackingUp, NULL, NULL},
+};
+
+static const HSM_Transition_t TurnLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LBackingUp, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, LeftBump, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, RightBump, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, RightBump, NULL, NULL},
+};
+
+static const HSM_Transition_t LeftBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LBackingUp, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, LeftRightBump, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, LeftCenterBump, NULL, NULL},
+};
+
+static const HSM_Transition_t LeftRightBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, ReportParallel},
+};
+
+static const HSM_Transition_t LeftCenterBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LAllBump, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, LAllBump, NULL, NULL},
+};
+
+static const HSM_Transition_t LBackingUpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, TurnLeft, NULL, NULL},
+};
+
+static const HSM_Transition_t TurnRightTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RBackingUp, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, LeftBump, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, RightBump, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, RightBump, NULL, NULL},
+};
+
+static const HSM_Transition_t RightBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RBackingUp, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, RightCenterBump, NULL, NULL},
+};
+
+static const HSM_Transition_t RightCenterBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RAllBump, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, RAllBump, NULL, NULL},
+};
+
+static const HSM_Transition_t RBackingUpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, TurnRight, NULL, NULL},
+};
+
+static const HSM_Transition_t LAllBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LBackOneMore, NULL, NULL},
+};
+
+static const HSM_Transition_t LBackOneMoreTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, LForwardOneMore, NULL, NULL},
+};
+
+static const HSM_Transition_t LForwardOneMoreTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, ReportParallel},
+};
+
+static const HSM_Transition_t RAllBumpTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RBackOneMore, NULL, NULL},
+};
+
+static const HSM_Transition_t RBackOneMoreTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, RForwardOneMore, NULL, NULL},
+};
+
+static const HSM_Transition_t RForwardOneMoreTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, ReportParallel},
+};
+
+#define TIMEOUT_EVENTS HSM_EVENT(ES_TIMEOUT)
+#define BUMP_EVENTS (HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | \
+    HSM_EVENT(FC_BUMP_EVENT))
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [HardLeft] =
+    {EnterHardLeft, NULL, NULL, NULL, HSM_TRANSITIONS(HardLeftTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [TurnLeft] =
+    {EnterTurnLeft, NULL, NULL, NULL, HSM_TRANSITIONS(TurnLeftTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [LeftBump] =
+    {EnterLeftBump, NULL, NULL, NULL, HSM_TRANSITIONS(LeftBumpTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [LeftRightBump] =
+    {EnterLeftRightBump, NULL, NULL, NULL, HSM_TRANSITIONS(LeftRightBumpTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [LeftCenterBump] =
+    {EnterLeftCenterBump, NULL, NULL, NULL, HSM_TRANSITIONS(LeftCenterBumpTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [LBackingUp] =
+    {EnterLBackingUp, NULL, NULL, NULL, HSM_TRANSITIONS(LBackingUpTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [TurnRight] =
+    {EnterTurnRight, NULL, NULL, NULL, HSM_TRANSITIONS(TurnRightTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [RightBump] =
+    {EnterRightBump, NULL, NULL, NULL, HSM_TRANSITIONS(RightBumpTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [RightCenterBump] =
+    {EnterRightCenterBump, NULL, NULL, NULL, HSM_TRANSITIONS(RightCenterBumpTransitions), HSM_NO_STATE, 0,
+        BUMP_EVENTS},
+    [RBackingUp] =
+    {EnterRBackingUp, NULL, NULL, NULL, HSM_TRANSITIONS(RBackingUpTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [LAllBump] =
+    {EnterLAllBump, NULL, NULL, NULL, HSM_TRANSITIONS(LAllBumpTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [LBackOneMore] =
+    {EnterLBackOneMore, NULL, NULL, NULL, HSM_TRANSITIONS(LBackOneMoreTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [LForwardOneMore] =
+    {EnterLForwardOneMore, NULL, NULL, NULL, HSM_TRANSITIONS(LForwardOneMoreTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [RAllBump] =
+    {EnterRAllBump, NULL, NULL, NULL, HSM_TRANSITIONS(RAllBumpTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [RBackOneMore] =
+    {EnterRBackOneMore, NULL, NULL, NULL, HSM_TRANSITIONS(RBackOneMoreTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [RForwardOneMore] =
+    {EnterRForwardOneMore, NULL, NULL, NULL, HSM_TRANSITIONS(RForwardOneMoreTransitions), HSM_NO_STATE, 0,
+        TIMEOUT_EVENTS},
+    [ForwardFast] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t GetParallelSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -133,6 +301,9 @@ uint8_t InitGetParallelSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&GetParallelSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunGetParallelSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -156,377 +327,8 @@ uint8_t InitGetParallelSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunGetParallelSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    GetParallelSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                nextState = HardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case HardLeft:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnHardLeft(100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_HARD_LEFT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = LBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            break;
-            
-        case TurnLeft: // in the first state, replace this with correct names
-            if (ThisEvent.EventType == ES_ENTRY){
-                //was half second
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_TURN_LEFT_TICKS);
-                TurnNormalLeft(100);
-            }
-            if (ThisEvent.EventType == FL_BUMP_EVENT) {
-                nextState = LeftBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FC_BUMP_EVENT) {
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FR_BUMP_EVENT) {
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = LBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            /* Previous code.
-            if (ThisEvent.EventType == FR_BUMP_EVENT) {
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FC_BUMP_EVENT) {
-                nextState = LeftCenterBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = LBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-             */
-            break;
-            
-        case LeftBump:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //was half.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_BUMP_TICKS);
-            }
-            if (ThisEvent.EventType == FC_BUMP_EVENT){
-                nextState = LeftCenterBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FR_BUMP_EVENT){
-                nextState = LeftRightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = LBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            break;
-            
-        case LeftRightBump:
-            if (ThisEvent.EventType == ES_ENTRY){
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-                //was half.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_RIGHT_BUMP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }
-            break;
-            
-        case LeftCenterBump:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //was one second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_CENTER_BUMP_TICKS);
-            }
-            if (ThisEvent.EventType == FR_BUMP_EVENT){
-                nextState = LAllBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                //nextState = LBackingUp;
-                nextState = LAllBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            /* Previous code
-            if (ThisEvent.EventType == ES_ENTRY){
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, HALF_SECOND_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }*/
-            break;
-
-        case LBackingUp:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_L_BACKING_UP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                //Find out the amount of time to tank turn 45 degrees at 90 speed.
-                //Rotational distance is about 3.5 inches. Speed is 12.35 inches/s
-                
-                nextState = TurnLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case TurnRight:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                TurnNormalRight(100);
-                //was one second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_TURN_RIGHT_TICKS);
-            }
-            if (ThisEvent.EventType == FR_BUMP_EVENT){
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FL_BUMP_EVENT){
-                nextState = LeftBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (ThisEvent.EventType == FC_BUMP_EVENT){
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = RBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            break;
-            
-        case RightBump:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                //was 100
-                TurnNormalRight(80);
-                //was half second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_RIGHT_BUMP_TICKS);
-            }
-            if (ThisEvent.EventType == FC_BUMP_EVENT) {
-                nextState = RightCenterBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = RBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case RightCenterBump:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                //was one second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_RIGHT_CENTER_BUMP_TICKS);
-            }
-            if (ThisEvent.EventType == FL_BUMP_EVENT){
-                nextState = RAllBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = RAllBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType == ES_NO_EVENT;
-            }
-            /* Previous code
-            if (ThisEvent.EventType == ES_ENTRY) {
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, HALF_SECOND_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }*/
-            break;
-
-        case RBackingUp:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                DriveStraight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_R_BACKING_UP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                //Find out the amount of time to tank turn 45 degrees at 90 speed.
-                //Rotational distance is about 3.5 inches. Speed is 12.35 inches/s
-                nextState = TurnRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case LAllBump:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                //ThisEvent.EventType = GOT_PARALLEL_EVENT;
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_ALL_BUMP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = LBackOneMore;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-                //ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }
-            break;
-            
-        case LBackOneMore:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_BACK_ONE_MORE_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                //Find out the amount of time to tank turn 45 degrees at 90 speed.
-                //Rotational distance is about 3.5 inches. Speed is 12.35 inches/s
-                
-                nextState = LForwardOneMore;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case LForwardOneMore:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //was half second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_FORWARD_ONE_MORE_TICKS);
-                TurnNormalLeft(100);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }
-            break;
-
-        case RAllBump:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                //ThisEvent.EventType = GOT_PARALLEL_EVENT;
-                //was half second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_ALL_BUMP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = RBackOneMore;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-                //ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }
-            break;
-            
-        case RBackOneMore:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_BACK_ONE_MORE_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                //Find out the amount of time to tank turn 45 degrees at 90 speed.
-                //Rotational distance is about 3.5 inches. Speed is 12.35 inches/s
-                
-                nextState = RForwardOneMore;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case RForwardOneMore:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //Was half second.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_FORWARD_ONE_MORE_TICKS);
-                TurnNormalRight(100);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                ThisEvent.EventType = GOT_PARALLEL_EVENT;
-            }
-            break;
-            
-            /*
-        case TankingRight:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TankRight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ROTATE_45_DEGREES_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) &&
-                    (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = ForwardFast;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case ForwardFast:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                DriveStraight(100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ONE_POINT_FIVE_SECOND_TICKS);
-            }
-            if (ThisEvent.EventType == FR_BUMP_EVENT) {
-                nextState = RightBump;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = LBackingUp;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-*/
-
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunGetParallelSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunGetParallelSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&GetParallelSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -536,3 +338,92 @@ ES_Event RunGetParallelSubHSM(ES_Event ThisEvent) {
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+//an internal transition, ProjectHSM leaves GetParallel on the event it hands back
+static void ReportParallel(ES_Event *ThisEvent) {
+    ThisEvent->EventType = GOT_PARALLEL_EVENT;
+}
+
+static void EnterHardLeft(void) {
+    TurnHardLeft(100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_HARD_LEFT_TICKS);
+}
+
+static void EnterTurnLeft(void) {
+    //was half second
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_TURN_LEFT_TICKS);
+    TurnNormalLeft(100);
+}
+
+static void EnterLeftBump(void) {
+    //was half.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_BUMP_TICKS);
+}
+
+static void EnterLeftRightBump(void) {
+    //was half.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_RIGHT_BUMP_TICKS);
+}
+
+static void EnterLeftCenterBump(void) {
+    //was one second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_LEFT_CENTER_BUMP_TICKS);
+}
+
+static void EnterLBackingUp(void) {
+    DriveStraight(-100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_L_BACKING_UP_TICKS);
+}
+
+static void EnterTurnRight(void) {
+    TurnNormalRight(100);
+    //was one second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_TURN_RIGHT_TICKS);
+}
+
+static void EnterRightBump(void) {
+    //was 100
+    TurnNormalRight(80);
+    //was half second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_RIGHT_BUMP_TICKS);
+}
+
+static void EnterRightCenterBump(void) {
+    //was one second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_RIGHT_CENTER_BUMP_TICKS);
+}
+
+static void EnterRBackingUp(void) {
+    DriveStraight(-100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, GET_PARALLEL_R_BACKING_UP_TICKS);
+}
+
+static void EnterLAllBump(void) {
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_ALL_BUMP_TICKS);
+}
+
+static void EnterLBackOneMore(void) {
+    DriveStraight(-100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_BACK_ONE_MORE_TICKS);
+}
+
+static void EnterLForwardOneMore(void) {
+    //was half second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, L_FORWARD_ONE_MORE_TICKS);
+    TurnNormalLeft(100);
+}
+
+static void EnterRAllBump(void) {
+    //was half second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_ALL_BUMP_TICKS);
+}
+
+static void EnterRBackOneMore(void) {
+    DriveStraight(-100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_BACK_ONE_MORE_TICKS);
+}
+
+static void EnterRForwardOneMore(void) {
+    //Was half second.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, R_FORWARD_ONE_MORE_TICKS);
+    TurnNormalRight(100);
+}
@@ -0,0 +1,1015 @@
+/*
+ * File:   HSM_Engine.c
+ *
+ * Table driven state machine runtime, see HSM_Engine.h.
+ */
+
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "HSM_Engine.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define HSM_ENGINE_TEST
+
+// what a row index says about its state besides the rows
+#define EXIT_WORK 0x01                  // a sub-HSM, timer or exit action here or further up
+#define START_WORK 0x02                 // a sub-HSM to start or resume on the way in
+#define CATCH_WORK 0x04                 // catch-alls of its own to try on the way in
+#define INDEXED 0x80                    // HSM_Verify has filled the index in
+
+#if HSM_MAX_DEPTH > (1 << (8 - HSM_INDEX_UP_SHIFT))
+#error "a row index entry has to count up to HSM_MAX_DEPTH - 1 parents"
+#endif
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static int8_t IndexRows(const HSM_Machine_t *machine, uint8_t i);
+static HSM_Interest_t SubWants(const HSM_Machine_t *sub);
+static void Dispatch(const HSM_Machine_t *machine, const HSM_State_t *state,
+        const HSM_RowIndex_t *rows, ES_Event *ThisEvent);
+static ES_Event EnterOrExit(const HSM_Machine_t *machine, ES_Event ThisEvent);
+static uint8_t CheckTimeout(const HSM_Machine_t *machine, ES_Event *ThisEvent);
+static const HSM_Transition_t *Search(const HSM_Machine_t *machine, const HSM_State_t *state,
+        const ES_Event *ThisEvent, uint8_t first);
+static void TakeTransition(const HSM_Machine_t *machine,
+        const HSM_Transition_t *transition, ES_Event *ThisEvent);
+static inline void Move(const HSM_Machine_t *machine, const HSM_State_t *from, uint8_t work,
+        uint8_t target) __attribute__((always_inline));
+static void TransitionAcross(const HSM_Machine_t *machine, uint8_t current, uint8_t target);
+static void FinishEntry(const HSM_Machine_t *machine, uint8_t s, uint8_t work);
+static void TakeEntryTransition(const HSM_Machine_t *machine, uint8_t s);
+static inline uint8_t RowMatches(const HSM_Transition_t *row, const ES_Event *ThisEvent);
+static TimerWheel_Timer_t *OwnedTimer(const HSM_Machine_t *machine, uint8_t state, uint8_t id);
+static uint8_t CommonAncestor(const HSM_Machine_t *machine, uint8_t from, uint8_t to);
+static void ExitStates(const HSM_Machine_t *machine, uint8_t from, uint8_t to);
+static void EnterStates(const HSM_Machine_t *machine, uint8_t from, uint8_t to);
+static inline void ExitState(const HSM_State_t *state) __attribute__((always_inline));
+static inline void EnterState(const HSM_Machine_t *machine, uint8_t s) __attribute__((always_inline));
+static inline void StartSub(const HSM_Machine_t *machine, uint8_t s) __attribute__((always_inline));
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+ES_Event HSM_Run(const HSM_Machine_t *machine, ES_Event ThisEvent)
+{
+    uint8_t current = *machine->current;
+
+    // no state wants ES_ENTRY or ES_EXIT, so one AND takes them and the events
+    // the state has no use for off the dispatch path
+    if (machine->rows[current].wants & HSM_EVENT(ThisEvent.EventType)) {
+        Dispatch(machine, &machine->states[current], &machine->rows[current], &ThisEvent);
+        return ThisEvent;
+    }
+    if ((ThisEvent.EventType == ES_ENTRY) || (ThisEvent.EventType == ES_EXIT)) {
+        return EnterOrExit(machine, ThisEvent);
+    }
+    if (machine->ignored != NULL) {
+        (*machine->ignored)++;
+    }
+    return ThisEvent;
+}
+
+uint8_t HSM_Wants(const HSM_Machine_t *machine, ES_EventTyp_t event)
+{
+    return (machine->rows[*machine->current].wants & HSM_EVENT(event)) != 0;
+}
+
+int8_t HSM_Verify(const HSM_Machine_t *machine)
+{
+    const HSM_State_t *state;
+    const HSM_Transition_t *row;
+    uint8_t i, j, s, depth;
+
+    if ((machine->rows == NULL) || (*machine->current >= machine->numStates)) {
+        return ERROR;
+    }
+    // the tables are const, once they have passed and been indexed that holds
+    if (machine->rows[0].work & INDEXED) {
+        return SUCCESS;
+    }
+    for (i = 0; i < machine->numStates; i++) {
+        state = &machine->states[i];
+        // what a state wants comes partly from its sub-HSM's index
+        if ((state->sub != NULL) && (HSM_Verify(state->sub) == ERROR)) {
+            return ERROR;
+        }
+        if ((state->numTransitions > 0) && (state->transitions == NULL)) {
+            return ERROR;
+        }
+        for (j = 0; j < state->numTransitions; j++) {
+            if ((j > 0) && (state->transitions[j].event < state->transitions[j - 1].event)) {
+                return ERROR;
+            }
+            if ((state->transitions[j].target != HSM_NO_TARGET) &&
+                    (state->transitions[j].target >= machine->numStates)) {
+                return ERROR;
+            }
+        }
+        if ((state->flags & HSM_HISTORY) &&
+                ((machine->started == NULL) || (i >= HSM_MAX_HISTORY_STATES))) {
+            return ERROR;
+        }
+        // also catches parent loops, they never reach the top, and checks this
+        // state wants every event its own and its parents' rows take
+        depth = 0;
+        for (s = i; s != HSM_NO_STATE; s = machine->states[s].parent) {
+            if ((s >= machine->numStates) || (++depth > HSM_MAX_DEPTH)) {
+                return ERROR;
+            }
+            for (j = 0; j < machine->states[s].numTransitions; j++) {
+                row = &machine->states[s].transitions[j];
+                if ((row->event == HSM_ANY_EVENT) ? (state->interest != HSM_ALL_EVENTS) :
+                        ((state->interest & HSM_EVENT(row->event)) == 0)) {
+                    return ERROR;
+                }
+                if ((row->event == ES_TIMEOUT) && (row->param != HSM_ANY_PARAM) &&
+                        (row->param >= TIMER_WHEEL_FIRST_ID) &&
+                        (OwnedTimer(machine, i, row->param) == NULL)) {
+                    return ERROR;
+                }
+                if ((row->event != HSM_ANY_EVENT) && (row->event >= HSM_EVENT_TYPES)) {
+                    return ERROR;
+                }
+            }
+        }
+        if (IndexRows(machine, i) == ERROR) {
+            return ERROR;
+        }
+    }
+    for (i = 0; i < machine->numStates; i++) {
+        machine->rows[i].work |= INDEXED;
+    }
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+/**
+ * @Function IndexRows(const HSM_Machine_t *machine, uint8_t i)
+ * @return SUCCESS, or ERROR if a table is too long to index
+ * @brief Fills in state i's row index: for each event type, the first table up
+ *        from the state with a row for it or a catch-all, and the first of
+ *        those rows. The search goes on up from there if none of them match.
+ *        Also notes the events the state or its sub-HSM have a row for, and
+ *        whether entering or leaving the state takes more than its entry action.
+ */
+static int8_t IndexRows(const HSM_Machine_t *machine, uint8_t i)
+{
+    HSM_RowIndex_t *rows = &machine->rows[i];
+    const HSM_State_t *state;
+    uint8_t event, j, s, up;
+
+    rows->wants = 0;
+    rows->work = 0;
+    for (event = 0; event < HSM_EVENT_TYPES; event++) {
+        rows->first[event] = 0;
+        for (s = i, up = 0; s != HSM_NO_STATE; s = state->parent, up++) {
+            state = &machine->states[s];
+            if (state->numTransitions > HSM_INDEX_ROW_MASK) {
+                return ERROR;
+            }
+            for (j = 0; j < state->numTransitions; j++) {
+                if ((state->transitions[j].event == event) ||
+                        (state->transitions[j].event == HSM_ANY_EVENT)) {
+                    break;
+                }
+            }
+            if (j < state->numTransitions) {
+                rows->first[event] = (up << HSM_INDEX_UP_SHIFT) | (j + 1);
+                if ((up == 0) && (state->transitions[j].param == HSM_ANY_PARAM) &&
+                        (state->transitions[j].guard == NULL) && (state->transitions[j].action == NULL) &&
+                        (state->transitions[j].target != HSM_NO_TARGET)) {
+                    rows->first[event] |= HSM_INDEX_PLAIN;
+                }
+                rows->wants |= HSM_EVENT(event);
+                break;
+            }
+        }
+    }
+    for (s = i; s != HSM_NO_STATE; s = state->parent) {
+        state = &machine->states[s];
+        if ((state->sub != NULL) || (state->timer != NULL) || (state->exit != NULL)) {
+            rows->work |= EXIT_WORK;
+        }
+    }
+    state = &machine->states[i];
+    if (state->sub != NULL) {
+        rows->wants |= SubWants(state->sub);
+        rows->work |= START_WORK;
+    }
+    // no row is for ES_ENTRY itself, so its entry finds the state's catch-alls
+    if ((rows->first[ES_ENTRY] != 0) && ((rows->first[ES_ENTRY] >> HSM_INDEX_UP_SHIFT) == 0)) {
+        rows->work |= CATCH_WORK;
+    }
+    // the interest mask can only narrow that down
+    rows->wants &= state->interest & HSM_ALL_EVENTS;
+    return SUCCESS;
+}
+
+// everything any state of a verified sub-HSM wants
+static HSM_Interest_t SubWants(const HSM_Machine_t *sub)
+{
+    HSM_Interest_t wants = 0;
+    uint8_t i;
+
+    for (i = 0; i < sub->numStates; i++) {
+        wants |= sub->rows[i].wants;
+    }
+    return wants;
+}
+
+/**
+ * @Function Dispatch(const HSM_Machine_t *machine, const HSM_State_t *state,
+ *           const HSM_RowIndex_t *rows, ES_Event *ThisEvent)
+ * @param state, rows - the current state and its row index
+ * @param ThisEvent - left as the event to pass back up
+ * @brief Runs an event the current state wants through its sub-HSM and then
+ *        the tables. The sub-HSM is dispatched to here directly, without
+ *        going through its Run function, and only with events its current
+ *        state wants. The row index takes the event straight to its row, a
+ *        plain one goes straight to its target and only a guarded row or one
+ *        further up is searched for.
+ */
+static void __attribute__((noinline)) Dispatch(const HSM_Machine_t *machine, const HSM_State_t *state,
+        const HSM_RowIndex_t *rows, ES_Event *ThisEvent)
+{
+    const HSM_Machine_t *sub = state->sub;
+    const HSM_RowIndex_t *subRows;
+    const HSM_Transition_t *transition;
+    uint8_t first;
+
+    if ((ThisEvent->EventType == ES_TIMEOUT) &&
+            (TIMER_WHEEL_ID(ThisEvent->EventParam) >= TIMER_WHEEL_FIRST_ID) &&
+            (CheckTimeout(machine, ThisEvent) == FALSE)) {
+        return;
+    }
+    if (sub != NULL) {
+        subRows = &sub->rows[*sub->current];
+        if (subRows->wants & HSM_EVENT(ThisEvent->EventType)) {
+            Dispatch(sub, &sub->states[*sub->current], subRows, ThisEvent);
+        } else if (sub->ignored != NULL) {
+            (*sub->ignored)++;
+        }
+    }
+    // most of what a sub-HSM hands back has no row anywhere up the tables,
+    // the ES_NO_EVENT it leaves when it takes the event only has catch-alls
+    if (ThisEvent->EventType >= HSM_EVENT_TYPES) {
+        return;
+    }
+    first = rows->first[ThisEvent->EventType];
+    if (first == 0) {
+        return;
+    }
+    if (first & HSM_INDEX_PLAIN) {
+        ThisEvent->EventType = ES_NO_EVENT;
+        Move(machine, state, rows->work, state->transitions[(first & HSM_INDEX_ROW_MASK) - 1].target);
+        return;
+    }
+    transition = Search(machine, state, ThisEvent, first);
+    if (transition != NULL) {
+        TakeTransition(machine, transition, ThisEvent);
+    }
+}
+
+// runs ES_ENTRY and ES_EXIT from the machine above into the current state
+static ES_Event __attribute__((noinline)) EnterOrExit(const HSM_Machine_t *machine, ES_Event ThisEvent)
+{
+    if (ThisEvent.EventType == ES_ENTRY) {
+        STATE_STATS_EVENT(machine->stats, ThisEvent);
+        EnterStates(machine, HSM_NO_STATE, *machine->current);
+        TakeEntryTransition(machine, *machine->current);
+    } else {
+        if (machine->rows[*machine->current].work & EXIT_WORK) {
+            ExitStates(machine, *machine->current, HSM_NO_STATE);
+        }
+        STATE_STATS_EVENT(machine->stats, ThisEvent);
+    }
+    return ThisEvent;
+}
+
+/**
+ * @Function CheckTimeout(const HSM_Machine_t *machine, ES_Event *ThisEvent)
+ * @return FALSE with the event consumed if it is a stale timeout of a timer the
+ *         current state owns, otherwise TRUE with a current one renamed to its
+ *         timer
+ */
+static uint8_t __attribute__((noinline)) CheckTimeout(const HSM_Machine_t *machine, ES_Event *ThisEvent)
+{
+    TimerWheel_Timer_t *timer = OwnedTimer(machine, *machine->current,
+            TIMER_WHEEL_ID(ThisEvent->EventParam));
+
+    if (timer == NULL) {
+        return TRUE;
+    }
+    // restarted or stopped since it was posted
+    if (TimerWheel_IsCurrent(timer, *ThisEvent) == FALSE) {
+        ThisEvent->EventType = ES_NO_EVENT;
+        return FALSE;
+    }
+    ThisEvent->EventParam = timer->id;
+    return TRUE;
+}
+
+/**
+ * @Function Search(const HSM_Machine_t *machine, const HSM_State_t *state,
+ *           const ES_Event *ThisEvent, uint8_t first)
+ * @param state - the current state
+ * @param first - its row index entry for the event, not 0
+ * @return the first row from the index entry on that takes the event, or NULL
+ * @brief Tries the rows for the event and the catch-alls after them in the
+ *        table the index entry points at, and only when none match looks
+ *        further up.
+ */
+static const HSM_Transition_t * __attribute__((noinline)) Search(const HSM_Machine_t *machine,
+        const HSM_State_t *state, const ES_Event *ThisEvent, uint8_t first)
+{
+    const HSM_Transition_t *transition;
+    uint8_t s;
+    uint8_t n;
+
+    for (;;) {
+        for (n = first >> HSM_INDEX_UP_SHIFT; n > 0; n--) {
+            state = &machine->states[state->parent];
+        }
+        n = first & HSM_INDEX_ROW_MASK;
+        transition = &state->transitions[n - 1];
+        for (; n <= state->numTransitions; n++, transition++) {
+            if (((transition->event == ThisEvent->EventType) || (transition->event == HSM_ANY_EVENT)) &&
+                    RowMatches(transition, ThisEvent)) {
+                return transition;
+            }
+        }
+        s = state->parent;
+        if ((s == HSM_NO_STATE) || ((first = machine->rows[s].first[ThisEvent->EventType]) == 0)) {
+            return NULL;
+        }
+        state = &machine->states[s];
+    }
+}
+
+/**
+ * @Function TakeTransition(const HSM_Machine_t *machine,
+ *           const HSM_Transition_t *transition, ES_Event *ThisEvent)
+ * @param ThisEvent - left as what its action makes of it for an internal
+ *        transition, ES_NO_EVENT once the exits and entries of one with a
+ *        target are done
+ */
+static void __attribute__((noinline)) TakeTransition(const HSM_Machine_t *machine,
+        const HSM_Transition_t *transition, ES_Event *ThisEvent)
+{
+    uint8_t current;
+
+    if (transition->action != NULL) {
+        transition->action(ThisEvent);
+    }
+    if (transition->target == HSM_NO_TARGET) {
+        return;
+    }
+    current = *machine->current;
+    Move(machine, &machine->states[current], machine->rows[current].work, transition->target);
+    ThisEvent->EventType = ES_NO_EVENT;
+}
+
+// moves from the current state, whose row index says work, to target
+static inline void Move(const HSM_Machine_t *machine, const HSM_State_t *from, uint8_t work,
+        uint8_t target)
+{
+    const HSM_State_t *state = &machine->states[target];
+
+    // siblings, everything the engine runs so far, go straight across, and
+    // the row index says which of them have more to do than an entry action
+    if (from->parent == state->parent) {
+        if (work & EXIT_WORK) {
+            ExitState(from);
+        }
+        STATE_STATS_TRANSITION(machine->stats, *machine->current, target);
+        *machine->current = target;
+        if (state->entry != NULL) {
+            state->entry();
+        }
+        work = machine->rows[target].work;
+        if (work & (START_WORK | CATCH_WORK)) {
+            FinishEntry(machine, target, work);
+        }
+    } else {
+        TransitionAcross(machine, *machine->current, target);
+    }
+}
+
+// exits up to the common ancestor and enters down to target, for targets that
+// are not siblings of the current state
+static void __attribute__((noinline)) TransitionAcross(const HSM_Machine_t *machine,
+        uint8_t current, uint8_t target)
+{
+    uint8_t s = CommonAncestor(machine, current, target);
+
+    ExitStates(machine, current, s);
+    *machine->current = target;
+    STATE_STATS_TRANSITION(machine->stats, current, target);
+    EnterStates(machine, s, target);
+    TakeEntryTransition(machine, target);
+}
+
+// starts the sub-HSM of a sibling just entered and tries its catch-alls
+static void __attribute__((noinline)) FinishEntry(const HSM_Machine_t *machine, uint8_t s, uint8_t work)
+{
+    if (work & START_WORK) {
+        StartSub(machine, s);
+    }
+    if (work & CATCH_WORK) {
+        TakeEntryTransition(machine, s);
+    }
+}
+
+// catch-alls stand in for the template's checks at the bottom of a case, and
+// those saw the ES_ENTRY a state was entered with too, so the state just
+// entered gets to try its own catch-alls on it
+static void __attribute__((noinline)) TakeEntryTransition(const HSM_Machine_t *machine, uint8_t s)
+{
+    const HSM_State_t *state = &machine->states[s];
+    const HSM_Transition_t *transition;
+    ES_Event ThisEvent = ENTRY_EVENT;
+    uint8_t first = machine->rows[s].first[ES_ENTRY];
+    uint8_t n;
+
+    if ((first == 0) || ((first >> HSM_INDEX_UP_SHIFT) != 0)) {
+        return;
+    }
+    n = first & HSM_INDEX_ROW_MASK;
+    for (transition = &state->transitions[n - 1]; n <= state->numTransitions; n++, transition++) {
+        if (RowMatches(transition, &ThisEvent)) {
+            TakeTransition(machine, transition, &ThisEvent);
+            return;
+        }
+    }
+}
+
+// TRUE if the row's param and guard take the event
+static inline uint8_t RowMatches(const HSM_Transition_t *row, const ES_Event *ThisEvent)
+{
+    return ((row->param == HSM_ANY_PARAM) || (row->param == ThisEvent->EventParam)) &&
+            ((row->guard == NULL) || row->guard(ThisEvent));
+}
+
+// the timer named id that state or one of its parents owns, or NULL
+static TimerWheel_Timer_t *OwnedTimer(const HSM_Machine_t *machine, uint8_t state, uint8_t id)
+{
+    for (; state != HSM_NO_STATE; state = machine->states[state].parent) {
+        if ((machine->states[state].timer != NULL) && (machine->states[state].timer->id == id)) {
+            return machine->states[state].timer;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @Function CommonAncestor(const HSM_Machine_t *machine, uint8_t from, uint8_t to)
+ * @return the state a transition from from to to exits up to and enters down
+ *         from, not to itself so a self transition exits and enters again
+ */
+static uint8_t CommonAncestor(const HSM_Machine_t *machine, uint8_t from, uint8_t to)
+{
+    uint8_t f, t;
+
+    for (t = machine->states[to].parent; t != HSM_NO_STATE; t = machine->states[t].parent) {
+        for (f = from; f != HSM_NO_STATE; f = machine->states[f].parent) {
+            if (f == t) {
+                return t;
+            }
+        }
+    }
+    return HSM_NO_STATE;
+}
+
+// exits from and its parents, innermost first, stopping below to
+static void ExitStates(const HSM_Machine_t *machine, uint8_t from, uint8_t to)
+{
+    const HSM_State_t *state;
+
+    for (; from != to; from = state->parent) {
+        state = &machine->states[from];
+        ExitState(state);
+    }
+}
+
+// enters the states below from on the way down to to, outermost first
+static void EnterStates(const HSM_Machine_t *machine, uint8_t from, uint8_t to)
+{
+    uint8_t path[HSM_MAX_DEPTH];
+    uint8_t depth = 0;
+
+    for (; (to != from) && (depth < HSM_MAX_DEPTH); to = machine->states[to].parent) {
+        path[depth++] = to;
+    }
+    while (depth > 0) {
+        EnterState(machine, path[--depth]);
+    }
+}
+
+// exits the state's sub-HSM, stops its timer and runs its exit action
+static inline void ExitState(const HSM_State_t *state)
+{
+    if (state->sub != NULL) {
+        EnterOrExit(state->sub, EXIT_EVENT);
+    }
+    if (state->timer != NULL) {
+        TimerWheel_Stop(state->timer);
+    }
+    if (state->exit != NULL) {
+        state->exit();
+    }
+}
+
+// runs a state's entry action and starts or resumes its sub-HSM
+static inline void EnterState(const HSM_Machine_t *machine, uint8_t s)
+{
+    const HSM_State_t *state = &machine->states[s];
+
+    if (state->entry != NULL) {
+        state->entry();
+    }
+    if (state->sub != NULL) {
+        StartSub(machine, s);
+    }
+}
+
+// starts the sub-HSM of state s over, or resumes it if s keeps history
+static inline void StartSub(const HSM_Machine_t *machine, uint8_t s)
+{
+    const HSM_State_t *state = &machine->states[s];
+
+    if ((state->subInit == NULL) ||
+            ((state->flags & HSM_HISTORY) && (*machine->started & (1UL << s)))) {
+        EnterOrExit(state->sub, ENTRY_EVENT);
+    } else {
+        state->subInit();
+        if (machine->started != NULL) {
+            *machine->started |= 1UL << s;
+        }
+    }
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef HSM_ENGINE_TEST
+
+#include <stdio.h>
+#include <HW_Regs.h>
+#include "TestHarness.h"
+
+// ProjectHSM's top level as the template switch, and as tables with and without
+// history and interest masks. Under each top state runs the same small drive
+// sub-HSM, a template switch under the switch and a table under the tables
+#define BENCH_EVENTS 1000000UL
+#define CORE_TICKS_PER_SEC 40000000ULL
+
+enum {
+    BenchInit, BenchBeacon, BenchWall, BenchBounds, BenchParallel, BenchHole, BenchDispense, BENCH_STATES
+};
+
+enum {
+    SubInit, SubDrive, SubTurn, SubBack, SUB_STATES
+};
+
+static uint8_t SwitchState, TableState, HistoryState, InterestState;
+static uint8_t SwitchSubState, TableSubState, HistorySubState, InterestSubState;
+static uint32_t HistoryStarted, InterestStarted, InterestIgnored, SubIgnored;
+static uint32_t subStarts, driveCalls;
+static int16_t lastDrive, switchDrive, tableDrive;
+static uint8_t bumpers = 1;
+
+// stands in for the motor commands of the real sub-HSMs' states
+static void __attribute__((noinline)) BenchDrive(int16_t speed)
+{
+    driveCalls++;
+    lastDrive = speed;
+}
+
+// the sub-HSM as the template writes it, drives until a timeout, turns until the
+// next, and backs off when the beacon shows up or goes away
+static ES_Event __attribute__((noinline)) RunSwitchSub(ES_Event ThisEvent)
+{
+    uint8_t makeTransition = FALSE;
+    uint8_t nextState = 0;
+
+    switch (SwitchSubState) {
+    case SubInit:
+        if (ThisEvent.EventType == ES_INIT) {
+            nextState = SubDrive;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case SubDrive:
+        if (ThisEvent.EventType == ES_ENTRY) {
+            BenchDrive(100);
+        }
+        if (ThisEvent.EventType == ES_TIMEOUT) {
+            nextState = SubTurn;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        if (ThisEvent.EventType == BEACON_FOUND_EVENT) {
+            nextState = SubBack;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case SubTurn:
+        if (ThisEvent.EventType == ES_ENTRY) {
+            BenchDrive(50);
+        }
+        if (ThisEvent.EventType == ES_TIMEOUT) {
+            nextState = SubDrive;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        if (ThisEvent.EventType == NO_BEACON_EVENT) {
+            nextState = SubBack;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case SubBack:
+        if (ThisEvent.EventType == ES_ENTRY) {
+            BenchDrive(-100);
+        }
+        if (ThisEvent.EventType == ES_TIMEOUT) {
+            nextState = SubDrive;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    default:
+        break;
+    }
+    if (makeTransition == TRUE) {
+        RunSwitchSub(EXIT_EVENT);
+        SwitchSubState = nextState;
+        RunSwitchSub(ENTRY_EVENT);
+    }
+    return ThisEvent;
+}
+
+static uint8_t __attribute__((noinline)) InitSwitchSub(void)
+{
+    subStarts++;
+    SwitchSubState = SubInit;
+    RunSwitchSub(INIT_EVENT);
+    return TRUE;
+}
+
+static ES_Event RunSwitchHSM(ES_Event ThisEvent)
+{
+    uint8_t makeTransition = FALSE;
+    uint8_t nextState = 0;
+
+    switch (SwitchState) {
+    case BenchInit:
+        if (ThisEvent.EventType == ES_INIT) {
+            for (nextState = BenchBeacon; nextState < BENCH_STATES; nextState++) {
+                InitSwitchSub();
+            }
+            nextState = BenchBeacon;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchBeacon:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if ((ThisEvent.EventType == FL_BUMP_EVENT) || (ThisEvent.EventType == FR_BUMP_EVENT) ||
+                (ThisEvent.EventType == FC_BUMP_EVENT)) {
+            nextState = BenchWall;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchWall:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if (ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) {
+            nextState = BenchBounds;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        if (ThisEvent.EventType == CORRECT_WALL_DETECTED_EVENT) {
+            nextState = BenchParallel;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchBounds:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if (ThisEvent.EventType == WALL_DETECTED_EVENT) {
+            nextState = BenchWall;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchParallel:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if (ThisEvent.EventType == GOT_PARALLEL_EVENT) {
+            nextState = BenchHole;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        if ((ThisEvent.EventType != ES_EXIT) && (bumpers == 0)) {
+            nextState = BenchHole;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchHole:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if (ThisEvent.EventType == CORRECT_HOLE_FOUND_EVENT) {
+            nextState = BenchDispense;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    case BenchDispense:
+        ThisEvent = RunSwitchSub(ThisEvent);
+        if (ThisEvent.EventType == BALL_DISPENSED_EVENT) {
+            nextState = BenchBeacon;
+            makeTransition = TRUE;
+            ThisEvent.EventType = ES_NO_EVENT;
+        }
+        break;
+    default:
+        break;
+    }
+    if (makeTransition == TRUE) {
+        RunSwitchHSM(EXIT_EVENT);
+        SwitchState = nextState;
+        RunSwitchHSM(ENTRY_EVENT);
+        InitSwitchSub();
+    }
+    return ThisEvent;
+}
+
+static void EnterSubDrive(void)
+{
+    BenchDrive(100);
+}
+
+static void EnterSubTurn(void)
+{
+    BenchDrive(50);
+}
+
+static void EnterSubBack(void)
+{
+    BenchDrive(-100);
+}
+
+static const HSM_Transition_t SubInitRows[] = {
+    {ES_INIT, HSM_ANY_PARAM, SubDrive, NULL, NULL},
+};
+static const HSM_Transition_t SubDriveRows[] = {
+    {ES_TIMEOUT, HSM_ANY_PARAM, SubTurn, NULL, NULL},
+    {BEACON_FOUND_EVENT, HSM_ANY_PARAM, SubBack, NULL, NULL},
+};
+static const HSM_Transition_t SubTurnRows[] = {
+    {ES_TIMEOUT, HSM_ANY_PARAM, SubDrive, NULL, NULL},
+    {NO_BEACON_EVENT, HSM_ANY_PARAM, SubBack, NULL, NULL},
+};
+static const HSM_Transition_t SubBackRows[] = {
+    {ES_TIMEOUT, HSM_ANY_PARAM, SubDrive, NULL, NULL},
+};
+
+// everything the sub-HSM does anything with, its parents want these as well
+#define SUB_EVENTS (HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BEACON_FOUND_EVENT) | \
+    HSM_EVENT(NO_BEACON_EVENT))
+#define BENCH_INTEREST(filter, events) ((filter) ? (events) : HSM_ALL_EVENTS)
+
+#define BENCH_SUB_TABLE(filter) { \
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(SubInitRows), HSM_NO_STATE, 0, \
+        BENCH_INTEREST(filter, HSM_EVENT(ES_INIT)), NULL}, \
+    {EnterSubDrive, NULL, NULL, NULL, HSM_TRANSITIONS(SubDriveRows), HSM_NO_STATE, 0, \
+        BENCH_INTEREST(filter, HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BEACON_FOUND_EVENT)), NULL}, \
+    {EnterSubTurn, NULL, NULL, NULL, HSM_TRANSITIONS(SubTurnRows), HSM_NO_STATE, 0, \
+        BENCH_INTEREST(filter, HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(NO_BEACON_EVENT)), NULL}, \
+    {EnterSubBack, NULL, NULL, NULL, HSM_TRANSITIONS(SubBackRows), HSM_NO_STATE, 0, \
+        BENCH_INTEREST(filter, HSM_EVENT(ES_TIMEOUT)), NULL}, \
+}
+
+static const HSM_State_t SubStates[SUB_STATES] = BENCH_SUB_TABLE(FALSE);
+static const HSM_State_t SubInterestStates[SUB_STATES] = BENCH_SUB_TABLE(TRUE);
+
+static HSM_RowIndex_t TableSubRows[SUB_STATES], HistorySubRows[SUB_STATES],
+        InterestSubRows[SUB_STATES];
+static const HSM_Machine_t TableSub = {
+    SubStates, SUB_STATES, &TableSubState, NULL, NULL, NULL, TableSubRows
+};
+static const HSM_Machine_t HistorySub = {
+    SubStates, SUB_STATES, &HistorySubState, NULL, NULL, NULL, HistorySubRows
+};
+static const HSM_Machine_t InterestSub = {
+    SubInterestStates, SUB_STATES, &InterestSubState, NULL, &SubIgnored, NULL, InterestSubRows
+};
+
+// a converted sub-HSM's Init, one per machine, the machine above runs its tables
+#define BENCH_SUB_INIT(machine) \
+    static uint8_t __attribute__((noinline)) Init##machine(void) \
+    { \
+        subStarts++; \
+        *machine.current = SubInit; \
+        return HSM_Run(&machine, INIT_EVENT).EventType == ES_NO_EVENT; \
+    }
+
+BENCH_SUB_INIT(TableSub)
+BENCH_SUB_INIT(HistorySub)
+BENCH_SUB_INIT(InterestSub)
+
+static uint8_t BenchBumpersReleased(const ES_Event *ThisEvent)
+{
+    return bumpers == 0;
+}
+
+static const HSM_Transition_t InitRows[] = {
+    {ES_INIT, HSM_ANY_PARAM, BenchBeacon, NULL, NULL},
+};
+static const HSM_Transition_t BeaconRows[] = {
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, BenchWall, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, BenchWall, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, BenchWall, NULL, NULL},
+};
+static const HSM_Transition_t WallRows[] = {
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, BenchBounds, NULL, NULL},
+    {CORRECT_WALL_DETECTED_EVENT, HSM_ANY_PARAM, BenchParallel, NULL, NULL},
+};
+static const HSM_Transition_t BoundsRows[] = {
+    {WALL_DETECTED_EVENT, HSM_ANY_PARAM, BenchWall, NULL, NULL},
+};
+static const HSM_Transition_t ParallelRows[] = {
+    {GOT_PARALLEL_EVENT, HSM_ANY_PARAM, BenchHole, NULL, NULL},
+    {HSM_ANY_EVENT, HSM_ANY_PARAM, BenchHole, BenchBumpersReleased, NULL},
+};
+static const HSM_Transition_t HoleRows[] = {
+    {CORRECT_HOLE_FOUND_EVENT, HSM_ANY_PARAM, BenchDispense, NULL, NULL},
+};
+static const HSM_Transition_t DispenseRows[] = {
+    {BALL_DISPENSED_EVENT, HSM_ANY_PARAM, BenchBeacon, NULL, NULL},
+};
+
+// the events ProjectHSM's states and their sub-HSMs want, and the bench's sub
+#define BEACON_EVENTS (SUB_EVENTS | HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | \
+    HSM_EVENT(FC_BUMP_EVENT) | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | \
+    HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT))
+#define WALL_EVENTS (SUB_EVENTS | HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | \
+    HSM_EVENT(FC_BUMP_EVENT) | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | \
+    HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(CORRECT_WALL_DETECTED_EVENT))
+#define BOUNDS_EVENTS (SUB_EVENTS | HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | \
+    HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FL_TAPE_SEE_WHITE_EVENT) | \
+    HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FR_TAPE_SEE_WHITE_EVENT) | \
+    HSM_EVENT(WALL_DETECTED_EVENT))
+#define HOLE_EVENTS (SUB_EVENTS | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | \
+    HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(L_BALL_TAPE_SEE_BLACK_EVENT) | \
+    HSM_EVENT(L_BALL_TAPE_SEE_WHITE_EVENT) | HSM_EVENT(CORRECT_HOLE_FOUND_EVENT))
+#define DISPENSE_EVENTS (SUB_EVENTS | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT) | \
+    HSM_EVENT(BALL_DISPENSED_EVENT) | HSM_EVENT(STEPPER_DONE_EVENT))
+
+#define BENCH_STATE_TABLE(flags, filter, sub, subInit) { \
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitRows), HSM_NO_STATE, 0, \
+        BENCH_INTEREST(filter, HSM_EVENT(ES_INIT)), NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(BeaconRows), HSM_NO_STATE, flags, \
+        BENCH_INTEREST(filter, BEACON_EVENTS), NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(WallRows), HSM_NO_STATE, flags, \
+        BENCH_INTEREST(filter, WALL_EVENTS), NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(BoundsRows), HSM_NO_STATE, flags, \
+        BENCH_INTEREST(filter, BOUNDS_EVENTS), NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(ParallelRows), HSM_NO_STATE, flags, \
+        HSM_ALL_EVENTS, NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(HoleRows), HSM_NO_STATE, flags, \
+        BENCH_INTEREST(filter, HOLE_EVENTS), NULL}, \
+    {NULL, NULL, sub, subInit, HSM_TRANSITIONS(DispenseRows), HSM_NO_STATE, flags, \
+        BENCH_INTEREST(filter, DISPENSE_EVENTS), NULL}, \
+}
+
+// the interest machine restarts its sub-HSMs like the switch does, so the two
+// can be compared down to the sub-state
+static const HSM_State_t BenchStates[BENCH_STATES] =
+        BENCH_STATE_TABLE(0, FALSE, &TableSub, InitTableSub);
+static const HSM_State_t BenchHistoryStates[BENCH_STATES] =
+        BENCH_STATE_TABLE(HSM_HISTORY, FALSE, &HistorySub, InitHistorySub);
+static const HSM_State_t BenchInterestStates[BENCH_STATES] =
+        BENCH_STATE_TABLE(0, TRUE, &InterestSub, InitInterestSub);
+
+static HSM_RowIndex_t TableRows[BENCH_STATES], HistoryRows[BENCH_STATES],
+        InterestRows[BENCH_STATES];
+static const HSM_Machine_t BenchMachine = {
+    BenchStates, BENCH_STATES, &TableState, NULL, NULL, NULL, TableRows
+};
+static const HSM_Machine_t BenchHistoryMachine = {
+    BenchHistoryStates, BENCH_STATES, &HistoryState, &HistoryStarted, NULL, NULL, HistoryRows
+};
+static const HSM_Machine_t BenchInterestMachine = {
+    BenchInterestStates, BENCH_STATES, &InterestState, &InterestStarted, &InterestIgnored, NULL,
+    InterestRows
+};
+
+// a lap of the course, mostly sensor edges nobody wants
+static const ES_Event BenchStream[] = {
+    {BEACON_FOUND_EVENT, 0}, {FL_TAPE_SEE_WHITE_EVENT, 0}, {NO_BEACON_EVENT, 0}, {ES_TIMEOUT, 1},
+    {FR_BUMP_EVENT, 0}, {NO_FR_BUMP_EVENT, 0}, {TRACK_WIRE_FOUND_EVENT, 0}, {ES_TIMEOUT, 1},
+    {FL_TAPE_SEE_BLACK_EVENT, 0}, {FL_TAPE_SEE_WHITE_EVENT, 0}, {BC_TAPE_SEE_BLACK_EVENT, 0},
+    {WALL_DETECTED_EVENT, 0}, {NO_TRACK_WIRE_EVENT, 0}, {FL_BUMP_EVENT, 0}, {ES_TIMEOUT, 1},
+    {CORRECT_WALL_DETECTED_EVENT, 0}, {FC_BUMP_EVENT, 0}, {ES_TIMEOUT, 1}, {GOT_PARALLEL_EVENT, 0},
+    {HOLE_FOUND_EVENT, 0}, {BEACON_FOUND_EVENT, 0}, {CORRECT_HOLE_FOUND_EVENT, 0},
+    {STEPPER_DONE_EVENT, 0}, {ES_TIMEOUT, 1}, {BC_TAPE_SEE_WHITE_EVENT, 0}, {NO_BEACON_EVENT, 0},
+    {BALL_DISPENSED_EVENT, 0}, {NO_FL_BUMP_EVENT, 0},
+};
+#define BENCH_STREAM_LENGTH (sizeof(BenchStream) / sizeof(BenchStream[0]))
+
+/**
+ * @Function Bench(ES_Event(*run)(ES_Event ThisEvent), const uint8_t *state, const char *name)
+ * @return number of top level transitions, counted as changes of *state
+ * @brief Times BENCH_EVENTS events through run and prints the dispatch rate,
+ *        the sub-HSM starts at start up and per transition, and the drive
+ *        commands. The switch starts every state's sub-HSM at start up, and
+ *        sends ES_ENTRY to a sub-HSM it is about to restart, which is where
+ *        its extra drive commands come from.
+ */
+static uint32_t Bench(ES_Event(*run)(ES_Event ThisEvent), const uint8_t *state, const char *name)
+{
+    uint32_t start, ticks;
+    uint32_t i, transitions = 1, initStarts;
+    uint8_t last;
+
+    subStarts = driveCalls = 0;
+    run(INIT_EVENT);
+    initStarts = subStarts;
+    last = *state;
+    start = _CP0_GET_COUNT();
+    for (i = 0; i < BENCH_EVENTS; i++) {
+        run(BenchStream[i % BENCH_STREAM_LENGTH]);
+        if (*state != last) {
+            last = *state;
+            transitions++;
+        }
+    }
+    ticks = _CP0_GET_COUNT() - start;
+    printf("\n%-8s %9lu events/s, sub-HSM starts: start up %lu, %lu.%02lu per transition, %lu drives",
+            name, (unsigned long) ((BENCH_EVENTS * CORE_TICKS_PER_SEC) / ticks),
+            (unsigned long) initStarts, (unsigned long) (subStarts / transitions),
+            (unsigned long) ((subStarts * 100ULL / transitions) % 100), (unsigned long) driveCalls);
+    return transitions;
+}
+
+static ES_Event RunTableHSM(ES_Event ThisEvent)
+{
+    return HSM_Run(&BenchMachine, ThisEvent);
+}
+
+static ES_Event RunHistoryHSM(ES_Event ThisEvent)
+{
+    return HSM_Run(&BenchHistoryMachine, ThisEvent);
+}
+
+static ES_Event RunInterestHSM(ES_Event ThisEvent)
+{
+    return HSM_Run(&BenchInterestMachine, ThisEvent);
+}
+
+int main(void)
+{
+    uint32_t switchTransitions, tableTransitions, historyTransitions, interestTransitions;
+
+    BOARD_Init();
+    printf("\nHSM_Engine dispatch benchmark, %lu events", (unsigned long) BENCH_EVENTS);
+    printf("\nVerify: %s", ((HSM_Verify(&BenchMachine) == SUCCESS) &&
+            (HSM_Verify(&BenchHistoryMachine) == SUCCESS) &&
+            (HSM_Verify(&BenchInterestMachine) == SUCCESS) && (HSM_Verify(&TableSub) == SUCCESS) &&
+            (HSM_Verify(&HistorySub) == SUCCESS) && (HSM_Verify(&InterestSub) == SUCCESS)) ?
+            "passed" : "FAILED");
+    switchTransitions = Bench(RunSwitchHSM, &SwitchState, "switch");
+    switchDrive = lastDrive;
+    tableTransitions = Bench(RunTableHSM, &TableState, "table");
+    tableDrive = lastDrive;
+    historyTransitions = Bench(RunHistoryHSM, &HistoryState, "history");
+    interestTransitions = Bench(RunInterestHSM, &InterestState, "interest");
+    printf("\ninterest masks dropped %lu of %lu events at the top and %lu in the sub-HSM",
+            (unsigned long) InterestIgnored, (unsigned long) BENCH_EVENTS,
+            (unsigned long) SubIgnored);
+    printf("\nfinal states %u, %u, %u and %u, %s", SwitchState, TableState, HistoryState,
+            InterestState, ((SwitchState == TableState) && (TableState == HistoryState) &&
+            (HistoryState == InterestState) && (switchTransitions == tableTransitions) &&
+            (tableTransitions == historyTransitions) && (historyTransitions == interestTransitions)) ?
+            "matching" : "DIFFERENT");
+    printf("\nsub-states %u, %u and %u driving at %d, %d and %d, %s\n", SwitchSubState,
+            TableSubState, InterestSubState, switchDrive, tableDrive, lastDrive,
+            ((SwitchSubState == TableSubState) && (TableSubState == InterestSubState) &&
+            (switchDrive == tableDrive) && (tableDrive == lastDrive)) ? "matching" : "DIFFERENT");
+    TEST_HARNESS_END();
+    return 0;
+}
+
+#endif // HSM_ENGINE_TEST
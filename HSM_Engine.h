@@ -0,0 +1,195 @@
+/*
+ * File:   HSM_Engine.h
+ *
+ * Table driven runtime for the ES_Framework state machines. A machine is a const
+ * array of state descriptors instead of a switch: each state has an entry and
+ * an exit action, an optional sub-HSM, a parent, and a transition table sorted
+ * by event type. A row index built by HSM_Verify takes each event straight to
+ * the row for it.
+ *
+ * It keeps the template's behaviour so converted and switch machines mix freely:
+ *   - state 0 is the initial pseudo-state, its ES_INIT transition leaves it
+ *   - a state's sub-HSM sees every event first, ES_EXIT included, and the
+ *     tables are searched with what it hands back
+ *   - a converted sub-HSM still has a Run function for switch machines above
+ *     it, a converted machine above it dispatches to its tables directly
+ *   - transition actions run before the exit and entry, like the code in a case
+ *     ahead of the recursive EXIT and ENTRY calls
+ *   - a transition with a target consumes the event, an internal one (target
+ *     HSM_NO_TARGET) passes on whatever its action leaves in the event
+ *   - Run(ES_ENTRY) and Run(ES_EXIT) from the parent machine enter and exit
+ *     the current state
+ *
+ * Sub-HSMs are started lazily. Entering a state runs its entry action and then
+ * its sub-HSM's Init function, which takes the sub-HSM from its initial
+ * pseudo-state into its first state. A state flagged HSM_HISTORY only does that
+ * the first time; after that, entering it sends the sub-HSM ES_ENTRY, and the
+ * sub-HSM resumes the sub-state it was in when it was last exited.
+ *
+ * Each state has an interest mask of the event types it lets through, and any
+ * other event is handed straight back with one AND, without running the sub-HSM
+ * or searching a table. HSM_Verify narrows the mask to the events the state's
+ * rows and its parents' rows take and the ones its sub-HSM's states want, so a
+ * state with a sub-HSM can leave it at HSM_ALL_EVENTS. A narrower mask has to
+ * cover every row of the state's table and its parents' tables, HSM_Verify
+ * checks that. Event types have to stay below 64 to fit the mask, and ES_ENTRY
+ * and ES_EXIT are never in it. A sub-HSM only gets the events its own current
+ * state wants.
+ *
+ * Every machine keeps a row index for HSM_Verify to fill in, a byte per state
+ * and event type saying which table up from the state has the first row for
+ * the event, and where in it, the events the state and its sub-HSM take, and a
+ * byte saying whether entering or leaving the state takes more than its entry
+ * action. What the sub-HSM hands back is looked up there, events no table has a
+ * row for go straight back, a plain row of the state's own goes straight to its
+ * target, and only a guarded row, one with a param or an action, or one further
+ * up has the rows after it searched. The tables are const, so HSM_Verify only checks and
+ * indexes them the first time it is called.
+ *
+ * A state can own a TimerWheel timer, shared with other states or not. Leaving
+ * the state stops it, and its timeouts are checked against the timer's current
+ * generation before anything else sees them: stale ones are consumed, current
+ * ones carry on with the timer's name as EventParam for the tables to match.
+ * Owned timers are looked for from the current state up, like the tables, and
+ * HSM_Verify checks every ES_TIMEOUT row for a timer name has its timer there.
+ *
+ * Events not found in the current state's table are looked up in its parent's,
+ * and so on up. HSM_ANY_EVENT rows sort last and match anything, including an
+ * event the sub-HSM consumed, which covers the template's unconditional checks
+ * at the bottom of a case. Those checks also ran on the ES_ENTRY into the state,
+ * so a state's own catch-alls are tried with ES_ENTRY once it has been entered.
+ * Targets and states with a sub-HSM should be leaves.
+ *
+ * A machine can keep StateStats, the engine counts its transitions and stops
+ * and starts the clock when the machine above exits and enters it.
+ *
+ * HSM_ENGINE_TEST (in the .c file) conditionally compiles a dispatch benchmark
+ * of the engine against the same machine written as a switch.
+ */
+
+#ifndef HSM_ENGINE_H
+#define HSM_ENGINE_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "TimerWheel.h"
+#include "StateStats.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#define HSM_NO_STATE 0xFF               // parent of a top level state
+#define HSM_NO_TARGET HSM_NO_STATE      // internal transition, no exit or entry
+#define HSM_ANY_EVENT 0xFF              // matches every event, sorts last
+#define HSM_ANY_PARAM 0xFFFF            // matches every EventParam
+
+// interest masks, HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT)
+#define HSM_EVENT(event) ((HSM_Interest_t) 1 << (event))
+#define HSM_ALL_EVENTS (~(HSM_EVENT(ES_ENTRY) | HSM_EVENT(ES_EXIT)))
+
+// state flags
+#define HSM_HISTORY 0x01                // resume the sub-HSM instead of restarting it
+
+// states that can keep history, one bit each in the started mask
+#define HSM_MAX_HISTORY_STATES 32
+
+// deepest parent chain the engine will walk
+#define HSM_MAX_DEPTH 4
+
+// event types the row index covers, every one ES_Configure.h names
+#define HSM_EVENT_TYPES (sizeof(EventNames) / sizeof(EventNames[0]))
+
+// a row index entry, how many parents up and the row number plus one, 0 for none,
+// flagged plain when it is the state's own row and takes the event unconditionally
+#define HSM_INDEX_ROW_BITS 5
+#define HSM_INDEX_ROW_MASK ((1 << HSM_INDEX_ROW_BITS) - 1)
+#define HSM_INDEX_PLAIN (1 << HSM_INDEX_ROW_BITS)
+#define HSM_INDEX_UP_SHIFT (HSM_INDEX_ROW_BITS + 1)
+
+// fills in a state's transitions field from a table, or leaves it empty
+#define HSM_TRANSITIONS(table) table, (sizeof(table) / sizeof((table)[0]))
+#define HSM_NO_TRANSITIONS NULL, 0
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef uint64_t HSM_Interest_t;
+
+typedef struct {
+    uint8_t event; // ES_EventTyp_t, the table is sorted on this
+    uint16_t param; // EventParam that has to match, or HSM_ANY_PARAM
+    uint8_t target; // next state, or HSM_NO_TARGET
+    uint8_t (*guard)(const ES_Event *event); // taken only if TRUE, NULL for always
+    void (*action)(ES_Event *event); // may rewrite the event, NULL for none
+} HSM_Transition_t;
+
+typedef struct {
+    void (*entry)(void);
+    void (*exit)(void);
+    const struct HSM_Machine *sub; // sub-HSM, or NULL
+    uint8_t (*subInit)(void); // sub-HSM init function, or NULL if it needs none
+    const HSM_Transition_t *transitions;
+    uint8_t numTransitions;
+    uint8_t parent; // HSM_NO_STATE at the top
+    uint8_t flags;
+    HSM_Interest_t interest; // events the state handles, HSM_ALL_EVENTS for all
+    TimerWheel_Timer_t *timer; // stopped on exit, NULL for none
+} HSM_State_t;
+
+typedef struct {
+    HSM_Interest_t wants; // events the tables or the sub-HSM take, within the interest mask
+    uint8_t first[HSM_EVENT_TYPES]; // where the search for each event type starts
+    uint8_t work; // what entering and leaving the state takes, for the engine
+} HSM_RowIndex_t;
+
+typedef struct HSM_Machine {
+    const HSM_State_t *states;
+    uint8_t numStates;
+    uint8_t *current; // the machine's CurrentState
+    uint32_t *started; // bit per state whose sub-HSM has run, NULL without history
+    uint32_t *ignored; // counts events dropped by the interest masks, or NULL
+    StateStats_t *stats; // residency and transition counts, STATE_STATS_OF or NULL
+    HSM_RowIndex_t *rows; // numStates of them for HSM_Verify to fill in
+} HSM_Machine_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function HSM_Run(const HSM_Machine_t *machine, ES_Event ThisEvent)
+ * @param machine - the machine to run
+ * @param ThisEvent - the event (type and param) to be responded to
+ * @return the event passed back up, ES_NO_EVENT if consumed
+ * @brief Dispatches one event: the sub-HSM first, then the transition tables
+ *        from the current state up through its parents. Does the actions, exits
+ *        and entries of the transition taken, if any.
+ */
+ES_Event HSM_Run(const HSM_Machine_t *machine, ES_Event ThisEvent);
+
+/**
+ * @Function HSM_Wants(const HSM_Machine_t *machine, ES_EventTyp_t event)
+ * @param machine - the machine to ask
+ * @param event - an event type
+ * @return TRUE if the current state would do anything with the event
+ * @brief Lets a post function drop events before they take up a queue slot,
+ *        only safe when nothing is queued ahead that could change the state.
+ */
+uint8_t HSM_Wants(const HSM_Machine_t *machine, ES_EventTyp_t event);
+
+/**
+ * @Function HSM_Verify(const HSM_Machine_t *machine)
+ * @param machine - the machine to check
+ * @return SUCCESS or ERROR
+ * @brief Checks that every table is sorted and every target and parent exists,
+ *        that states with HSM_HISTORY have somewhere to keep it, that every
+ *        state's interest mask covers the events in its tables, and that a
+ *        state with a row for a TimerWheel timer owns that timer. Fills in the
+ *        machine's row index, so it has to run before HSM_Run, and no table
+ *        can have more than HSM_INDEX_ROW_MASK rows. Only the first call does
+ *        any of that, later ones return SUCCESS straight away.
+ */
+int8_t HSM_Verify(const HSM_Machine_t *machine);
+
+#endif /* HSM_ENGINE_H */
@@ -0,0 +1,263 @@
+/*
+ * File:   HW_Regs.c
+ *
+ * Host side of the register access layer, see HW_Regs.h. Nothing in here is
+ * built for the PIC32, the macros go straight to the SFRs there.
+ */
+
+#include <BOARD.h>
+#include <HW_Regs.h>
+
+#ifndef __PIC32MX__
+
+#include <string.h>
+#include <time.h>
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define HW_REGS_TEST
+
+#define HW_NUM_REGS (HW_NUM_IDS / 4)
+#define HW_NUM_PORT_REGS (3 * HW_NUM_PORTS)
+
+// the low two bits of an id pick the register itself or its CLR, SET or INV
+#define HW_OP_MASK 3
+#define HW_OP_WRITE 0
+#define HW_OP_CLR 1
+#define HW_OP_SET 2
+#define HW_OP_INV 3
+
+// the ports come first, TRIS, PORT then LAT, so a port's registers sit at
+// three times its index
+#define HW_PORT_COUNT(x) + 1
+#define HW_NUM_PORTS (0 HW_PORT_LIST(HW_PORT_COUNT))
+#define HW_TRIS_REG 0
+#define HW_PORT_REG 1
+#define HW_LAT_REG 2
+
+#define CORE_TICKS_PER_SEC 40000000ULL
+
+/*******************************************************************************
+ * PRIVATE VARIABLES                                                           *
+ ******************************************************************************/
+
+static uint32_t regs[HW_NUM_REGS];
+static uint32_t inputs[HW_NUM_PORTS];
+static HW_Trace_t trace[HW_TRACE_SIZE];
+static uint32_t writeCount;
+
+#define HW_SFR_NAMES(sfr) #sfr, #sfr "CLR", #sfr "SET", #sfr "INV",
+#define HW_PORT_NAMES(x) HW_SFR_NAMES(TRIS##x) HW_SFR_NAMES(PORT##x) HW_SFR_NAMES(LAT##x)
+
+static const char * const regNames[HW_NUM_IDS] = {
+    HW_PORT_LIST(HW_PORT_NAMES)
+    HW_SFR_LIST(HW_SFR_NAMES)
+};
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint8_t StorageOf(HW_Reg_t reg);
+static void StoreReg(HW_Reg_t reg, uint32_t value, uint32_t result);
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void HW_RegsReset(void)
+{
+    uint8_t i;
+
+    memset(regs, 0, sizeof(regs));
+    memset(inputs, 0, sizeof(inputs));
+    for (i = 0; i < HW_NUM_PORTS; i++) {
+        regs[3 * i + HW_TRIS_REG] = 0xFFFF;
+    }
+    writeCount = 0;
+}
+
+uint32_t HW_RegsRead(HW_Reg_t reg)
+{
+    uint8_t r = reg / 4;
+    uint8_t port = r / 3;
+
+    if ((r < HW_NUM_PORT_REGS) && (r % 3 == HW_PORT_REG)) {
+        uint32_t tris = regs[3 * port + HW_TRIS_REG];
+        return (regs[3 * port + HW_LAT_REG] & ~tris) | (inputs[port] & tris);
+    }
+    return regs[r];
+}
+
+void HW_RegsWrite(HW_Reg_t reg, uint32_t value)
+{
+    uint8_t r = StorageOf(reg);
+    uint32_t result;
+
+    switch (reg & HW_OP_MASK) {
+    case HW_OP_CLR:
+        result = regs[r] & ~value;
+        break;
+    case HW_OP_SET:
+        result = regs[r] | value;
+        break;
+    case HW_OP_INV:
+        result = regs[r] ^ value;
+        break;
+    default:
+        result = value;
+        break;
+    }
+    regs[r] = result;
+    StoreReg(reg, value, result);
+}
+
+void HW_RegsWriteField(HW_Reg_t reg, uint8_t position, uint32_t mask, uint32_t value)
+{
+    uint8_t r = StorageOf(reg);
+
+    value = (value << position) & mask;
+    regs[r] = (regs[r] & ~mask) | value;
+    StoreReg(reg & ~HW_OP_MASK, value, regs[r]);
+}
+
+void HW_RegsSetInputs(HW_Reg_t port, uint32_t levels)
+{
+    inputs[(port / 4) / 3] = levels;
+}
+
+uint32_t HW_RegsWriteCount(void)
+{
+    return writeCount;
+}
+
+int8_t HW_RegsGetTrace(uint32_t seq, HW_Trace_t *entry)
+{
+    if ((seq >= writeCount) || (writeCount - seq > HW_TRACE_SIZE)) {
+        return ERROR;
+    }
+    *entry = trace[seq % HW_TRACE_SIZE];
+    return SUCCESS;
+}
+
+const char *HW_RegsName(HW_Reg_t reg)
+{
+    if (reg >= HW_NUM_IDS) {
+        return "?";
+    }
+    return regNames[reg];
+}
+
+uint32_t HW_RegsCoreTicks(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) (now.tv_sec * CORE_TICKS_PER_SEC
+        + (now.tv_nsec * CORE_TICKS_PER_SEC) / 1000000000ULL);
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+// where a write to reg ends up, writes to a PORT go to its latch
+static uint8_t StorageOf(HW_Reg_t reg)
+{
+    uint8_t r = reg / 4;
+
+    if ((r < HW_NUM_PORT_REGS) && (r % 3 == HW_PORT_REG)) {
+        return r + 1;
+    }
+    return r;
+}
+
+static void StoreReg(HW_Reg_t reg, uint32_t value, uint32_t result)
+{
+    HW_Trace_t *t = &trace[writeCount % HW_TRACE_SIZE];
+
+    t->seq = writeCount;
+    t->reg = reg;
+    t->value = value;
+    t->result = result;
+    writeCount++;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef HW_REGS_TEST
+
+#include <stdio.h>
+
+static uint8_t errors;
+
+static void Check(const char *what, uint32_t got, uint32_t want)
+{
+    if (got != want) {
+        printf("\n%s: got 0x%04X, wanted 0x%04X", what, got, want);
+        errors++;
+    }
+}
+
+int main(void)
+{
+    HW_Trace_t entry;
+    uint32_t seq;
+
+    printf("\nHW_Regs host register file test harness");
+    HW_RegsReset();
+    Check("TRISD after reset", HW_SFR_READ(TRISD), 0xFFFF);
+    Check("LATD after reset", HW_SFR_READ(LATD), 0);
+
+    // CLR, SET and INV land on their register
+    HW_SFR_WRITE(LATDSET, BIT_3 | BIT_5);
+    HW_SFR_WRITE(LATDINV, BIT_5 | BIT_6);
+    HW_SFR_WRITE(LATDCLR, BIT_3);
+    Check("LATD after SET/INV/CLR", HW_SFR_READ(LATD), BIT_6);
+    Check("LATDSET reads LATD", HW_READ(HW_REG(LATDSET)), BIT_6);
+
+    // outputs read back the latch, inputs the outside world
+    HW_SFR_WRITE(TRISDCLR, BIT_6 | BIT_7);
+    HW_RegsSetInputs(HW_REG(PORTD), BIT_0 | BIT_7);
+    Check("PORTD", HW_SFR_READ(PORTD), BIT_0 | BIT_6);
+    HW_SFR_WRITE(PORTD, BIT_7);
+    Check("LATD after PORTD write", HW_SFR_READ(LATD), BIT_7);
+
+    // pins and fields are read-modify-writes
+    HW_PIN_WRITE(HW_PIN(LATE, 3), 1);
+    HW_PIN_WRITE(HW_PIN(LATE, 4), 2); // cut to one bit like a bitfield
+    Check("LATE pins", HW_SFR_READ(LATE), BIT_3);
+    Check("LATE3", HW_PIN_READ(HW_PIN(LATE, 3)), 1);
+    HW_SFR_WRITE(T3CON, 0);
+    HW_FIELD_WRITE(T3CON, TCKPS, 5);
+    HW_FIELD_WRITE(T3CON, ON, 1);
+    Check("T3CON", HW_SFR_READ(T3CON), 0x8050);
+    Check("T3CON TCKPS", HW_FIELD_READ(T3CON, TCKPS), 5);
+
+    // the trace has every write in order
+    Check("write count", HW_RegsWriteCount(), 10);
+    printf("\nTrace:");
+    for (seq = 0; HW_RegsGetTrace(seq, &entry) == SUCCESS; seq++) {
+        printf("\n%3u %-8s 0x%04X -> 0x%04X", entry.seq, HW_RegsName(entry.reg),
+            entry.value, entry.result);
+    }
+    HW_RegsGetTrace(2, &entry);
+    Check("third write", entry.reg, HW_REG(LATDCLR));
+
+    // the ring keeps the newest HW_TRACE_SIZE writes
+    for (seq = 0; seq < HW_TRACE_SIZE; seq++) {
+        HW_SFR_WRITE(TMR3, seq);
+    }
+    Check("pushed out", HW_RegsGetTrace(HW_RegsWriteCount() - HW_TRACE_SIZE - 1, &entry), (uint32_t) ERROR);
+    Check("newest kept", HW_RegsGetTrace(HW_RegsWriteCount() - 1, &entry), SUCCESS);
+    Check("newest value", entry.value, HW_TRACE_SIZE - 1);
+
+    printf(errors ? "\n%u checks FAILED\n" : "\nall checks passed\n", errors);
+    return errors;
+}
+
+#endif // HW_REGS_TEST
+
+#endif // __PIC32MX__
@@ -0,0 +1,246 @@
+/*
+ * File:   HW_Regs.h
+ *
+ * Register access layer for the drivers that touch the PIC32 directly (IO_Ports,
+ * Bot and Stepper). Built with XC32 every macro below is the same SFR access the
+ * drivers used to spell out by name, so it costs nothing on the robot. Built
+ * anywhere else the registers live in an in-memory register file and every
+ * write is traced, so the driver code runs unchanged in host tests and
+ * benchmarks.
+ *
+ * There are three ways to get at a register:
+ *   Registers: HW_SFR_READ(PORTD), HW_SFR_WRITE(LATDSET, BIT_3), or through a
+ *              handle when it has to go in a table, HW_REG(LATDSET) with
+ *              HW_READ(reg) and HW_WRITE(reg, value).
+ *   Pins:      HW_PIN(LATD, 3) names one bit, HW_PIN_READ(pin) and
+ *              HW_PIN_WRITE(pin, value) read and write it. Writing a pin is a
+ *              read-modify-write of the whole register, same as a bitfield.
+ *   Fields:    the xc.h bitfield names, HW_FIELD_WRITE(T3CON, TCKPS, 3) and
+ *              HW_FIELD_READ(T3CON, TCKPS).
+ *
+ * On the host the CLR, SET and INV registers act as they do on the PIC32, a
+ * PORT register reads back the LAT bits on outputs and the HW_RegsSetInputs()
+ * levels on inputs, and writing a PORT register writes its LAT. Timers do not
+ * count on their own, tests drive them by writing TMR and calling the ISR. Only
+ * the registers in HW_PORT_LIST and HW_SFR_LIST exist on the host, add to them
+ * as drivers need more.
+ *
+ * HW_REGS_TEST (in the .c file) conditionally compiles the test harness for the
+ * host register file.
+ */
+
+#ifndef HW_REGS_H
+#define HW_REGS_H
+
+#ifdef __PIC32MX__
+
+#include <xc.h>
+#include <peripheral/ports.h>
+
+/*******************************************************************************
+ * PIC32: DIRECT SFR ACCESS                                                    *
+ ******************************************************************************/
+
+typedef volatile unsigned int * HW_Reg_t;
+
+#define HW_REG(sfr) (&(sfr))
+#define HW_READ(reg) (*(reg))
+#define HW_WRITE(reg, value) (*(reg) = (value))
+
+#define HW_SFR_READ(sfr) (sfr)
+#define HW_SFR_WRITE(sfr, value) ((sfr) = (value))
+
+#define HW_PIN_READ_(sfr, bit) (((sfr) >> (bit)) & 1)
+#define HW_PIN_WRITE_(sfr, bit, value) \
+    ((sfr) = ((sfr) & ~(1u << (bit))) | (((value) & 1u) << (bit)))
+
+#define HW_FIELD_READ(sfr, field) (sfr##bits.field)
+#define HW_FIELD_WRITE(sfr, field, value) (sfr##bits.field = (value))
+
+#else
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * HOST: REGISTER FILE                                                         *
+ ******************************************************************************/
+
+// GPIO ports, each one a TRIS, PORT and LAT register in that order
+#define HW_PORT_LIST(X) X(B) X(D) X(E) X(F) X(G)
+
+// everything else the drivers touch
+#define HW_SFR_LIST(X) X(T2CON) X(TMR2) X(PR2) X(T3CON) X(TMR3) X(PR3) \
+    X(IFS0) X(IEC0) X(IPC2) X(IPC3)
+
+// like the PIC32 address map, every register takes four ids: itself, then its
+// CLR, SET and INV registers
+#define HW_SFR_IDS(sfr) HW_ID_##sfr, HW_ID_##sfr##CLR, HW_ID_##sfr##SET, HW_ID_##sfr##INV,
+#define HW_PORT_IDS(x) HW_SFR_IDS(TRIS##x) HW_SFR_IDS(PORT##x) HW_SFR_IDS(LAT##x)
+
+enum {
+    HW_PORT_LIST(HW_PORT_IDS)
+    HW_SFR_LIST(HW_SFR_IDS)
+    HW_NUM_IDS
+};
+
+typedef uint8_t HW_Reg_t;
+
+#define HW_REG(sfr) HW_ID_##sfr
+#define HW_READ(reg) HW_RegsRead(reg)
+#define HW_WRITE(reg, value) HW_RegsWrite(reg, value)
+
+#define HW_SFR_READ(sfr) HW_RegsRead(HW_ID_##sfr)
+#define HW_SFR_WRITE(sfr, value) HW_RegsWrite(HW_ID_##sfr, value)
+
+#define HW_PIN_READ_(sfr, bit) ((HW_RegsRead(HW_ID_##sfr) >> (bit)) & 1)
+#define HW_PIN_WRITE_(sfr, bit, value) HW_RegsWriteField(HW_ID_##sfr, bit, 1UL << (bit), value)
+
+#define HW_FIELD_READ(sfr, field) \
+    ((HW_RegsRead(HW_ID_##sfr) & _##sfr##_##field##_MASK) >> _##sfr##_##field##_POSITION)
+#define HW_FIELD_WRITE(sfr, field, value) \
+    HW_RegsWriteField(HW_ID_##sfr, _##sfr##_##field##_POSITION, _##sfr##_##field##_MASK, value)
+
+// the xc.h field positions and masks the drivers use
+#define _T2CON_ON_POSITION 15
+#define _T2CON_ON_MASK 0x00008000
+#define _T2CON_TCKPS_POSITION 4
+#define _T2CON_TCKPS_MASK 0x00000070
+#define _T3CON_ON_POSITION 15
+#define _T3CON_ON_MASK 0x00008000
+#define _T3CON_TCKPS_POSITION 4
+#define _T3CON_TCKPS_MASK 0x00000070
+#define _IFS0_T2IF_POSITION 8
+#define _IFS0_T2IF_MASK 0x00000100
+#define _IEC0_T2IE_POSITION 8
+#define _IEC0_T2IE_MASK 0x00000100
+#define _IPC2_T2IS_POSITION 0
+#define _IPC2_T2IS_MASK 0x00000003
+#define _IPC2_T2IP_POSITION 2
+#define _IPC2_T2IP_MASK 0x0000001C
+#define _IFS0_T3IF_POSITION 12
+#define _IFS0_T3IF_MASK 0x00001000
+#define _IEC0_T3IE_POSITION 12
+#define _IEC0_T3IE_MASK 0x00001000
+#define _IPC3_T3IS_POSITION 0
+#define _IPC3_T3IS_MASK 0x00000003
+#define _IPC3_T3IP_POSITION 2
+#define _IPC3_T3IP_MASK 0x0000001C
+
+#ifndef BIT_0
+#define BIT_0 (1 << 0)
+#define BIT_1 (1 << 1)
+#define BIT_2 (1 << 2)
+#define BIT_3 (1 << 3)
+#define BIT_4 (1 << 4)
+#define BIT_5 (1 << 5)
+#define BIT_6 (1 << 6)
+#define BIT_7 (1 << 7)
+#define BIT_8 (1 << 8)
+#define BIT_9 (1 << 9)
+#define BIT_10 (1 << 10)
+#define BIT_11 (1 << 11)
+#define BIT_12 (1 << 12)
+#define BIT_13 (1 << 13)
+#define BIT_14 (1 << 14)
+#define BIT_15 (1 << 15)
+#endif
+
+// no interrupt controller on the host, tests call the handlers directly
+#define __ISR(vector, ipl)
+// the core timer counts at 40MHz, as on the Uno32
+#define _CP0_GET_COUNT() HW_RegsCoreTicks()
+
+#define HW_TRACE_SIZE 256
+
+typedef struct {
+    uint32_t seq; // number of the write since HW_RegsReset, from 0
+    HW_Reg_t reg; // as written, so a set shows up on the SET register
+    uint32_t value; // value written, for a pin or field the bits in place
+    uint32_t result; // register contents after the write
+} HW_Trace_t;
+
+/*******************************************************************************
+ * HOST FUNCTION PROTOTYPES                                                    *
+ ******************************************************************************/
+
+/**
+ * @Function HW_RegsReset(void)
+ * @param None.
+ * @return None.
+ * @brief  Puts the register file in its power on state, every TRIS all inputs
+ * and everything else zero, and empties the trace.
+ */
+void HW_RegsReset(void);
+
+/**
+ * @Function HW_RegsRead(HW_Reg_t reg)
+ * @param reg - HW_REG() of the register to read
+ * @return register contents, a CLR, SET or INV register reads as its register
+ */
+uint32_t HW_RegsRead(HW_Reg_t reg);
+
+/**
+ * @Function HW_RegsWrite(HW_Reg_t reg, uint32_t value)
+ * @param reg - HW_REG() of the register to write
+ * @param value - written as the PIC32 would for that register
+ * @return None.
+ * @brief  Applies the write and records it in the trace.
+ */
+void HW_RegsWrite(HW_Reg_t reg, uint32_t value);
+
+/**
+ * @Function HW_RegsWriteField(HW_Reg_t reg, uint8_t position, uint32_t mask, uint32_t value)
+ * @param reg - HW_REG() of the register holding the field
+ * @param position, mask - where the field sits, value is cut to fit like a bitfield
+ * @return None.
+ * @brief  Read-modify-write of one field, traced as one write of the register.
+ */
+void HW_RegsWriteField(HW_Reg_t reg, uint8_t position, uint32_t mask, uint32_t value);
+
+/**
+ * @Function HW_RegsSetInputs(HW_Reg_t port, uint32_t levels)
+ * @param port - HW_REG() of a PORT register
+ * @param levels - what the outside world drives on the pins, only the pins
+ * set to inputs read it back
+ * @return None.
+ */
+void HW_RegsSetInputs(HW_Reg_t port, uint32_t levels);
+
+/**
+ * @Function HW_RegsWriteCount(void)
+ * @param None.
+ * @return number of register writes since HW_RegsReset
+ */
+uint32_t HW_RegsWriteCount(void);
+
+/**
+ * @Function HW_RegsGetTrace(uint32_t seq, HW_Trace_t *entry)
+ * @param seq - which write, 0 is the first since HW_RegsReset
+ * @param entry - filled in with the write
+ * @return SUCCESS, or ERROR if it has not happened or was pushed out of the
+ * last HW_TRACE_SIZE writes
+ */
+int8_t HW_RegsGetTrace(uint32_t seq, HW_Trace_t *entry);
+
+/**
+ * @Function HW_RegsName(HW_Reg_t reg)
+ * @param reg - HW_REG() of any register
+ * @return its xc.h name, for printing traces
+ */
+const char *HW_RegsName(HW_Reg_t reg);
+
+/**
+ * @Function HW_RegsCoreTicks(void)
+ * @param None.
+ * @return host time in 40MHz core timer ticks, so benchmarks read the same units
+ */
+uint32_t HW_RegsCoreTicks(void);
+
+#endif
+
+// pins are an SFR and a bit, these spread them into the macros above
+#define HW_PIN(sfr, bit) sfr, bit
+#define HW_PIN_READ(pin) HW_PIN_READ_(pin)
+#define HW_PIN_WRITE(pin, value) HW_PIN_WRITE_(pin, value)
+
+#endif /* HW_REGS_H */
@@ -6,11 +6,10 @@
  * Modified on August 8,2013, 9:14 AM
  */
 
-#include <xc.h>
-
 #include <BOARD.h>
 #include <serial.h>
 #include <IO_Ports.h>
+#include <HW_Regs.h>
 
 
 /*******************************************************************************
@@ -34,74 +33,53 @@
 #define PORTVWMASK 0x01F8       //0b0000 0001 1111 1000
 #define PORTXYZMASK 0x1FF8      //0b0001 1111 1111 1000
 
+// physical PIC32 ports under the IO board pins
+#define NUMPHYS 5
+#define PHYS_B 0
+#define PHYS_D 1
+#define PHYS_E 2
+#define PHYS_F 3
+#define PHYS_G 4
+
 // code readability macros
-#define IO_PortsSetInput(port,i) *PORTS_TRISSET[port][i-OFFSET] = PortsBits[port][i-OFFSET]
-#define IO_PortsSetOutput(port,i) *PORTS_TRISCLR[port][i-OFFSET] = PortsBits[port][i-OFFSET]
-#define IO_PortsSetPin(port,i) *PORTS_LATSET[port][i-OFFSET] = PortsBits[port][i-OFFSET]
-#define IO_PortsClearPin(port,i) *PORTS_LATCLR[port][i-OFFSET] = PortsBits[port][i-OFFSET]
-#define IO_PortsTogglePin(port,i) *PORTS_LATINV[port][i-OFFSET] = PortsBits[port][i-OFFSET]
+#define IO_PortsSetInput(port,i) HW_WRITE(PHYS_TRISSET[PinPhys[port][i-OFFSET]], PortsBits[port][i-OFFSET])
+#define IO_PortsSetOutput(port,i) HW_WRITE(PHYS_TRISCLR[PinPhys[port][i-OFFSET]], PortsBits[port][i-OFFSET])
+#define IO_PortsSetPin(port,i) HW_WRITE(PHYS_LATSET[PinPhys[port][i-OFFSET]], PortsBits[port][i-OFFSET])
+#define IO_PortsClearPin(port,i) HW_WRITE(PHYS_LATCLR[PinPhys[port][i-OFFSET]], PortsBits[port][i-OFFSET])
+#define IO_PortsTogglePin(port,i) HW_WRITE(PHYS_LATINV[PinPhys[port][i-OFFSET]], PortsBits[port][i-OFFSET])
 
 /*******************************************************************************
  * PRIVATE STRUCTS and TYPEDEFS                                                *
  ******************************************************************************/
 
-typedef union {
-
-    struct {
-        unsigned : OFFSET;
-        unsigned bit3 : 1;
-        unsigned bit4 : 1;
-        unsigned bit5 : 1;
-        unsigned bit6 : 1;
-        unsigned bit7 : 1;
-        unsigned bit8 : 1;
-        unsigned bit9 : 1;
-        unsigned bit10 : 1;
-        unsigned bit11 : 1;
-        unsigned bit12 : 1;
-        unsigned : (6 - OFFSET);
-    };
-    uint16_t ui;
-} portBitField_T;
 
 /*******************************************************************************
  * PRIVATE VARIABLES                                                           *
  ******************************************************************************/
 
-static volatile unsigned int * const PORTS_TRISCLR[][NUMPINS] = {
-    {&TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, NULL, NULL, NULL, NULL},
-    {&TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, &TRISBCLR, NULL, NULL, NULL, NULL},
-    {&TRISFCLR, &TRISBCLR, &TRISGCLR, &TRISFCLR, &TRISGCLR, &TRISFCLR, &TRISGCLR, &TRISDCLR, &TRISDCLR, &TRISDCLR},
-    {&TRISDCLR, &TRISDCLR, &TRISDCLR, &TRISDCLR, &TRISECLR, &TRISDCLR, &TRISECLR, &TRISDCLR, &TRISECLR, &TRISDCLR},
-    {&TRISECLR, &TRISFCLR, &TRISECLR, &TRISDCLR, &TRISECLR, &TRISDCLR, &TRISECLR, &TRISFCLR, &TRISECLR, &TRISFCLR}
+static const HW_Reg_t PHYS_TRISCLR[NUMPHYS] = {
+    HW_REG(TRISBCLR), HW_REG(TRISDCLR), HW_REG(TRISECLR), HW_REG(TRISFCLR), HW_REG(TRISGCLR)
+};
+static const HW_Reg_t PHYS_TRISSET[NUMPHYS] = {
+    HW_REG(TRISBSET), HW_REG(TRISDSET), HW_REG(TRISESET), HW_REG(TRISFSET), HW_REG(TRISGSET)
 };
-static volatile unsigned int * const PORTS_TRISSET[][NUMPINS] = {
-    {&TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, NULL, NULL, NULL, NULL},
-    {&TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, &TRISBSET, NULL, NULL, NULL, NULL},
-    {&TRISFSET, &TRISBSET, &TRISGSET, &TRISFSET, &TRISGSET, &TRISFSET, &TRISGSET, &TRISDSET, &TRISDSET, &TRISDSET},
-    {&TRISDSET, &TRISDSET, &TRISDSET, &TRISDSET, &TRISESET, &TRISDSET, &TRISESET, &TRISDSET, &TRISESET, &TRISDSET},
-    {&TRISESET, &TRISFSET, &TRISESET, &TRISDSET, &TRISESET, &TRISDSET, &TRISESET, &TRISFSET, &TRISESET, &TRISFSET}
+static const HW_Reg_t PHYS_LATCLR[NUMPHYS] = {
+    HW_REG(LATBCLR), HW_REG(LATDCLR), HW_REG(LATECLR), HW_REG(LATFCLR), HW_REG(LATGCLR)
 };
-static volatile unsigned int * const PORTS_LATCLR[][NUMPINS] = {
-    {&LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, NULL, NULL, NULL, NULL},
-    {&LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, &LATBCLR, NULL, NULL, NULL, NULL},
-    {&LATFCLR, &LATBCLR, &LATGCLR, &LATFCLR, &LATGCLR, &LATFCLR, &LATGCLR, &LATDCLR, &LATDCLR, &LATDCLR},
-    {&LATDCLR, &LATDCLR, &LATDCLR, &LATDCLR, &LATECLR, &LATDCLR, &LATECLR, &LATDCLR, &LATECLR, &LATDCLR},
-    {&LATECLR, &LATFCLR, &LATECLR, &LATDCLR, &LATECLR, &LATDCLR, &LATECLR, &LATFCLR, &LATECLR, &LATFCLR}
+static const HW_Reg_t PHYS_LATSET[NUMPHYS] = {
+    HW_REG(LATBSET), HW_REG(LATDSET), HW_REG(LATESET), HW_REG(LATFSET), HW_REG(LATGSET)
 };
-static volatile unsigned int * const PORTS_LATSET[][NUMPINS] = {
-    {&LATBSET, &LATBSET, &LATBSET, &LATBSET, &LATBSET, &LATBSET, NULL, NULL, NULL, NULL},
-    {&LATBSET, &LATBSET, &LATBSET, &LATBSET, &LATBSET, &LATBSET, NULL, NULL, NULL, NULL},
-    {&LATFSET, &LATBSET, &LATGSET, &LATFSET, &LATGSET, &LATFSET, &LATGSET, &LATDSET, &LATDSET, &LATDSET},
-    {&LATDSET, &LATDSET, &LATDSET, &LATDSET, &LATESET, &LATDSET, &LATESET, &LATDSET, &LATESET, &LATDSET},
-    {&LATESET, &LATFSET, &LATESET, &LATDSET, &LATESET, &LATDSET, &LATESET, &LATFSET, &LATESET, &LATFSET}
+static const HW_Reg_t PHYS_LATINV[NUMPHYS] = {
+    HW_REG(LATBINV), HW_REG(LATDINV), HW_REG(LATEINV), HW_REG(LATFINV), HW_REG(LATGINV)
 };
-static volatile unsigned int * const PORTS_LATINV[][NUMPINS] = {
-    {&LATBINV, &LATBINV, &LATBINV, &LATBINV, &LATBINV, &LATBINV, NULL, NULL, NULL, NULL},
-    {&LATBINV, &LATBINV, &LATBINV, &LATBINV, &LATBINV, &LATBINV, NULL, NULL, NULL, NULL},
-    {&LATFINV, &LATBINV, &LATGINV, &LATFINV, &LATGINV, &LATFINV, &LATGINV, &LATDINV, &LATDINV, &LATDINV},
-    {&LATDINV, &LATDINV, &LATDINV, &LATDINV, &LATEINV, &LATDINV, &LATEINV, &LATDINV, &LATEINV, &LATDINV},
-    {&LATEINV, &LATFINV, &LATEINV, &LATDINV, &LATEINV, &LATDINV, &LATEINV, &LATFINV, &LATEINV, &LATFINV}
+
+// which physical port each pin is on, the unused pins on V & W have no bits
+static const uint8_t PinPhys[][NUMPINS] = {
+    {PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B},
+    {PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B, PHYS_B},
+    {PHYS_F, PHYS_B, PHYS_G, PHYS_F, PHYS_G, PHYS_F, PHYS_G, PHYS_D, PHYS_D, PHYS_D},
+    {PHYS_D, PHYS_D, PHYS_D, PHYS_D, PHYS_E, PHYS_D, PHYS_E, PHYS_D, PHYS_E, PHYS_D},
+    {PHYS_E, PHYS_F, PHYS_E, PHYS_D, PHYS_E, PHYS_D, PHYS_E, PHYS_F, PHYS_E, PHYS_F}
 };
 
 #ifdef JP_SPI_MASTER
@@ -113,7 +91,7 @@ static const uint16_t PortsBits[][NUMPINS] = {
     {BIT_4, BIT_1, BIT_3, BIT_0, BIT_2, BIT_8, BIT_1, BIT_3, BIT_0, BIT_2}
 };
 #else
-static const uint16_t PortBits[][NUMPINS] = {
+static const uint16_t PortsBits[][NUMPINS] = {
     {BIT_2, BIT_3, BIT_4, BIT_5, BIT_8, BIT_9, ZERO, ZERO, ZERO, ZERO},
     {BIT_11, BIT_10, BIT_13, BIT_12, BIT_15, BIT_14, ZERO, ZERO, ZERO, ZERO},
     {BIT_5, BIT_0, BIT_6, BIT_4, BIT_8, BIT_6, BIT_7, BIT_7, BIT_4, BIT_6},
@@ -121,6 +99,16 @@ static const uint16_t PortBits[][NUMPINS] = {
     {BIT_4, BIT_1, BIT_3, BIT_0, BIT_2, BIT_8, BIT_1, BIT_3, BIT_0, BIT_2}
 };
 #endif
+
+// every bit each port has on each physical port, the same with either bit
+// table as the SPI master swap stays within PORTG
+static const uint16_t PhysMask[][NUMPHYS] = {
+    {0x033C, 0x0000, 0x0000, 0x0000, 0x0000},
+    {0xFC00, 0x0000, 0x0000, 0x0000, 0x0000},
+    {0x0001, 0x00D0, 0x0000, 0x0070, 0x01C0},
+    {0x0000, 0x0E2E, 0x00E0, 0x0000, 0x0000},
+    {0x0000, 0x0101, 0x001F, 0x000E, 0x0000}
+};
 /*******************************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES                                                *
  ******************************************************************************/
@@ -180,14 +168,29 @@ uint16_t PortReadY(void);
  * @author Gabriel H Elkaim, 2013.10.20 12:23 */
 uint16_t PortReadZ(void);
 
+/**
+ * @Function PortScatterV(uint16_t pattern, uint16_t phys[NUMPHYS])
+ * @param pattern - pins to set, bit positions match the PINS on the header
+ * @param phys - one mask per physical port, the bits under the set pins are
+ *               or'd in
+ * @return None
+ * @brief The reverse of PortReadV, moves the pins onto their physical port
+ *        bits with a shift and mask per group of pins. Bits off the header
+ *        are dropped. W, X, Y and Z are the same for their ports. */
+void PortScatterV(uint16_t pattern, uint16_t phys[NUMPHYS]);
+void PortScatterW(uint16_t pattern, uint16_t phys[NUMPHYS]);
+void PortScatterX(uint16_t pattern, uint16_t phys[NUMPHYS]);
+void PortScatterY(uint16_t pattern, uint16_t phys[NUMPHYS]);
+void PortScatterZ(uint16_t pattern, uint16_t phys[NUMPHYS]);
+
 /**
  * @Function: PortHandleHardwareIndirection(char port, unsigned short pattern,
     static volatile unsigned int * const portregister, const char * fname)
  * @param port - #defined as PORTx [V, W, X, Y, or Z]
  * @param pattern - pattern to be inserted into special registers, valid from
  *                  bits 3-8 [V,W] or 3-12 [X,Y,Z]
- * @param portregister - pointer to PORT_TRIS, _LAT, etc.
- * @param altregister - pointer to PORT_TRIS, _LAT, etc.
+ * @param portregister - PHYS_TRISSET, PHYS_LATCLR, etc.
+ * @param altregister - PHYS_TRISSET, PHYS_LATCLR, etc.
  * @return SUCCESS or ERROR
  * @brief Handles the hardware indirection and port checking functions to make
  *         the ports on the IO_Board of the Uno32 stack appear to be contiguous
@@ -197,8 +200,8 @@ uint16_t PortReadZ(void);
  *       used. Use this to handle functions where both 1's and 0's are important.
  * @author Gabriel H Elkaim, 2013.10.19 21:49 */
 int8_t PortHandleHardwareIndirection(int8_t port, uint16_t pattern,
-    volatile unsigned int * const portregister[][NUMPINS],
-    volatile unsigned int * const altregister[][NUMPINS]);
+    const HW_Reg_t portregister[NUMPHYS],
+    const HW_Reg_t altregister[NUMPHYS]);
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
@@ -207,7 +210,7 @@ int8_t PortHandleHardwareIndirection(int8_t port, uint16_t pattern,
 int8_t IO_PortsSetPortDirection(int8_t port, uint16_t pattern)
 {
     if (PortHandleHardwareIndirection(port, pattern,
-        PORTS_TRISSET, PORTS_TRISCLR) == ERROR) {
+        PHYS_TRISSET, PHYS_TRISCLR) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -236,7 +239,7 @@ int8_t IO_PortsSetPortDirection(int8_t port, uint16_t pattern)
 
 int8_t IO_PortsSetPortInputs(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_TRISSET, NULL) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_TRISSET, NULL) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -263,7 +266,7 @@ int8_t IO_PortsSetPortInputs(int8_t port, uint16_t pattern)
 
 int8_t IO_PortsSetPortOutputs(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_TRISCLR, NULL) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_TRISCLR, NULL) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -318,7 +321,7 @@ int16_t IO_PortsReadPort(int8_t port)
 
 int8_t IO_PortsWritePort(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_LATSET, PORTS_LATCLR) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_LATSET, PHYS_LATCLR) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -347,7 +350,7 @@ int8_t IO_PortsWritePort(int8_t port, uint16_t pattern)
 
 int8_t IO_PortsSetPortBits(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_LATSET, NULL) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_LATSET, NULL) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -374,7 +377,7 @@ int8_t IO_PortsSetPortBits(int8_t port, uint16_t pattern)
 
 int8_t IO_PortsClearPortBits(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_LATCLR, NULL) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_LATCLR, NULL) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -401,7 +404,7 @@ int8_t IO_PortsClearPortBits(int8_t port, uint16_t pattern)
 
 int8_t IO_PortsTogglePortBits(int8_t port, uint16_t pattern)
 {
-    if (PortHandleHardwareIndirection(port, pattern, PORTS_LATINV, NULL) == ERROR) {
+    if (PortHandleHardwareIndirection(port, pattern, PHYS_LATINV, NULL) == ERROR) {
         dbprintf("\nIO_Ports: %s failed, must be called with a single PORTx", __FUNCTION__);
     } else {
         return SUCCESS;
@@ -430,76 +433,131 @@ int8_t IO_PortsTogglePortBits(int8_t port, uint16_t pattern)
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+/* Each read loads the physical PORT registers once and moves the pins into
+ * place with a shift and mask per group of pins that move by the same amount.
+ * The pin comments give the source bit -> header pin. */
 uint16_t PortReadV(void)
 {
-    portBitField_T portV = {.ui = 0x0000};
-    portV.bit3 = PORTV03_BIT;
-    portV.bit4 = PORTV04_BIT;
-    portV.bit5 = PORTV05_BIT;
-    portV.bit6 = PORTV06_BIT;
-    portV.bit7 = PORTV07_BIT;
-    portV.bit8 = PORTV08_BIT;
-    return (portV.ui);
+    uint16_t b = HW_SFR_READ(PORTB);
+    return (((b & 0x003C) << 1) |       // B2-B5 -> 3-6
+            ((b & 0x0300) >> 1));       // B8-B9 -> 7-8
 }
 
 uint16_t PortReadW(void)
 {
-    portBitField_T portW = {.ui = 0x0000};
-    portW.bit3 = PORTW03_BIT;
-    portW.bit4 = PORTW04_BIT;
-    portW.bit5 = PORTW05_BIT;
-    portW.bit6 = PORTW06_BIT;
-    portW.bit7 = PORTW07_BIT;
-    portW.bit8 = PORTW08_BIT;
-    return (portW.ui);
+    uint16_t b = HW_SFR_READ(PORTB);
+    return (((b & 0xA800) >> 8) |       // B11 B13 B15 -> 3 5 7
+            ((b & 0x5400) >> 6));       // B10 B12 B14 -> 4 6 8
 }
 
 uint16_t PortReadX(void)
 {
-    portBitField_T portX = {.ui = 0x0000};
-    portX.bit3 = PORTX03_BIT;
-    portX.bit4 = PORTX04_BIT;
-    portX.bit5 = PORTX05_BIT;
-    portX.bit6 = PORTX06_BIT;
-    portX.bit7 = PORTX07_BIT;
-    portX.bit8 = PORTX08_BIT;
-    portX.bit9 = PORTX09_BIT;
-    portX.bit10 = PORTX10_BIT;
-    portX.bit11 = PORTX11_BIT;
-    portX.bit12 = PORTX12_BIT;
-    return (portX.ui);
+    uint16_t b = HW_SFR_READ(PORTB), d = HW_SFR_READ(PORTD);
+    uint16_t f = HW_SFR_READ(PORTF), g = HW_SFR_READ(PORTG);
+    return (((f & 0x0020) >> 2) |       // F5 -> 3
+            ((b & 0x0001) << 4) |       // B0 -> 4
+            ((f & 0x0050) << 2) |       // F4 F6 -> 6 8
+#ifdef JP_SPI_MASTER
+            ((g & 0x0040) >> 1) |       // G6 -> 5
+            (g & 0x0080) |              // G7 -> 7
+            ((g & 0x0100) << 1) |       // G8 -> 9
+#else
+            ((g & 0x0140) >> 1) |       // G6 G8 -> 5 7
+            ((g & 0x0080) << 2) |       // G7 -> 9
+#endif
+            ((d & 0x0080) << 3) |       // D7 -> 10
+            ((d & 0x0010) << 7) |       // D4 -> 11
+            ((d & 0x0040) << 6));       // D6 -> 12
 }
 
 uint16_t PortReadY(void)
 {
-    portBitField_T portY = {.ui = 0x0000};
-    portY.bit3 = PORTY03_BIT;
-    portY.bit4 = PORTY04_BIT;
-    portY.bit5 = PORTY05_BIT;
-    portY.bit6 = PORTY06_BIT;
-    portY.bit7 = PORTY07_BIT;
-    portY.bit8 = PORTY08_BIT;
-    portY.bit9 = PORTY09_BIT;
-    portY.bit10 = PORTY10_BIT;
-    portY.bit11 = PORTY11_BIT;
-    portY.bit12 = PORTY12_BIT;
-    return (portY.ui);
+    uint16_t d = HW_SFR_READ(PORTD), e = HW_SFR_READ(PORTE);
+    return (((d & 0x0800) >> 8) |       // D11 -> 3
+            ((d & 0x0008) << 1) |       // D3 -> 4
+            (d & 0x0020) |              // D5 -> 5
+            ((d & 0x0400) >> 4) |       // D10 -> 6
+            (e & 0x0080) |              // E7 -> 7
+            ((d & 0x0200) >> 1) |       // D9 -> 8
+            ((e & 0x0040) << 3) |       // E6 -> 9
+            ((d & 0x0004) << 8) |       // D2 -> 10
+            ((e & 0x0020) << 6) |       // E5 -> 11
+            ((d & 0x0002) << 11));      // D1 -> 12
 }
 
 uint16_t PortReadZ(void)
 {
-    portBitField_T portZ = {.ui = 0x0000};
-    portZ.bit3 = PORTZ03_BIT;
-    portZ.bit4 = PORTZ04_BIT;
-    portZ.bit5 = PORTZ05_BIT;
-    portZ.bit6 = PORTZ06_BIT;
-    portZ.bit7 = PORTZ07_BIT;
-    portZ.bit8 = PORTZ08_BIT;
-    portZ.bit9 = PORTZ09_BIT;
-    portZ.bit10 = PORTZ10_BIT;
-    portZ.bit11 = PORTZ11_BIT;
-    portZ.bit12 = PORTZ12_BIT;
-    return (portZ.ui);
+    uint16_t d = HW_SFR_READ(PORTD), e = HW_SFR_READ(PORTE), f = HW_SFR_READ(PORTF);
+    return (((e & 0x0010) >> 1) |       // E4 -> 3
+            ((f & 0x0002) << 3) |       // F1 -> 4
+            ((e & 0x0008) << 2) |       // E3 -> 5
+            ((d & 0x0001) << 6) |       // D0 -> 6
+            ((e & 0x0004) << 5) |       // E2 -> 7
+            (d & 0x0100) |              // D8 -> 8
+            ((e & 0x0002) << 8) |       // E1 -> 9
+            ((f & 0x0008) << 7) |       // F3 -> 10
+            ((e & 0x0001) << 11) |      // E0 -> 11
+            ((f & 0x0004) << 10));      // F2 -> 12
+}
+
+/* The scatters are the reads run backwards, the pin comments give the header
+ * pin -> destination bit. */
+void PortScatterV(uint16_t pattern, uint16_t phys[NUMPHYS])
+{
+    phys[PHYS_B] |= (((pattern & 0x0078) >> 1) |    // 3-6 -> B2-B5
+            ((pattern & 0x0180) << 1));             // 7-8 -> B8-B9
+}
+
+void PortScatterW(uint16_t pattern, uint16_t phys[NUMPHYS])
+{
+    phys[PHYS_B] |= (((pattern & 0x00A8) << 8) |    // 3 5 7 -> B11 B13 B15
+            ((pattern & 0x0150) << 6));             // 4 6 8 -> B10 B12 B14
+}
+
+void PortScatterX(uint16_t pattern, uint16_t phys[NUMPHYS])
+{
+    phys[PHYS_B] |= (pattern & 0x0010) >> 4;        // 4 -> B0
+    phys[PHYS_D] |= (((pattern & 0x0400) >> 3) |    // 10 -> D7
+            ((pattern & 0x0800) >> 7) |             // 11 -> D4
+            ((pattern & 0x1000) >> 6));             // 12 -> D6
+    phys[PHYS_F] |= (((pattern & 0x0008) << 2) |    // 3 -> F5
+            ((pattern & 0x0140) >> 2));             // 6 8 -> F4 F6
+#ifdef JP_SPI_MASTER
+    phys[PHYS_G] |= (((pattern & 0x0020) << 1) |    // 5 -> G6
+            (pattern & 0x0080) |                    // 7 -> G7
+            ((pattern & 0x0200) >> 1));             // 9 -> G8
+#else
+    phys[PHYS_G] |= (((pattern & 0x00A0) << 1) |    // 5 7 -> G6 G8
+            ((pattern & 0x0200) >> 2));             // 9 -> G7
+#endif
+}
+
+void PortScatterY(uint16_t pattern, uint16_t phys[NUMPHYS])
+{
+    phys[PHYS_D] |= (((pattern & 0x0008) << 8) |    // 3 -> D11
+            ((pattern & 0x0010) >> 1) |             // 4 -> D3
+            (pattern & 0x0020) |                    // 5 -> D5
+            ((pattern & 0x0040) << 4) |             // 6 -> D10
+            ((pattern & 0x0100) << 1) |             // 8 -> D9
+            ((pattern & 0x0400) >> 8) |             // 10 -> D2
+            ((pattern & 0x1000) >> 11));            // 12 -> D1
+    phys[PHYS_E] |= ((pattern & 0x0080) |           // 7 -> E7
+            ((pattern & 0x0200) >> 3) |             // 9 -> E6
+            ((pattern & 0x0800) >> 6));             // 11 -> E5
+}
+
+void PortScatterZ(uint16_t pattern, uint16_t phys[NUMPHYS])
+{
+    phys[PHYS_D] |= (((pattern & 0x0040) >> 6) |    // 6 -> D0
+            (pattern & 0x0100));                    // 8 -> D8
+    phys[PHYS_E] |= (((pattern & 0x0008) << 1) |    // 3 -> E4
+            ((pattern & 0x0020) >> 2) |             // 5 -> E3
+            ((pattern & 0x0080) >> 5) |             // 7 -> E2
+            ((pattern & 0x0200) >> 8) |             // 9 -> E1
+            ((pattern & 0x0800) >> 11));            // 11 -> E0
+    phys[PHYS_F] |= (((pattern & 0x0010) >> 3) |    // 4 -> F1
+            ((pattern & 0x0400) >> 7) |             // 10 -> F3
+            ((pattern & 0x1000) >> 10));            // 12 -> F2
 }
 
 /**
@@ -508,8 +566,8 @@ uint16_t PortReadZ(void)
  * @param port - #defined as PORTx [V, W, X, Y, or Z]
  * @param pattern - pattern to be inserted into special registers, valid from
  *                  bits 3-8 [V,W] or 3-12 [X,Y,Z]
- * @param portregister - pointer to PORT_TRIS, _LAT, etc.
- * @param altregister - pointer to PORT_TRIS, _LAT, etc.
+ * @param portregister - PHYS_TRISSET, PHYS_LATCLR, etc.
+ * @param altregister - PHYS_TRISSET, PHYS_LATCLR, etc.
  * @return SUCCESS or ERROR
  * @brief Handles the hardware indirection and port checking functions to make
  *         the ports on the IO_Board of the Uno32 stack appear to be contiguous
@@ -517,31 +575,44 @@ uint16_t PortReadZ(void)
  *         one function.
  * @note if the altregister pointer is NULL, then only the 1's on the pattern are
  *       used. Use this to handle functions where both 1's and 0's are important.
+ *       The pattern is scattered into one mask per physical port first with the
+ *       port's shift and mask groups, and the 0's are what is left of PhysMask,
+ *       so it costs at most one write to each register set and the same time
+ *       for every pattern.
  * @author Gabriel H Elkaim, 2013.10.19 21:49 */
 int8_t PortHandleHardwareIndirection(int8_t port, uint16_t pattern,
-    volatile unsigned int * const portregister[][NUMPINS],
-    volatile unsigned int * const altregister[][NUMPINS])
+    const HW_Reg_t portregister[NUMPHYS],
+    const HW_Reg_t altregister[NUMPHYS])
 {
-    uint8_t i, topbit;
-    if ((port < PORTV) || (port > PORTZ)) { // test if port is within range
+    uint16_t ones[NUMPHYS] = {0, 0, 0, 0, 0};
+    uint16_t zeros;
+    uint8_t i;
+    switch (port) {
+    case PORTV:
+        PortScatterV(pattern, ones);
+        break;
+    case PORTW:
+        PortScatterW(pattern, ones);
+        break;
+    case PORTX:
+        PortScatterX(pattern, ones);
+        break;
+    case PORTY:
+        PortScatterY(pattern, ones);
+        break;
+    case PORTZ:
+        PortScatterZ(pattern, ones);
+        break;
+    default: // port is out of range
         return ERROR;
     }
-    if (port <= PORTW) {
-        topbit = TOPVW;
-        pattern &= PORTVWMASK;
-    } else {
-        topbit = TOPXYZ;
-        pattern &= PORTXYZMASK;
-    }
-    for (i = OFFSET; i < topbit; i++) {
-        if (pattern & (1 << i)) { // set for "1" in position
-            *portregister[port][i - OFFSET] = PortsBits[port][i - OFFSET];
-            // This is where the actual hardware abstraction is handled, along with
-            // the offsets for the fact that the pins on the IOBoard are numbered
-            // from 1 to 14, with pins 1 & 2 and 13 & 14 always being ground.
-            // See code useability macros above for decoding these.
-        } else if (altregister != NULL) {
-            *altregister[port][i - OFFSET] = PortsBits[port][i - OFFSET];
+    for (i = 0; i < NUMPHYS; i++) {
+        if (ones[i]) {
+            HW_WRITE(portregister[i], ones[i]);
+        }
+        zeros = PhysMask[port][i] & ~ones[i];
+        if ((altregister != NULL) && zeros) {
+            HW_WRITE(altregister[i], zeros);
         }
     }
     return SUCCESS;
@@ -580,6 +651,127 @@ void TestFunction(int8_t port, uint16_t pattern, int8_t(*functionPtr)(int8_t, ui
     }
 }
 
+/* The old one write per pin loop, kept to check and time the scatter masks
+ * against.
+ */
+void PinLoopWritePort(int8_t port, uint16_t pattern)
+{
+    uint8_t i, topbit;
+    topbit = (port <= PORTW) ? TOPVW : TOPXYZ;
+    for (i = OFFSET; i < topbit; i++) {
+        if (pattern & (1 << i)) {
+            IO_PortsSetPin(port, i);
+        } else {
+            IO_PortsClearPin(port, i);
+        }
+    }
+}
+
+/* Reads a port one pin at a time through the pin tables, to check and time the
+ * gather reads against.
+ */
+uint16_t PinLoopReadPort(int8_t port)
+{
+    static const HW_Reg_t physPort[NUMPHYS] = {
+        HW_REG(PORTB), HW_REG(PORTD), HW_REG(PORTE), HW_REG(PORTF), HW_REG(PORTG)
+    };
+    uint16_t pattern = 0;
+    uint8_t i;
+    for (i = 0; i < NUMPINS; i++) {
+        if (HW_READ(physPort[PinPhys[port][i]]) & PortsBits[port][i]) {
+            pattern |= 1 << (i + OFFSET);
+        }
+    }
+    return pattern;
+}
+
+/* Writes every pattern to port with the per pin loop and with IO_PortsWritePort
+ * and compares the LAT registers after each, with bits off the header set in
+ * every other pattern. Then prints the core timer ticks per 100 writes of each
+ * over reps passes through the patterns. The port must be set to outputs.
+ */
+uint8_t CompareWrites(int8_t port, uint16_t reps)
+{
+    uint32_t start, loopTicks, maskTicks;
+    uint16_t loopLat[NUMPHYS];
+    uint16_t j, r, pattern, top;
+    uint8_t mismatch = FALSE;
+    top = (port <= PORTW) ? (PORTVWMASK >> OFFSET) : (PORTXYZMASK >> OFFSET);
+    for (j = 0; j <= top; j++) {
+        pattern = (j << OFFSET) | ((j & 1) ? ~(PORTXYZMASK) : 0);
+        PinLoopWritePort(port, pattern);
+        loopLat[PHYS_B] = HW_SFR_READ(LATB);
+        loopLat[PHYS_D] = HW_SFR_READ(LATD);
+        loopLat[PHYS_E] = HW_SFR_READ(LATE);
+        loopLat[PHYS_F] = HW_SFR_READ(LATF);
+        loopLat[PHYS_G] = HW_SFR_READ(LATG);
+        IO_PortsWritePort(port, ~pattern);
+        IO_PortsWritePort(port, pattern);
+        if ((loopLat[PHYS_B] != HW_SFR_READ(LATB)) || (loopLat[PHYS_D] != HW_SFR_READ(LATD)) ||
+            (loopLat[PHYS_E] != HW_SFR_READ(LATE)) || (loopLat[PHYS_F] != HW_SFR_READ(LATF)) ||
+            (loopLat[PHYS_G] != HW_SFR_READ(LATG))) {
+            mismatch = TRUE;
+        }
+    }
+    start = _CP0_GET_COUNT();
+    for (r = 0; r < reps; r++) {
+        for (j = 0; j <= top; j++) {
+            PinLoopWritePort(port, j << OFFSET);
+        }
+    }
+    loopTicks = _CP0_GET_COUNT() - start;
+    start = _CP0_GET_COUNT();
+    for (r = 0; r < reps; r++) {
+        for (j = 0; j <= top; j++) {
+            IO_PortsWritePort(port, j << OFFSET);
+        }
+    }
+    maskTicks = _CP0_GET_COUNT() - start;
+    printf(mismatch ? "FAILED" : "PASSED");
+    printf(", core timer ticks per 100 writes: per pin loop %lu, scatter masks %lu",
+        (unsigned long) ((uint64_t) loopTicks * 100 / ((uint32_t) reps * (top + 1))),
+        (unsigned long) ((uint64_t) maskTicks * 100 / ((uint32_t) reps * (top + 1))));
+    return mismatch;
+}
+
+/* Reads every port per pin and with IO_PortsReadPort and compares them, then
+ * prints the core timer ticks per 100 reads of each over reps passes.
+ */
+uint8_t CompareReads(uint16_t reps)
+{
+    uint32_t start, loopTicks, gatherTicks;
+    volatile uint16_t sink;
+    uint16_t j;
+    int8_t k;
+    uint8_t mismatch = FALSE;
+    for (k = PORTV; k <= PORTZ; k++) {
+        if (PinLoopReadPort(k) != IO_PortsReadPort(k)) {
+            mismatch = TRUE;
+        }
+    }
+    start = _CP0_GET_COUNT();
+    for (j = 0; j < reps; j++) {
+        for (k = PORTV; k <= PORTZ; k++) {
+            sink = PinLoopReadPort(k);
+        }
+    }
+    loopTicks = _CP0_GET_COUNT() - start;
+    start = _CP0_GET_COUNT();
+    for (j = 0; j < reps; j++) {
+        for (k = PORTV; k <= PORTZ; k++) {
+            sink = IO_PortsReadPort(k);
+        }
+    }
+    gatherTicks = _CP0_GET_COUNT() - start;
+    printf(mismatch ? "FAILED (inputs changing?)" : "PASSED");
+    printf(", core timer ticks per 100 reads: per pin %lu, gather %lu",
+        (unsigned long) ((uint64_t) loopTicks * 100 / ((uint32_t) reps * 5)),
+        (unsigned long) ((uint64_t) gatherTicks * 100 / ((uint32_t) reps * 5)));
+    return mismatch;
+}
+
+#ifdef __PIC32MX__
+
 int main(void)
 {
 
@@ -689,6 +881,13 @@ int main(void)
     }
     DELAY(A_BIT);
 
+    //
+    // Check IO_PortsWritePort against the per pin loop, and time both
+    //
+    printf("\n\nTesting IO_PortsWritePort against the per pin loop on every pattern: ");
+    CompareWrites(OUTPUTPORT, 1);
+    DELAY(A_BIT);
+
     //
     // Strobe pins on OUTPUT port, leave all others alone
     //
@@ -758,6 +957,9 @@ int main(void)
     }
 
 
+    printf("\nTesting IO_PortsReadPort against per pin reads on every port: ");
+    CompareReads(100);
+
     printf("\nTesting IO_PortsReadPort, all pins on PORT%c will be echo'd onto PORT%c.", portLabel[INPUTPORT], portLabel[OUTPUTPORT]);
     oldPattern = IO_PortsReadPort(INPUTPORT);
     printf("\n[0x%04X] ", oldPattern);
@@ -783,4 +985,64 @@ int main(void)
     DELAY(A_LOT);
     while (1);
 }
+
+#else
+
+/* Off the robot the same checks run on the HW_Regs register file, every port
+ * as outputs for the writes and as inputs driven with a spread of levels for
+ * the reads, and the SFR writes each way takes are counted off its trace.
+ */
+#define HOST_REPS 2000
+
+int main(void)
+{
+    static const HW_Reg_t physPort[NUMPHYS] = {
+        HW_REG(PORTB), HW_REG(PORTD), HW_REG(PORTE), HW_REG(PORTF), HW_REG(PORTG)
+    };
+    char portLabel[] = {'V', 'W', 'X', 'Y', 'Z'};
+    uint32_t levels = 0x5A5A, loopWrites, maskWrites;
+    uint16_t pattern, top;
+    uint8_t failed = FALSE;
+    int8_t k;
+    uint8_t i, j;
+
+    printf("\nIO_Ports host test harness on the HW_Regs register file");
+    HW_RegsReset();
+    for (k = PORTV; k <= PORTZ; k++) {
+        failed |= (IO_PortsSetPortOutputs(k, 0xFFFF) != SUCCESS);
+    }
+    for (k = PORTV; k <= PORTZ; k++) {
+        printf("\nPORT%c IO_PortsWritePort against the per pin loop: ", portLabel[k]);
+        failed |= CompareWrites(k, HOST_REPS);
+        top = (k <= PORTW) ? (PORTVWMASK >> OFFSET) : (PORTXYZMASK >> OFFSET);
+        loopWrites = HW_RegsWriteCount();
+        for (pattern = 0; pattern <= top; pattern++) {
+            PinLoopWritePort(k, pattern << OFFSET);
+        }
+        maskWrites = HW_RegsWriteCount();
+        loopWrites = maskWrites - loopWrites;
+        for (pattern = 0; pattern <= top; pattern++) {
+            IO_PortsWritePort(k, pattern << OFFSET);
+        }
+        maskWrites = HW_RegsWriteCount() - maskWrites;
+        printf("\n    SFR writes per 10 writes: per pin loop %lu, scatter masks %lu",
+            (unsigned long) (loopWrites * 10 / (top + 1)),
+            (unsigned long) (maskWrites * 10 / (top + 1)));
+    }
+    for (k = PORTV; k <= PORTZ; k++) {
+        IO_PortsSetPortInputs(k, 0xFFFF);
+    }
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < NUMPHYS; i++) {
+            levels = levels * 1103515245 + 12345;
+            HW_RegsSetInputs(physPort[i], levels >> 8);
+        }
+        printf("\nIO_PortsReadPort against per pin reads, inputs %u: ", j);
+        failed |= CompareReads(HOST_REPS);
+    }
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+#endif
 #endif
\ No newline at end of file
@@ -36,7 +36,10 @@
  *            of the board. 
  *
  * IO_PORTS_TEST (in the .c file) conditionally compiles the test harness for the code.
- * Make sure it is commented out for module useage.
+ * Make sure it is commented out for module useage. Built off the robot it checks
+ * and times the port writes and reads against per pin loops on the HW_Regs
+ * register file:
+ *   gcc -DIO_PORTS_TEST IO_Ports.c HW_Regs.c
  *
  * Created on December 26, 2011, 11:21 PM
  * Modified on October 19, 2013, 6:33 PM
@@ -46,7 +49,7 @@
 #define IO_PORTS_H
 
 
-#include <peripheral/ports.h>
+#include <HW_Regs.h>
 #include <BOARD.h>
 
 /*******************************************************************************
@@ -0,0 +1,75 @@
+/*
+ * File:   Idle.c
+ *
+ * Idles the core between interrupts when there is nothing to do, see Idle.h.
+ */
+
+#include <stdio.h>
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "HW_Regs.h"
+#include "Idle.h"
+#ifdef __PIC32MX__
+#include <peripheral/power.h>
+#endif
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+#define CORE_TICKS_PER_MS 40000
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+static Idle_Stats_t Stats;
+static uint8_t Counting = FALSE;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+uint8_t IdleChecker(void)
+{
+    uint32_t start;
+
+    if (Counting == FALSE) {
+        Idle_ResetStats();
+    }
+    start = _CP0_GET_COUNT();
+#ifdef __PIC32MX__
+    PowerSaveIdle();
+#endif
+    Stats.idleTicks += _CP0_GET_COUNT() - start;
+    Stats.wakes++;
+    return FALSE;
+}
+
+const Idle_Stats_t *Idle_GetStats(void)
+{
+    return &Stats;
+}
+
+void Idle_ResetStats(void)
+{
+    Stats.wakes = 0;
+    Stats.idleTicks = 0;
+    Stats.since = ES_Timer_GetTime();
+    Counting = TRUE;
+}
+
+void Idle_PrintStats(void)
+{
+    uint32_t elapsed = ES_Timer_GetTime() - Stats.since;
+    uint32_t permille = 0;
+
+    if (elapsed > 0) {
+        permille = Stats.idleTicks * 1000 / ((uint64_t) elapsed * CORE_TICKS_PER_MS);
+    }
+    printf("idle: %lu waits, %lu wakes/s, %lu.%lu%% waiting\r\n",
+            (unsigned long) Stats.wakes,
+            (unsigned long) ((elapsed > 0) ? (uint64_t) Stats.wakes * 1000 / elapsed : 0),
+            (unsigned long) (permille / 10), (unsigned long) (permille % 10));
+}
@@ -0,0 +1,76 @@
+/*
+ * File:   Idle.h
+ *
+ * Idles the core when the ES_Framework has nothing to do. ES_Run polls the
+ * event checkers flat out whenever the queues are empty, but they only see
+ * something new after an interrupt: an A/D frame, the 1ms ES_Timers tick (which
+ * also runs BumperService's debounce timer), a stepper step or a serial byte.
+ * IdleChecker goes last in EVENT_CHECK_LIST, so it only runs on a pass where no
+ * checker found an event and the queues are empty. It halts the core with the
+ * PIC32 Idle mode until the next interrupt, then returns FALSE and ES_Run
+ * carries on as if nothing had happened.
+ *
+ * This is idle only power saving, it is not tickless. The 1ms tick belongs to
+ * the framework and keeps running, so no wait is longer than a millisecond and
+ * nothing ever has to be caught up. Every software deadline, the ES timers and
+ * the TimerWheel included, is checked on a tick or by a checker that ran just
+ * before, so there is nothing to gain from asking when the next one is due. An
+ * interrupt that posts an event just before the wait starts leaves it queued
+ * until the next interrupt ends the wait, at most one tick late. Sleep mode
+ * would stop the motor PWM, so it is not used.
+ *
+ * Idle_GetStats counts the waits and the core ticks spent waiting, and
+ * Idle_PrintStats turns that into residency.
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct {
+    uint32_t wakes; // waits that an interrupt ended
+    uint64_t idleTicks; // core ticks spent waiting
+    uint32_t since; // ES_Timer_GetTime() when counting started
+} Idle_Stats_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function IdleChecker(void)
+ * @param none
+ * @return FALSE, it never has an event
+ * @brief Waits for the next interrupt. Has to be last in EVENT_CHECK_LIST.
+ */
+uint8_t IdleChecker(void);
+
+/**
+ * @Function Idle_GetStats(void)
+ * @param None.
+ * @return the counts since the first IdleChecker or Idle_ResetStats
+ */
+const Idle_Stats_t *Idle_GetStats(void);
+
+/**
+ * @Function Idle_ResetStats(void)
+ * @param None.
+ * @return None.
+ */
+void Idle_ResetStats(void);
+
+/**
+ * @Function Idle_PrintStats(void)
+ * @param None.
+ * @return None.
+ * @brief Prints the waits, wake-ups per second and the share of the time the
+ *        core spent waiting over the serial port.
+ */
+void Idle_PrintStats(void);
+
+#endif /* IDLE_H */
@@ -0,0 +1,211 @@
+/*
+ * File:   Latency.c
+ *
+ * Event to actuation latency histograms, see Latency.h.
+ */
+
+#include <stdio.h>
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "HW_Regs.h"
+#include "Latency.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define LATENCY_TEST
+
+#define CORE_TICKS_PER_US 40
+#define MAX_COUNT 0xFFFF
+
+#define NUM_EVENT_TYPES (sizeof(EventNames) / sizeof(EventNames[0]))
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static uint8_t Bucket(uint32_t microseconds);
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+static uint16_t Histogram[NUM_EVENT_TYPES][LATENCY_BUCKETS];
+static uint32_t Worst[NUM_EVENT_TYPES]; // us
+static uint8_t Open = FALSE;
+static ES_EventTyp_t OpenType;
+static uint32_t OpenSince;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void Latency_Open(ES_EventTyp_t type, uint32_t postedAt)
+{
+    Open = (type < NUM_EVENT_TYPES);
+    OpenType = type;
+    OpenSince = postedAt;
+}
+
+void Latency_Actuated(void)
+{
+    uint32_t microseconds;
+    uint16_t *count;
+
+    if (Open == FALSE) {
+        return;
+    }
+    Open = FALSE;
+    // unsigned, so right across the core timer wrapping too
+    microseconds = (_CP0_GET_COUNT() - OpenSince) / CORE_TICKS_PER_US;
+    count = &Histogram[OpenType][Bucket(microseconds)];
+    if (*count < MAX_COUNT) {
+        (*count)++;
+    }
+    if (microseconds > Worst[OpenType]) {
+        Worst[OpenType] = microseconds;
+    }
+}
+
+void Latency_Close(void)
+{
+    Open = FALSE;
+}
+
+const uint16_t *Latency_GetHistogram(ES_EventTyp_t type)
+{
+    return Histogram[(type < NUM_EVENT_TYPES) ? type : ES_NO_EVENT];
+}
+
+void Latency_Reset(void)
+{
+    uint8_t type, bucket;
+
+    for (type = 0; type < NUM_EVENT_TYPES; type++) {
+        for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            Histogram[type][bucket] = 0;
+        }
+        Worst[type] = 0;
+    }
+    Open = FALSE;
+}
+
+void Latency_Print(void)
+{
+    uint32_t total;
+    uint8_t type, bucket;
+
+    for (type = 0; type < NUM_EVENT_TYPES; type++) {
+        total = 0;
+        for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            total += Histogram[type][bucket];
+        }
+        if (total == 0) {
+            continue;
+        }
+        printf("%s: %lu, worst %luus |", EventNames[type], (unsigned long) total,
+                (unsigned long) Worst[type]);
+        for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            if (Histogram[type][bucket] == 0) {
+                continue;
+            }
+            if (bucket == LATENCY_BUCKETS - 1) {
+                printf(" >=%luus %u", 1UL << (bucket - 1), Histogram[type][bucket]);
+            } else {
+                printf(" <%luus %u", 1UL << bucket, Histogram[type][bucket]);
+            }
+        }
+        printf("\r\n");
+    }
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+// 0 under 1us, otherwise one more than the highest bit set
+static uint8_t Bucket(uint32_t microseconds)
+{
+    uint8_t bucket;
+
+    if (microseconds == 0) {
+        return 0;
+    }
+    bucket = 32 - __builtin_clz(microseconds);
+    return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef LATENCY_TEST
+
+#include "TestHarness.h"
+
+// Checks the bucket of latencies either side of every power of two against a
+// plain loop, then measures a few real waits on the core timer, one of them
+// with a second command that must not count and one with none at all.
+static uint8_t SlowBucket(uint32_t microseconds)
+{
+    uint8_t bucket = 0;
+
+    while ((bucket < LATENCY_BUCKETS - 1) && (microseconds >= (1UL << bucket))) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void Wait(uint32_t microseconds)
+{
+    uint32_t start = _CP0_GET_COUNT();
+
+    while (_CP0_GET_COUNT() - start < microseconds * CORE_TICKS_PER_US);
+}
+
+int main(void)
+{
+    uint32_t us, wrong = 0, checked = 0, tapeCount = 0;
+    uint8_t bit;
+    int8_t offset;
+    const uint16_t *bump, *tape;
+
+    BOARD_Init();
+    printf("\nLatency test harness");
+    for (bit = 0; bit < 32; bit++) {
+        for (offset = -1; offset <= 1; offset++) {
+            us = (1UL << bit) + offset;
+            wrong += (Bucket(us) != SlowBucket(us));
+            checked++;
+        }
+    }
+    printf("\n%lu buckets checked, %lu wrong", (unsigned long) checked, (unsigned long) wrong);
+
+    Latency_Reset();
+    Latency_Open(FC_BUMP_EVENT, _CP0_GET_COUNT());
+    Wait(300);
+    Latency_Actuated();
+    Latency_Actuated(); // a second command in the same run
+    Latency_Close();
+    Latency_Open(FC_BUMP_EVENT, _CP0_GET_COUNT());
+    Wait(3000);
+    Latency_Actuated();
+    Latency_Close();
+    Latency_Open(FL_TAPE_SEE_BLACK_EVENT, _CP0_GET_COUNT());
+    Latency_Close(); // no command
+    Latency_Actuated();
+    bump = Latency_GetHistogram(FC_BUMP_EVENT);
+    tape = Latency_GetHistogram(FL_TAPE_SEE_BLACK_EVENT);
+    for (bit = 0; bit < LATENCY_BUCKETS; bit++) {
+        tapeCount += tape[bit];
+    }
+    printf("\nFC_BUMP_EVENT 300us in bucket %u: %u, 3000us in bucket %u: %u,"
+            " FL_TAPE_SEE_BLACK_EVENT without a command: %lu\n", SlowBucket(300),
+            bump[SlowBucket(300)], SlowBucket(3000), bump[SlowBucket(3000)],
+            (unsigned long) tapeCount);
+    Latency_Print();
+    TEST_HARNESS_END();
+    return 0;
+}
+
+#endif // LATENCY_TEST
@@ -0,0 +1,90 @@
+/*
+ * File:   Latency.h
+ *
+ * How long the robot takes to react, per event type: from the event being
+ * posted to ProjectHSM to the first wheel or lift command it leads to reaching
+ * the hardware. Every detector (the event checkers, the bumper debounce in
+ * ProjectService, the ES_Framework timers and the TimerWheel) posts straight to
+ * PostProjectHSM, so the post is the moment of detection. EventLanes stamps
+ * each event with the core timer as it is queued and hands the stamp back with
+ * it, RunProjectHSM opens a measurement with it, and Bot's wheel writes and the
+ * stepper starting, stopping or retargeting close it. A run that gives no
+ * command adds nothing, and only the first command of a run counts.
+ *
+ * Each event type has a histogram of log2 buckets in microseconds: bucket 0 is
+ * under 1us, bucket b is [2^(b-1), 2^b) us, and the last bucket takes everything
+ * longer. Counts stop at 0xFFFF. Latency_Print dumps them over the serial port.
+ *
+ * The wheel time is when the duty is written, it takes effect at the start of
+ * the next PWM period, up to 1ms later. Events posted straight to the framework
+ * queue (ES_PostAll, the keyboard) are only stamped when they reach the lanes,
+ * so theirs leave out the queue wait.
+ *
+ * LATENCY_TEST (in the .c file) conditionally compiles a test harness.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// the last takes 2^(LATENCY_BUCKETS - 2) us and up, 262ms
+#define LATENCY_BUCKETS 20
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function Latency_Open(ES_EventTyp_t type, uint32_t postedAt)
+ * @param type - the event a run is about to dispatch
+ * @param postedAt - the core timer when it was posted
+ * @return None.
+ */
+void Latency_Open(ES_EventTyp_t type, uint32_t postedAt);
+
+/**
+ * @Function Latency_Actuated(void)
+ * @param None.
+ * @return None.
+ * @brief Called once a command has reached the hardware. Adds the time since the
+ *        open event was posted to its histogram and closes it.
+ */
+void Latency_Actuated(void);
+
+/**
+ * @Function Latency_Close(void)
+ * @param None.
+ * @return None.
+ * @brief Ends the run, commands after it are not counted against its event.
+ */
+void Latency_Close(void);
+
+/**
+ * @Function Latency_GetHistogram(ES_EventTyp_t type)
+ * @param type - an event type
+ * @return its LATENCY_BUCKETS counts
+ */
+const uint16_t *Latency_GetHistogram(ES_EventTyp_t type);
+
+/**
+ * @Function Latency_Reset(void)
+ * @param None.
+ * @return None.
+ */
+void Latency_Reset(void);
+
+/**
+ * @Function Latency_Print(void)
+ * @param None.
+ * @return None.
+ * @brief Prints a line for each event type with any counts: how many, the
+ *        worst, and each bucket that is not empty by its upper bound.
+ */
+void Latency_Print(void);
+
+#endif /* LATENCY_H */
@@ -33,6 +33,8 @@
 #include "ProjectHSM.h"
 #include "ProjectBeaconFindingSubHSM.h"
 #include "TapeFollowingSubSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -52,6 +54,7 @@ static const char *StateNames[] = {
 	"TapeFollowing",
 	"PrepForScan",
 };
+STATE_STATS_DECLARE(Stats, "ProjectBeaconFindingSubHSM", StateNames);
 
 //Include any defines you need to do
 #define TAPE_FOLLOW_TICKS 4000
@@ -66,6 +69,10 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void EnterBeaconScanning(void);
+static void EnterFollowBeacon(void);
+static void EnterTapeFollowing(void);
+static void EnterPrepForScan(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -73,9 +80,66 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static ProjectBeaconFindingSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a ProjectBeaconFindingSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. TapeFollowingSubSubHSM is started each time
+ * TapeFollowing is entered, HSM_Engine does that from the subInit below, and
+ * HSM_Verify works out what it passes down from the sub-HSM's tables. */
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, BeaconScanning, NULL, NULL},
+};
+
+static const HSM_Transition_t BeaconScanningTransitions[] = {
+    /* Possibly need to initialize a timer to make sure the beacon
+     * signal is steady. Will need to test out. */
+    {BEACON_FOUND_EVENT, HSM_ANY_PARAM, FollowBeacon, NULL, NULL},
+};
+
+static const HSM_Transition_t FollowBeaconTransitions[] = {
+    /*
+     * If we end up utilizing timers for the above case, we will need
+     * a separate timer to keep track of tape following time.
+     */
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TapeFollowing, NULL, NULL},
+    {FR_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TapeFollowing, NULL, NULL},
+};
+
+static const HSM_Transition_t TapeFollowingTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, BeaconScanning, NULL, NULL},
+};
+
+static const HSM_Transition_t PrepForScanTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, BeaconScanning, NULL, NULL},
+};
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [BeaconScanning] =
+    {EnterBeaconScanning, NULL, NULL, NULL, HSM_TRANSITIONS(BeaconScanningTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(BEACON_FOUND_EVENT)},
+    [FollowBeacon] =
+    {EnterFollowBeacon, NULL, NULL, NULL, HSM_TRANSITIONS(FollowBeaconTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT)},
+    [TapeFollowing] =
+    {EnterTapeFollowing, NULL, &TapeFollowingSubSubHSM, InitTapeFollowingSubSubHSM,
+        HSM_TRANSITIONS(TapeFollowingTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [PrepForScan] =
+    {EnterPrepForScan, NULL, NULL, NULL, HSM_TRANSITIONS(PrepForScanTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t ProjectBeaconFindingSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -95,6 +159,9 @@ uint8_t InitProjectBeaconFindingSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&ProjectBeaconFindingSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunProjectBeaconFindingSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -118,101 +185,8 @@ uint8_t InitProjectBeaconFindingSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunProjectBeaconFindingSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    ProjectBeaconFindingSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-                //Initialize all sub sub-state machines
-                InitTapeFollowingSubSubHSM();
-
-                // now put the machine into the actual initial state
-                nextState = BeaconScanning;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-                //ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-            }
-            break;
-
-        case BeaconScanning: // in the first state, replace this with correct names
-            //Tank Right here until a beacon is found.
-            TankRight(50);
-            if (ThisEvent.EventType == BEACON_FOUND_EVENT) {
-                /* Possibly need to initialize a timer to make sure the beacon
-                 * signal is steady. Will need to test out.
-                 * ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-                 * ES_Timer_InitTimer(SUB_TRANSITION_TIMER, EIGHTH_SECOND_TICKS);
-                 */
-                //ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-                nextState = FollowBeacon;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-        case FollowBeacon:
-            //Drive straight until you hit tape, a beacon tower, or no longer see the beacon.
-            DriveStraight(100);
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                /*
-                 * If we end up utilizing timers for the above case, we will need
-                 * a separate timer to keep track of tape following time.
-                 */
-                //DriveStraight(-80);
-                
-                nextState = TapeFollowing;
-                InitTapeFollowingSubSubHSM();
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            /*
-            if ((ThisEvent.EventType == NO_BEACON_EVENT)){
-                nextState = BeaconScanning;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }*/
-            break;
-
-        case TapeFollowing:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-                //Test out how much time is sufficient to be in tape following.
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, TAPE_FOLLOW_TICKS);
-            }
-            ThisEvent = RunTapeFollowingSubSubHSM(ThisEvent);
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)){
-                nextState = BeaconScanning;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case PrepForScan:
-            TankLeft(100);
-            if (ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == SUB_TRANSITION_TIMER) {
-                nextState = BeaconScanning;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunProjectBeaconFindingSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunProjectBeaconFindingSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&ProjectBeaconFindingSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -222,3 +196,21 @@ ES_Event RunProjectBeaconFindingSubHSM(ES_Event ThisEvent) {
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+//Tank Right here until a beacon is found.
+static void EnterBeaconScanning(void) {
+    TankRight(50);
+}
+
+//Drive straight until you hit tape, a beacon tower, or no longer see the beacon.
+static void EnterFollowBeacon(void) {
+    DriveStraight(100);
+}
+
+static void EnterTapeFollowing(void) {
+    //Test out how much time is sufficient to be in tape following.
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, TAPE_FOLLOW_TICKS);
+}
+
+static void EnterPrepForScan(void) {
+    TankLeft(100);
+}
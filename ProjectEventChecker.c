@@ -42,6 +42,9 @@
 #include "IO_Ports.h"
 #include "LED.h"
 #include "RC_Servo.h"
+#include "Stepper.h"
+#include "TimerWheel.h"
+#include "ES_Timers.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -355,6 +358,33 @@ uint8_t LeftBallTapeChecker(void) {
     return (returnVal);
 }
 
+uint8_t StepperDoneChecker(void) {
+    static uint8_t wasStepping = FALSE;
+    ES_Event thisEvent;
+    uint8_t returnVal = FALSE;
+
+    //Only the falling edge of stepping is an event.
+    uint8_t isStepping = Stepper_IsStepping();
+
+    if (wasStepping && !isStepping) {
+        thisEvent.EventType = STEPPER_DONE_EVENT;
+        thisEvent.EventParam = Stepper_GetDirection();
+        returnVal = TRUE;
+#ifndef EVENTCHECKER_TEST           // keep this as is for test harness
+        PostProjectHSM(thisEvent);
+#else
+        SaveEvent(thisEvent);
+#endif
+    }
+    wasStepping = isStepping;
+    return (returnVal);
+}
+
+uint8_t TimerWheelChecker(void) {
+    //The timers post their own timeouts, the test harness sees them there.
+    return TimerWheel_Update(ES_Timer_GetTime());
+}
+
 /* 
  * The Test Harness for the event checkers is conditionally compiled using
  * the EVENTCHECKER_TEST macro (defined either in the file or at the project level).
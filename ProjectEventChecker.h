@@ -28,6 +28,7 @@
 
 #include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
 #include "BOARD.h"
+#include "Idle.h"          // IdleChecker, last in EVENT_CHECK_LIST
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
@@ -127,6 +128,26 @@ uint8_t BCTapeChecker(void);
 uint8_t LeftBallTapeChecker(void);
 
 
+/**
+ * @Function StepperDoneChecker(void)
+ * @param none
+ * @return TRUE or FALSE
+ * @brief This function is an event checker that watches the Stepper module and
+ *        posts STEPPER_DONE_EVENT when a move stops stepping, either because it ran
+ *        out of steps or was stopped. The parameter is the direction of the move
+ *        (FORWARD or REVERSE). Returns TRUE if there was an event, FALSE otherwise. */
+uint8_t StepperDoneChecker(void);
+
+/**
+ * @Function TimerWheelChecker(void)
+ * @param none
+ * @return TRUE or FALSE
+ * @brief This function is an event checker that turns the TimerWheel up to the
+ *        current time. Each timer that expires posts its own ES_TIMEOUT. Returns
+ *        TRUE if any timer expired, FALSE otherwise. */
+uint8_t TimerWheelChecker(void);
+
+
 
 /**
  * @Function RightBallTapeChecker(void)
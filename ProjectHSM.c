@@ -41,6 +41,11 @@
 #include "FindingCorrectHoleSubHSM.h"
 #include "DispenseBallSubHSM.h"
 #include "Bot.h"
+#include "HSM_Engine.h"
+#include "QueueStats.h"
+#include "EventLanes.h"
+#include "EventRecorder.h"
+#include "Latency.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -54,6 +59,19 @@
 #define WIRE_CONFIRM_TICKS 8500
 #define THREE_SECOND_TICKS 3000
 
+//a run moves what was posted straight to the queue into the lanes, a lane has
+//to be able to take a queue full of it
+#if EVENT_LANE_SIZE < SERV_2_QUEUE_SIZE
+#error "EVENT_LANE_SIZE has to hold everything SERV_2_QUEUE_SIZE can"
+#endif
+
+//Shows the top level state (binary, LEDs 0-3) and the number of events waiting
+//in this machine's queue (bar, LEDs 4-11) on the light bar
+//#define PROJECT_HSM_LED_TELEMETRY
+#define TELEMETRY_STATE_MASK 0x0F
+#define TELEMETRY_DEPTH_SHIFT 4
+#define TELEMETRY_MAX_DEPTH 8
+
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
  ******************************************************************************/
@@ -80,6 +98,7 @@ static const char *StateNames[] = {
 	"FindingCorrectHole",
 	"DispenseBall",
 };
+STATE_STATS_DECLARE(Stats, "ProjectHSM", StateNames);
 
 
 /*******************************************************************************
@@ -88,14 +107,111 @@ static const char *StateNames[] = {
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine
    Example: char RunAway(uint_8 seconds);*/
+static uint8_t BumpersReleased(const ES_Event *ThisEvent);
+#ifdef PROJECT_HSM_LED_TELEMETRY
+static void ShowTelemetry(void);
+#endif
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
  ******************************************************************************/
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static ProjectHSMState_t CurrentState = InitPState; // <- change enum name to match ENUM
+static uint8_t CurrentState = InitPState; // a ProjectHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
+//what is in the framework queue that RunProjectHSM has not seen yet, and how
+//full it has got
+static QueueStats_t Queue;
+//the events themselves, bumps and tape edges in a lane that runs first. The
+//queue only holds one LANE_WAKE_EVENT for them, posted when the lanes stop
+//being empty, and the run it wakes takes them all
+static EventLanes_t Lanes;
+static const ES_EventTyp_t UrgentEvents[] = {
+    SERV_2_URGENT_EVENTS
+};
+static const ES_Event WakeEvent = {LANE_WAKE_EVENT, 0};
+//sub-HSMs that have been started, for the states that resume theirs
+static uint32_t SubsStarted;
+//events the current state had no use for, dropped when posted or run
+static uint32_t Ignored;
+//TRUE while RunProjectHSM empties the lanes, what is posted meanwhile gets run too
+static uint8_t Running;
+#ifdef PROJECT_HSM_LED_TELEMETRY
+static uint16_t LastTelemetry = 0xFFFF;
+#endif
+
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. Each state runs its sub-HSM first. A
+ * sub-HSM is started when its state is entered, so none run before they are
+ * needed. Flag a state HSM_HISTORY to have it pick up its sub-HSM where it left
+ * off instead of starting it over. The states with a sub-HSM take every event,
+ * HSM_Verify narrows that to their rows and what their sub-HSM's states want. */
+static const HSM_Transition_t InitPTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, BeaconFinding, NULL, NULL},
+};
+
+static const HSM_Transition_t BeaconFindingTransitions[] = {
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, WallFollowing, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, WallFollowing, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, WallFollowing, NULL, NULL},
+};
+
+//Took out FR_TAPE for now.
+static const HSM_Transition_t WallFollowingTransitions[] = {
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, StayingInBoundsTower, NULL, NULL},
+    {CORRECT_WALL_DETECTED_EVENT, HSM_ANY_PARAM, GetParallel, NULL, NULL},
+};
+
+static const HSM_Transition_t StayingInBoundsTowerTransitions[] = {
+    {WALL_DETECTED_EVENT, HSM_ANY_PARAM, WallFollowing, NULL, NULL},
+};
+
+//Moves on once parallel, or as soon as the bumpers come off the wall
+static const HSM_Transition_t GetParallelTransitions[] = {
+    {GOT_PARALLEL_EVENT, HSM_ANY_PARAM, FindingCorrectHole, NULL, NULL},
+    {HSM_ANY_EVENT, HSM_ANY_PARAM, FindingCorrectHole, BumpersReleased, NULL},
+};
+
+static const HSM_Transition_t FindingCorrectHoleTransitions[] = {
+    {CORRECT_HOLE_FOUND_EVENT, HSM_ANY_PARAM, DispenseBall, NULL, NULL},
+};
+
+static const HSM_Transition_t DispenseBallTransitions[] = {
+    {BALL_DISPENSED_EVENT, HSM_ANY_PARAM, BeaconFinding, NULL, NULL},
+};
+
+static const HSM_State_t States[] = {
+    [InitPState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPTransitions), HSM_NO_STATE, 0, HSM_EVENT(ES_INIT)},
+    [InitialState] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [BeaconFinding] =
+    {NULL, NULL, &ProjectBeaconFindingSubHSM, InitProjectBeaconFindingSubHSM,
+        HSM_TRANSITIONS(BeaconFindingTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [WallFollowing] =
+    {NULL, NULL, &WallFollowingSubHSM, InitWallFollowingSubHSM,
+        HSM_TRANSITIONS(WallFollowingTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [StayingInBoundsTower] =
+    {NULL, NULL, &StayingInBoundsTowerSubHSM, InitStayingInBoundsTowerSubHSM,
+        HSM_TRANSITIONS(StayingInBoundsTowerTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [GetParallel] =
+    {NULL, NULL, &GetParallelSubHSM, InitGetParallelSubHSM,
+        HSM_TRANSITIONS(GetParallelTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [FindingCorrectHole] =
+    {NULL, NULL, &FindingCorrectHoleSubHSM, InitFindingCorrectHoleSubHSM,
+        HSM_TRANSITIONS(FindingCorrectHoleTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+    [DispenseBall] =
+    {NULL, NULL, &DispenseBallSubHSM, InitDispenseBallSubHSM,
+        HSM_TRANSITIONS(DispenseBallTransitions), HSM_NO_STATE, 0, HSM_ALL_EVENTS},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+static const HSM_Machine_t Machine = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, &SubsStarted, &Ignored,
+    STATE_STATS_OF(Stats), Rows
+};
 
 
 /*******************************************************************************
@@ -117,12 +233,16 @@ uint8_t InitProjectHSM(uint8_t Priority)
     MyPriority = Priority;
     // put us into the Initial PseudoState
     CurrentState = InitPState;
-    // post the initial transition event
-    if (ES_PostToService(MyPriority, INIT_EVENT) == TRUE) {
-        return TRUE;
-    } else {
+    QueueStats_Init(&Queue, Priority);
+    EventLanes_Init(&Lanes, UrgentEvents, sizeof(UrgentEvents) / sizeof(UrgentEvents[0]));
+    SubsStarted = 0;
+    Ignored = 0;
+    if (HSM_Verify(&Machine) == ERROR) {
         return FALSE;
     }
+    // post the initial transition event
+    EventLanes_Push(&Lanes, INIT_EVENT);
+    return QueueStats_Post(&Queue, WakeEvent);
 }
 
 /**
@@ -136,213 +256,103 @@ uint8_t InitProjectHSM(uint8_t Priority)
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t PostProjectHSM(ES_Event ThisEvent)
 {
-    return ES_PostToService(MyPriority, ThisEvent);
+    uint8_t wake;
+
+    RECORD_POST(ThisEvent);
+    // with nothing queued ahead of it the event runs in the current state, so
+    // one that state would ignore does not need a queue slot
+    if ((Queue.depth == 0) && (Running == FALSE) && !HSM_Wants(&Machine, ThisEvent.EventType)) {
+        Ignored++;
+        return TRUE;
+    }
+    // only the first event into empty lanes needs a wake, the run it wakes
+    // takes the rest too
+    wake = (EventLanes_Count(&Lanes) == 0) && (Running == FALSE);
+    if (EventLanes_Push(&Lanes, ThisEvent) == ERROR) {
+        Queue.lastDropped = ThisEvent;
+        return FALSE;
+    }
+    // if the queue is too full to take the wake, the runs of what fills it
+    // empty the lanes as well
+    if (wake == TRUE) {
+        QueueStats_Post(&Queue, WakeEvent);
+    }
+    return TRUE;
+}
+
+/**
+ * @Function GetProjectHSMIgnored(void)
+ * @param None.
+ * @return number of events since InitProjectHSM that the state they arrived in
+ *         had no use for, and so were never queued or never reached a sub-HSM
+ */
+uint32_t GetProjectHSMIgnored(void)
+{
+    return Ignored;
+}
+
+/**
+ * @Function GetProjectHSMQueueStats(void)
+ * @param None.
+ * @return the depth, high-water mark and overflows of this machine's queue
+ */
+const QueueStats_t *GetProjectHSMQueueStats(void)
+{
+    return &Queue;
+}
+
+/**
+ * @Function GetProjectHSMLanes(void)
+ * @param None.
+ * @return the queued events, and how often and how far urgent ones went ahead
+ *         of the rest
+ */
+const EventLanes_t *GetProjectHSMLanes(void)
+{
+    return &Lanes;
 }
 
 /**
  * @Function RunTemplateHSM(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
- * @return Event - return event (type and param), in general should be ES_NO_EVENT
- * @brief This function is where you implement the whole of the heirarchical state
- *        machine, as this is called any time a new event is passed to the event
- *        queue. This function will be called recursively to implement the correct
- *        order for a state transition to be: exit current state -> enter next state
- *        using the ES_EXIT and ES_ENTRY events.
- * @note Remember to rename to something appropriate.
- *       The lower level state machines are run first, to see if the event is dealt
+ * @return Event - what the machine handed back from the last event it ran
+ * @brief This function is called any time a new event is passed to the event
+ *        queue, and runs every event waiting in the lanes through the machine.
+ *        The machine itself is the States table above, HSM_Run does the
+ *        transitions in the order: exit current state -> enter next state.
+ * @note The lower level state machines are run first, to see if the event is dealt
  *       with there rather than at the current level. ES_EXIT and ES_ENTRY events are
  *       not consumed as these need to pass pack to the higher level state machine.
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunProjectHSM(ES_Event ThisEvent)
 {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    ProjectHSMState_t nextState; // <- change type to correct enum
     ES_Tattle(); // trace call stack
-    switch (CurrentState) {
-    case InitPState: // If current state is initial Pseudo State
-        if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-        {
-            // this is where you would put any actions associated with the
-            // transition from the initial pseudo-state into the actual
-            // initial state
-            // Initialize all sub-state machines
-//            InitProjectInitialSubHSM();
-            InitProjectBeaconFindingSubHSM();
-            //InitTapeFollowingSubSubHSM();
-            InitWallFollowingSubHSM();
-            InitStayingInBoundsTowerSubHSM();
-            InitGetParallelSubHSM();
-            InitFindingCorrectHoleSubHSM();
-            InitDispenseBallSubHSM();
-            // now put the machine into the actual initial state
-//            ES_Timer_InitTimer(TOP_TRANSITION_TIMER, TWO_SECOND_TICKS);
-            nextState = BeaconFinding;
-            makeTransition = TRUE;
-            ThisEvent.EventType = ES_NO_EVENT;
-        }
-            break;
-
-//        case InitialState: // in the first state, replace this with correct names
-//            // run sub-state machine for this state
-//            //NOTE: the SubState Machine runs and responds to events before anything in the this
-//            //state machine does
-//            ThisEvent = RunProjectInitialSubHSM(ThisEvent);
-//            switch (ThisEvent.EventType) {
-//                case ES_NO_EVENT:
-//                    break;
-//
-//                case ES_TIMEOUT:
-//                    ES_Timer_StopTimer(TOP_TRANSITION_TIMER);
-//                    nextState = BeaconFinding;
-//                    makeTransition = TRUE;
-//                    ThisEvent.EventType = ES_NO_EVENT;
-//                    break;
-//            }
-//            break;
-            
-        case BeaconFinding:
-            ThisEvent = RunProjectBeaconFindingSubHSM(ThisEvent);
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) || 
-                (ThisEvent.EventType == FR_BUMP_EVENT) ||
-                 ThisEvent.EventType == FC_BUMP_EVENT){
-                nextState = WallFollowing;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case WallFollowing:
-            ThisEvent = RunWallFollowingSubHSM(ThisEvent);
-            if (ThisEvent.EventType == ES_ENTRY){
-//                ES_Timer_StopTimer(TOP_TRANSITION_TIMER);
-            }
-            //Took out FR_TAPE for now.
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT)){
-                nextState = StayingInBoundsTower;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            /*This will currently transition right when track wire is detected.
-             * Need to find a way to confirm track wire. Maybe set a timer?
-             */ 
-            if (ThisEvent.EventType == CORRECT_WALL_DETECTED_EVENT){
-                nextState = GetParallel;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-//            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-//                
-//
-////                if (wireCounter == 1) {
-////                    ES_Timer_InitTimer(TOP_TRANSITION_TIMER, WIRE_CONFIRM_TICKS);
-////                }
-////                if (wireCounter == 7) {
-////                    nextState = GetParallel;
-////                    makeTransition = TRUE;
-////                    ThisEvent.EventType = ES_NO_EVENT;
-////                }
-//              }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == TOP_TRANSITION_TIMER)) {
-//                nextState = GetParallel;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-            /* Previous Code.
-            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT){
-                //Originally is two seconds.
-                ES_Timer_InitTimer(TOP_TRANSITION_TIMER, WIRE_CONFIRM_TICKS);
-            }
-            if (ThisEvent.EventType == NO_TRACK_WIRE_EVENT){
-                ES_Timer_StopTimer(TOP_TRANSITION_TIMER);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == TOP_TRANSITION_TIMER)){
-                nextState = GetParallel;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }*/
-            break;
-            
-        case StayingInBoundsTower:
-            ThisEvent = RunStayingInBoundsTowerSubHSM(ThisEvent); 
-            if (ThisEvent.EventType == WALL_DETECTED_EVENT){
-                nextState = WallFollowing;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case GetParallel:
-            //printf("At GetParallel but before entering EEEEEEEEEEEEEEEEEEEEEEEEEEEEE\r\n");
-            ThisEvent = RunGetParallelSubHSM(ThisEvent);
-            //printf("In GetParallel IIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIII\r\n");
-            if (ThisEvent.EventType == GOT_PARALLEL_EVENT){
-                nextState = FindingCorrectHole;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if (Bot_ReadBumpers() == 0){
-                nextState = FindingCorrectHole;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case FindingCorrectHole:
-            ThisEvent = RunFindingCorrectHoleSubHSM(ThisEvent);
-            if (ThisEvent.EventType == CORRECT_HOLE_FOUND_EVENT){
-                nextState = DispenseBall;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case DispenseBall:
-            ThisEvent = RunDispenseBallSubHSM(ThisEvent);
-            if (ThisEvent.EventType == BALL_DISPENSED_EVENT){
-                nextState = BeaconFinding;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-    default: // all unhandled states fall into here
-        break;
-    } // end switch on Current State
-
-    
-    
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunProjectHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunProjectHSM(ENTRY_EVENT); // <- rename to your own Run function
-        if(nextState == InitPState){
-            
-        }
-//    if(nextState ==InitialState){
-//        InitProjectInitialSubHSM();
-//    }
-        if(nextState == BeaconFinding){
-            InitProjectBeaconFindingSubHSM();
-        }
-        else if(nextState == WallFollowing){
-            InitWallFollowingSubHSM();
-        }
-        else if(nextState == StayingInBoundsTower){
-            InitStayingInBoundsTowerSubHSM();
-        }
-        else if(nextState == GetParallel){
-            InitGetParallelSubHSM();
+    RECORD_RUN(ThisEvent);
+    QueueStats_Run(&Queue, ThisEvent);
+    if ((ThisEvent.EventType == ES_ENTRY) || (ThisEvent.EventType == ES_EXIT)) {
+        ThisEvent = HSM_Run(&Machine, ThisEvent);
+    } else {
+        // ES_PostAll and the keyboard post straight to the queue, those events
+        // join the lanes here. Either way the run takes every event in the
+        // lanes, urgent ones first, and any the machine posts meanwhile
+        Running = TRUE;
+        if ((ThisEvent.EventType != LANE_WAKE_EVENT) &&
+                (EventLanes_Push(&Lanes, ThisEvent) == ERROR)) {
+            Queue.lastDropped = ThisEvent;
         }
-        else if(nextState == FindingCorrectHole){
-            InitFindingCorrectHoleSubHSM();
+        while (EventLanes_Pop(&Lanes, &ThisEvent) == SUCCESS) {
+            Latency_Open(ThisEvent.EventType, Lanes.poppedAt);
+            ThisEvent = HSM_Run(&Machine, ThisEvent);
+            Latency_Close();
         }
-        else if(nextState == DispenseBall){
-            InitDispenseBallSubHSM();
-        } 
+        Running = FALSE;
     }
+    RECORD_RUN_DONE();
 
+#ifdef PROJECT_HSM_LED_TELEMETRY
+    ShowTelemetry();
+#endif
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -351,3 +361,34 @@ ES_Event RunProjectHSM(ES_Event ThisEvent)
 /*******************************************************************************
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
+
+static uint8_t BumpersReleased(const ES_Event *ThisEvent)
+{
+    return Bot_ReadBumpers() == 0;
+}
+
+#ifdef PROJECT_HSM_LED_TELEMETRY
+
+/**
+ * @Function ShowTelemetry(void)
+ * @param None.
+ * @return None.
+ * @brief Puts the current state and queue depth on the light bar. The LEDs are
+ *        only written when the picture changes, so most events cost one compare.
+ */
+static void ShowTelemetry(void)
+{
+    uint8_t depth = Queue.depth;
+    uint16_t pattern;
+
+    if (depth > TELEMETRY_MAX_DEPTH) {
+        depth = TELEMETRY_MAX_DEPTH;
+    }
+    pattern = (CurrentState & TELEMETRY_STATE_MASK) |
+            (((1 << depth) - 1) << TELEMETRY_DEPTH_SHIFT);
+    if (pattern != LastTelemetry) {
+        Bot_LEDSSet(pattern);
+        LastTelemetry = pattern;
+    }
+}
+#endif
@@ -26,6 +26,8 @@
  ******************************************************************************/
 
 #include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "QueueStats.h"
+#include "EventLanes.h"
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
@@ -65,6 +67,30 @@ uint8_t InitProjectHSM(uint8_t Priority);
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t PostProjectHSM(ES_Event ThisEvent);
 
+/**
+ * @Function GetProjectHSMIgnored(void)
+ * @param None.
+ * @return number of events since InitProjectHSM that the state they arrived in
+ *         had no use for, dropped by its interest mask when posted or run
+ */
+uint32_t GetProjectHSMIgnored(void);
+
+/**
+ * @Function GetProjectHSMQueueStats(void)
+ * @param None.
+ * @return the depth, high-water mark, overflow count and last dropped event of
+ *         this machine's queue
+ */
+const QueueStats_t *GetProjectHSMQueueStats(void);
+
+/**
+ * @Function GetProjectHSMLanes(void)
+ * @param None.
+ * @return the events waiting in this machine's urgent and normal lanes, and how
+ *         often and how many in a row urgent events overtook the others
+ */
+const EventLanes_t *GetProjectHSMLanes(void);
+
 
 
 
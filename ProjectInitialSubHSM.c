@@ -31,6 +31,8 @@
 #include "BOARD.h"
 #include "ProjectHSM.h"
 #include "ProjectInitalSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -46,6 +48,7 @@ static const char *StateNames[] = {
 	"InitBeaconScanning",
 	"InitFollowBeacon",
 };
+STATE_STATS_DECLARE(Stats, "ProjectInitialSubHSM", StateNames);
 
 //Include any defines you need to do
 
@@ -55,6 +58,8 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void EnterInitBeaconScanning(void);
+static void EnterInitFollowBeacon(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -62,9 +67,43 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static ProjectInitialSubHSMState_t CurrentState = InitInitialPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitInitialPSubState; // a ProjectInitialSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitInitialPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, InitBeaconScanning, NULL, NULL},
+};
+
+static const HSM_Transition_t InitBeaconScanningTransitions[] = {
+    {BEACON_FOUND_EVENT, HSM_ANY_PARAM, InitFollowBeacon, NULL, NULL},
+};
+
+static const HSM_Transition_t InitFollowBeaconTransitions[] = {
+    {NO_BEACON_EVENT, HSM_ANY_PARAM, InitBeaconScanning, NULL, NULL},
+};
+
+static const HSM_State_t States[] = {
+    [InitInitialPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitInitialPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [InitBeaconScanning] =
+    {EnterInitBeaconScanning, NULL, NULL, NULL, HSM_TRANSITIONS(InitBeaconScanningTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(BEACON_FOUND_EVENT)},
+    [InitFollowBeacon] =
+    {EnterInitFollowBeacon, NULL, NULL, NULL, HSM_TRANSITIONS(InitFollowBeaconTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(NO_BEACON_EVENT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t ProjectInitialSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -85,6 +124,9 @@ uint8_t InitProjectInitialSubHSM(void)
     ES_Event returnEvent;
 
     CurrentState = InitInitialPSubState;
+    if (HSM_Verify(&ProjectInitialSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunProjectInitialSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -109,63 +151,8 @@ uint8_t InitProjectInitialSubHSM(void)
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunProjectInitialSubHSM(ES_Event ThisEvent)
 {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    ProjectInitialSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-    case InitInitialPSubState: // If current state is initial Psedudo State
-        if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-        {
-            // this is where you would put any actions associated with the
-            // transition from the initial pseudo-state into the actual
-            // initial state
-
-            // now put the machine into the actual initial state
-            nextState = InitBeaconScanning;
-            makeTransition = TRUE;
-            ThisEvent.EventType = ES_NO_EVENT;
-            //ES_Timer_InitTimer(TOP_TRANSITION_TIMER, ONE_POINT_FIVE_SECOND_TICKS);
-        }
-        break;
-
-    case InitBeaconScanning: // in the first state, replace this with correct names
-        //Tank Turn clockwise (right) until we hit a beacon.
-        TankRight(75);
-        if (ThisEvent.EventType == BEACON_FOUND_EVENT){
-            nextState = InitFollowBeacon;
-            makeTransition = TRUE;
-            ThisEvent.EventType = ES_NO_EVENT;
-            /*ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-            ES_Timer_InitTimer(SUB_TRANSITION_TIMER, ONE_POINT_FIVE_SECOND_TICKS);*/
-        }
-        break;
-        
-    case InitFollowBeacon:
-        DriveStraight(100);
-        if (ThisEvent.EventType == NO_BEACON_EVENT){
-            nextState = InitBeaconScanning;
-            makeTransition = TRUE;
-            ThisEvent.EventType = ES_NO_EVENT;
-            //ES_Timer_StopTimer(SUB_TRANSITION_TIMER);
-        }
-        /*
-        if (ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == 2){
-            ThisEvent.EventType = INITIAL_STATE_DONE_EVENT;
-        }*/
-        break;
-    default: // all unhandled states fall into here
-        break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunProjectInitialSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunProjectInitialSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&ProjectInitialSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -175,3 +162,13 @@ ES_Event RunProjectInitialSubHSM(ES_Event ThisEvent)
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+//Tank Turn clockwise (right) until we hit a beacon.
+static void EnterInitBeaconScanning(void)
+{
+    TankRight(75);
+}
+
+static void EnterInitFollowBeacon(void)
+{
+    DriveStraight(100);
+}
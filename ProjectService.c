@@ -24,6 +24,7 @@
 #include "ES_Framework.h"
 #include "ProjectService.h"
 #include "Bot.h"
+#include "QueueStats.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -47,6 +48,7 @@ int i = 0;
  * as well. */
 
 static uint8_t MyPriority;
+static QueueStats_t Queue;
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -76,6 +78,7 @@ uint8_t InitBumperService(uint8_t Priority)
     ES_Event ThisEvent;
 
     MyPriority = Priority;
+    QueueStats_Init(&Queue, Priority);
 
     // in here you write your initialization code
     // this includes all hardware and software initialization
@@ -84,7 +87,7 @@ uint8_t InitBumperService(uint8_t Priority)
     // post the initial transition event
     ES_Timer_InitTimer(BUMPER_SIMPLE_SERVICE_TIMER, TIMER_0_TICKS);
     ThisEvent.EventType = ES_INIT;
-    if (ES_PostToService(MyPriority, ThisEvent) == TRUE) {
+    if (QueueStats_Post(&Queue, ThisEvent) == TRUE) {
         return TRUE;
     } else {
         return FALSE;
@@ -102,7 +105,17 @@ uint8_t InitBumperService(uint8_t Priority)
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t PostBumperService(ES_Event ThisEvent)
 {
-    return ES_PostToService(MyPriority, ThisEvent);
+    return QueueStats_Post(&Queue, ThisEvent);
+}
+
+/**
+ * @Function GetBumperServiceQueueStats(void)
+ * @param None.
+ * @return the depth, high-water mark and overflows of this service's queue
+ */
+const QueueStats_t *GetBumperServiceQueueStats(void)
+{
+    return &Queue;
 }
 
 /**
@@ -135,6 +148,7 @@ ES_Event RunBumperService(ES_Event ThisEvent)
     ES_EventTyp_t FCcurEvent;
     unsigned char Debounce[4];
 
+    QueueStats_Run(&Queue, ThisEvent);
     switch (ThisEvent.EventType) {
         case ES_INIT:
             // No hardware initialization or single time setups, those
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "QueueStats.h"
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                             *
@@ -62,6 +63,14 @@ uint8_t InitBumperService(uint8_t Priority);
  * @author J. Edward Carryer, 2011.10.23 19:25 */
 uint8_t PostBumperService(ES_Event ThisEvent);
 
+/**
+ * @Function GetBumperServiceQueueStats(void)
+ * @param None.
+ * @return the depth, high-water mark, overflow count and last dropped event of
+ *         this service's queue
+ */
+const QueueStats_t *GetBumperServiceQueueStats(void);
+
 /**
  * @Function RunTemplateService(ES_Event ThisEvent)
  * @param ThisEvent - the event (type and param) to be responded.
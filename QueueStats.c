@@ -0,0 +1,184 @@
+/*
+ * File:   QueueStats.c
+ *
+ * Service queue bookkeeping and the host replay tool for sizing the queues, see
+ * QueueStats.h.
+ */
+
+#include <stdio.h>
+#include "ES_Configure.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define QUEUE_STATS_REPLAY
+
+#ifndef QUEUE_STATS_REPLAY
+
+#include "BOARD.h"
+#include "ES_Framework.h"
+#include "QueueStats.h"
+
+#define MAX_OVERFLOWS 0xFFFF
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void QueueStats_Init(QueueStats_t *stats, uint8_t Priority)
+{
+    stats->priority = Priority;
+    stats->depth = 0;
+    stats->highWater = 0;
+    stats->overflows = 0;
+    stats->lastDropped.EventType = ES_NO_EVENT;
+    stats->lastDropped.EventParam = 0;
+}
+
+uint8_t QueueStats_Post(QueueStats_t *stats, ES_Event ThisEvent)
+{
+    uint8_t posted = ES_PostToService(stats->priority, ThisEvent);
+
+    if (posted == TRUE) {
+        stats->depth++;
+        if (stats->depth > stats->highWater) {
+            stats->highWater = stats->depth;
+        }
+    } else {
+        if (stats->overflows < MAX_OVERFLOWS) {
+            stats->overflows++;
+        }
+        stats->lastDropped = ThisEvent;
+    }
+#ifdef QUEUE_STATS_LOG
+    printf("Q+%u %u %u\r\n", stats->priority, ThisEvent.EventType, posted);
+#endif
+    return posted;
+}
+
+void QueueStats_Run(QueueStats_t *stats, ES_Event ThisEvent)
+{
+    if ((ThisEvent.EventType == ES_ENTRY) || (ThisEvent.EventType == ES_EXIT)) {
+        return;
+    }
+    // ES_PostAll and the keyboard post straight to the queue, past the count
+    if (stats->depth > 0) {
+        stats->depth--;
+    }
+#ifdef QUEUE_STATS_LOG
+    printf("Q-%u\r\n", stats->priority);
+#endif
+}
+
+void QueueStats_Print(const char *name, const QueueStats_t *stats)
+{
+    printf("%s queue: depth %u, deepest %u, %u dropped", name, stats->depth,
+            stats->highWater, stats->overflows);
+    if (stats->overflows > 0) {
+        printf(", last %s %u", EventNames[stats->lastDropped.EventType],
+                stats->lastDropped.EventParam);
+    }
+    printf("\r\n");
+}
+
+#else
+
+/*******************************************************************************
+ * REPLAY TOOL                                                                 *
+ ******************************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#define LINE_LENGTH 128
+
+// what ES_Configure.h gives each service now, to compare against
+static const uint8_t configuredSize[] = {
+    SERV_0_QUEUE_SIZE,
+#if NUM_SERVICES > 1
+    SERV_1_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 2
+    SERV_2_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 3
+    SERV_3_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 4
+    SERV_4_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 5
+    SERV_5_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 6
+    SERV_6_QUEUE_SIZE,
+#endif
+#if NUM_SERVICES > 7
+    SERV_7_QUEUE_SIZE,
+#endif
+};
+
+static uint32_t posts[MAX_NUM_SERVICES];
+static uint32_t refused[MAX_NUM_SERVICES];
+static uint16_t depth[MAX_NUM_SERVICES];
+static uint16_t needed[MAX_NUM_SERVICES];
+
+/**
+ * @Function main(void)
+ * @brief Reads a QUEUE_STATS_LOG capture on stdin, other lines are skipped, and
+ *        replays the posts and runs against unbounded queues. A queue needs to
+ *        be as deep as the most events it ever held. A post that was refused in
+ *        the capture needed one more slot than the queue held then, but what
+ *        it would have done after is not in the capture, so the answer is only
+ *        a lower bound when anything was refused.
+ */
+int main(void)
+{
+    char line[LINE_LENGTH];
+    char *record;
+    unsigned int queue, event, accepted;
+    uint16_t need;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        if ((record = strstr(line, "Q+")) != NULL) {
+            if ((sscanf(record, "Q+%u %u %u", &queue, &event, &accepted) != 3) ||
+                    (queue >= MAX_NUM_SERVICES)) {
+                continue;
+            }
+            posts[queue]++;
+            if (accepted) {
+                depth[queue]++;
+                need = depth[queue];
+            } else {
+                refused[queue]++;
+                need = depth[queue] + 1;
+            }
+            if (need > needed[queue]) {
+                needed[queue] = need;
+            }
+        } else if ((record = strstr(line, "Q-")) != NULL) {
+            if ((sscanf(record, "Q-%u", &queue) == 1) && (queue < MAX_NUM_SERVICES) &&
+                    (depth[queue] > 0)) {
+                depth[queue]--;
+            }
+        }
+    }
+
+    for (queue = 0; queue < MAX_NUM_SERVICES; queue++) {
+        if (posts[queue] == 0) {
+            continue;
+        }
+        printf("SERV_%u_QUEUE_SIZE: %lu posts, needs %s%u", queue, (unsigned long) posts[queue],
+                refused[queue] ? "at least " : "", needed[queue]);
+        if (queue < sizeof(configuredSize)) {
+            printf(", configured %u", configuredSize[queue]);
+        }
+        if (refused[queue]) {
+            printf(", %lu refused in the capture, record again with a bigger queue",
+                    (unsigned long) refused[queue]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+#endif // QUEUE_STATS_REPLAY
@@ -0,0 +1,92 @@
+/*
+ * File:   QueueStats.h
+ *
+ * Bookkeeping for the ES_Framework service queues. ES_PostToService returns
+ * FALSE when a queue is full and the event is gone, nothing else notices. A
+ * service that posts and runs through these functions keeps its queue depth,
+ * the deepest it has been, how many posts were refused and the last event that
+ * was, all readable while the robot runs.
+ *
+ * Use, in a service:
+ *   static QueueStats_t Queue;
+ *   Init:  QueueStats_Init(&Queue, Priority); QueueStats_Post(&Queue, INIT_EVENT);
+ *   Post:  return QueueStats_Post(&Queue, ThisEvent);
+ *   Run:   QueueStats_Run(&Queue, ThisEvent); first thing
+ * and give the rest of the code a getter for &Queue.
+ *
+ * Sizing queues from data: #define QUEUE_STATS_LOG below and every post and run
+ * is printed as a "Q+" or "Q-" line. Record a run over the serial port with the
+ * SERV_x_QUEUE_SIZEs in ES_Configure.h turned up so nothing is dropped, then
+ * build this file on the host with QUEUE_STATS_REPLAY and feed it the capture:
+ *   gcc -DQUEUE_STATS_REPLAY -I. QueueStats.c -o replay && ./replay < capture.txt
+ * It prints the smallest queue size that would have held every event.
+ *
+ * QUEUE_STATS_REPLAY (in the .c file) conditionally compiles the replay tool.
+ */
+
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// print every post and run for the replay tool
+//#define QUEUE_STATS_LOG
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct {
+    uint8_t priority; // the service's queue, and its number in the log
+    uint8_t depth; // posted and not yet run
+    uint8_t highWater; // deepest depth since QueueStats_Init
+    uint16_t overflows; // posts the queue was too full to take
+    ES_Event lastDropped; // the newest of those, ES_NO_EVENT if none
+} QueueStats_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function QueueStats_Init(QueueStats_t *stats, uint8_t Priority)
+ * @param stats - the service's stats
+ * @param Priority - the service's priority, as passed to its Init function
+ * @return None.
+ * @brief Clears the stats, call before the service posts its ES_INIT.
+ */
+void QueueStats_Init(QueueStats_t *stats, uint8_t Priority);
+
+/**
+ * @Function QueueStats_Post(QueueStats_t *stats, ES_Event ThisEvent)
+ * @param stats - the service's stats
+ * @param ThisEvent - the event (type and param) to be posted to its queue
+ * @return TRUE or FALSE, as ES_PostToService
+ * @brief Posts to the service's queue and counts the event in, or as dropped.
+ */
+uint8_t QueueStats_Post(QueueStats_t *stats, ES_Event ThisEvent);
+
+/**
+ * @Function QueueStats_Run(QueueStats_t *stats, ES_Event ThisEvent)
+ * @param stats - the service's stats
+ * @param ThisEvent - the event the service's Run function was called with
+ * @return None.
+ * @brief Counts the event out of the queue. ES_ENTRY and ES_EXIT are skipped,
+ *        a state machine calls itself with those and they never were queued.
+ */
+void QueueStats_Run(QueueStats_t *stats, ES_Event ThisEvent);
+
+/**
+ * @Function QueueStats_Print(const char *name, const QueueStats_t *stats)
+ * @param name - what to call the queue
+ * @param stats - the stats to print
+ * @return None.
+ * @brief Prints one line of stats over the serial port.
+ */
+void QueueStats_Print(const char *name, const QueueStats_t *stats);
+
+#endif /* QUEUE_STATS_H */
@@ -0,0 +1,282 @@
+/*
+ * File:   StateStats.c
+ *
+ * Per state residency, entry and transition counts, see StateStats.h.
+ */
+
+#include <stdio.h>
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "StateStats.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define STATE_STATS_TEST
+
+#define MAX_COUNT 0xFFFF
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static void StopClock(StateStats_t *stats, uint32_t now);
+static void Count(uint16_t *count);
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+// every machine that has changed state, most recent first
+static StateStats_t *Machines = NULL;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void StateStats_Event(StateStats_t *stats, ES_Event ThisEvent)
+{
+    if (stats == NULL) {
+        return;
+    }
+    if ((ThisEvent.EventType == ES_EXIT) && (stats->running == TRUE)) {
+        StopClock(stats, ES_Timer_GetTime());
+    } else if ((ThisEvent.EventType == ES_ENTRY) && (stats->running == FALSE) &&
+            (stats->current != 0)) {
+        // resumed where it was, a machine's own transitions start the clock
+        // before their ES_ENTRY
+        Count(&stats->entries[stats->current]);
+        stats->since = ES_Timer_GetTime();
+        stats->running = TRUE;
+    }
+}
+
+void StateStats_Transition(StateStats_t *stats, uint8_t from, uint8_t to)
+{
+    uint32_t now;
+
+    if ((stats == NULL) || (from >= stats->numStates) || (to >= stats->numStates)) {
+        return;
+    }
+    now = ES_Timer_GetTime();
+    if (stats->running == TRUE) {
+        StopClock(stats, now);
+    }
+    Count(&stats->transitions[from * stats->numStates + to]);
+    Count(&stats->entries[to]);
+    stats->current = to;
+    stats->since = now;
+    stats->running = TRUE;
+    if (stats->listed == FALSE) {
+        stats->next = Machines;
+        Machines = stats;
+        stats->listed = TRUE;
+    }
+}
+
+void StateStats_Print(const StateStats_t *stats)
+{
+    const uint16_t *row;
+    uint32_t time, out;
+    uint8_t from, to;
+
+    printf("%s\r\n", stats->machine);
+    for (from = 0; from < stats->numStates; from++) {
+        row = &stats->transitions[from * stats->numStates];
+        time = stats->time[from];
+        if ((from == stats->current) && (stats->running == TRUE)) {
+            time += ES_Timer_GetTime() - stats->since;
+        }
+        for (out = 0, to = 0; to < stats->numStates; to++) {
+            out += row[to];
+        }
+        // the initial pseudo-state only ever has transitions out
+        if ((stats->entries[from] == 0) && (time == 0) && (out == 0)) {
+            continue;
+        }
+        printf("  %s: %u entries, %lu ms", stats->names[from], stats->entries[from],
+                (unsigned long) time);
+        for (to = 0; to < stats->numStates; to++) {
+            if (row[to] > 0) {
+                printf(", %s %u", stats->names[to], row[to]);
+            }
+        }
+        printf("\r\n");
+    }
+}
+
+void StateStats_PrintAll(void)
+{
+    const StateStats_t *stats;
+
+    for (stats = Machines; stats != NULL; stats = stats->next) {
+        StateStats_Print(stats);
+    }
+}
+
+void StateStats_ResetAll(void)
+{
+    StateStats_t *stats;
+    uint16_t i;
+
+    for (stats = Machines; stats != NULL; stats = stats->next) {
+        for (i = 0; i < stats->numStates; i++) {
+            stats->time[i] = 0;
+            stats->entries[i] = 0;
+        }
+        for (i = 0; i < stats->numStates * stats->numStates; i++) {
+            stats->transitions[i] = 0;
+        }
+        stats->since = ES_Timer_GetTime();
+    }
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static void StopClock(StateStats_t *stats, uint32_t now)
+{
+    stats->time[stats->current] += now - stats->since;
+    stats->running = FALSE;
+}
+
+static void Count(uint16_t *count)
+{
+    if (*count < MAX_COUNT) {
+        (*count)++;
+    }
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef STATE_STATS_TEST
+
+#define TEST_HARNESS_SEED 2468
+#include "TestHarness.h"
+
+// Walks a parent machine and a sub machine in one of its states at random, with
+// the sub machine exited when the parent leaves that state and either restarted
+// or resumed when it comes back, a few milliseconds apart. Every count, and the
+// time in each state, is checked against a plain log of what happened.
+#define TEST_STEPS 2000
+#define TEST_STATES 5
+#define TEST_SUB_STATE 2 // the parent state that runs the sub machine
+#define TEST_LONGEST_WAIT 4
+
+static const char *ParentNames[TEST_STATES] = {"Init", "P1", "P2", "P3", "P4"};
+static const char *SubNames[TEST_STATES] = {"Init", "S1", "S2", "S3", "S4"};
+STATE_STATS_DECLARE(ParentStats, "Parent", ParentNames);
+STATE_STATS_DECLARE(SubStats, "Sub", SubNames);
+
+typedef struct {
+    uint8_t current;
+    uint8_t running;
+    uint32_t since;
+    uint32_t time[TEST_STATES];
+    uint32_t entries[TEST_STATES];
+    uint32_t transitions[TEST_STATES][TEST_STATES];
+} Expected_t;
+
+static Expected_t parent, sub;
+
+static void Expect(Expected_t *e, uint8_t to, uint32_t now)
+{
+    if (e->running) {
+        e->time[e->current] += now - e->since;
+    }
+    e->transitions[e->current][to]++;
+    e->entries[to]++;
+    e->current = to;
+    e->since = now;
+    e->running = TRUE;
+}
+
+static uint32_t Check(const char *name, const StateStats_t *stats, Expected_t *e)
+{
+    uint32_t wrong = 0, now = ES_Timer_GetTime();
+    uint8_t from, to;
+
+    if (e->running) {
+        e->time[e->current] += now - e->since;
+        e->since = now;
+    }
+    for (from = 0; from < TEST_STATES; from++) {
+        wrong += (stats->entries[from] != e->entries[from]);
+        wrong += (stats->time[from] + ((stats->running && (from == stats->current)) ?
+                now - stats->since : 0) != e->time[from]);
+        for (to = 0; to < TEST_STATES; to++) {
+            wrong += (stats->transitions[from * TEST_STATES + to] != e->transitions[from][to]);
+        }
+    }
+    printf("\n%s: %lu counts wrong", name, (unsigned long) wrong);
+    return wrong;
+}
+
+// returns just after a tick, so the steps that follow all see the same time
+static void Wait(void)
+{
+    uint32_t until = ES_Timer_GetTime() + 1 + TestHarness_Random(TEST_LONGEST_WAIT);
+
+    while (ES_Timer_GetTime() < until);
+}
+
+int main(void)
+{
+    uint32_t step;
+    uint8_t to;
+
+    BOARD_Init();
+    ES_Timer_Init();
+    printf("\nStateStats test harness, %u steps", TEST_STEPS);
+    STATE_STATS_TRANSITION(STATE_STATS_OF(ParentStats), 0, 1);
+    Expect(&parent, 1, ES_Timer_GetTime());
+    for (step = 0; step < TEST_STEPS; step++) {
+        Wait();
+        if ((parent.current == TEST_SUB_STATE) && (TestHarness_Random(3) != 0)) {
+            to = 1 + TestHarness_Random(TEST_STATES - 1);
+            STATE_STATS_EVENT(STATE_STATS_OF(SubStats), EXIT_EVENT);
+            STATE_STATS_TRANSITION(STATE_STATS_OF(SubStats), sub.current, to);
+            STATE_STATS_EVENT(STATE_STATS_OF(SubStats), ENTRY_EVENT);
+            Expect(&sub, to, ES_Timer_GetTime());
+            continue;
+        }
+        to = 1 + TestHarness_Random(TEST_STATES - 1);
+        // the parent runs its state's sub machine with its own ES_EXIT first
+        if (parent.current == TEST_SUB_STATE) {
+            STATE_STATS_EVENT(STATE_STATS_OF(SubStats), EXIT_EVENT);
+            sub.time[sub.current] += ES_Timer_GetTime() - sub.since;
+            sub.running = FALSE;
+        }
+        STATE_STATS_EVENT(STATE_STATS_OF(ParentStats), EXIT_EVENT);
+        STATE_STATS_TRANSITION(STATE_STATS_OF(ParentStats), parent.current, to);
+        STATE_STATS_EVENT(STATE_STATS_OF(ParentStats), ENTRY_EVENT);
+        Expect(&parent, to, ES_Timer_GetTime());
+        if (to == TEST_SUB_STATE) {
+            if ((sub.current == 0) || TestHarness_Random(2)) {
+                // restarted from its initial pseudo-state
+                sub.current = 0;
+                sub.running = FALSE;
+                STATE_STATS_TRANSITION(STATE_STATS_OF(SubStats), 0, 1);
+                Expect(&sub, 1, ES_Timer_GetTime());
+            } else {
+                // resumed where it was
+                STATE_STATS_EVENT(STATE_STATS_OF(SubStats), ENTRY_EVENT);
+                sub.entries[sub.current]++;
+                sub.since = ES_Timer_GetTime();
+                sub.running = TRUE;
+            }
+        }
+    }
+    Check("parent", &ParentStats, &parent);
+    Check("sub", &SubStats, &sub);
+    printf("\n");
+    StateStats_PrintAll();
+    TEST_HARNESS_END();
+    return 0;
+}
+
+#endif // STATE_STATS_TEST
@@ -0,0 +1,132 @@
+/*
+ * File:   StateStats.h
+ *
+ * Where the match time goes, state by state. With STATE_STATS defined below,
+ * every state machine keeps for each of its states the milliseconds spent in
+ * it, how many times it was entered, and how many times each transition out of
+ * it was taken, in a from-to matrix. A transition costs a few adds, however big
+ * the machine.
+ *
+ * A machine declares its counts next to its StateNames with STATE_STATS_DECLARE
+ * and calls two hooks:
+ *   STATE_STATS_EVENT at the top of its Run function, so the clock stops when
+ *     the machine above exits it (ES_EXIT) and starts again if it is resumed
+ *     where it left off (ES_ENTRY)
+ *   STATE_STATS_TRANSITION with the old and new state wherever CurrentState
+ *     changes, for a template machine just before CurrentState = nextState
+ * HSM_Engine machines pass STATE_STATS_OF their counts in the HSM_Machine_t and
+ * the engine calls both. Time spent in the initial pseudo-state is not counted.
+ *
+ * A machine's counts join the summary the first time it changes state.
+ * StateStats_PrintAll dumps all of them over the serial port, one line per state
+ * that has been entered, with the transitions out of it, e.g. how often
+ * WallFollowing went from TrackBackUpLeft1 to TrackForwardLeft1 against how
+ * often it got to WallFound.
+ *
+ * STATE_STATS_TEST (in the .c file) conditionally compiles a test harness.
+ */
+
+#ifndef STATE_STATS_H
+#define STATE_STATS_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+#include "ES_Events.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// count residency and transitions in every machine
+//#define STATE_STATS
+
+#ifdef STATE_STATS_TEST
+#define STATE_STATS
+#endif
+
+#define STATE_STATS_STATES(names) (sizeof(names) / sizeof((names)[0]))
+
+// the hooks, nothing at all without STATE_STATS
+#ifdef STATE_STATS
+#define STATE_STATS_DECLARE(stats, machine, names) \
+    static uint32_t stats##Time[STATE_STATS_STATES(names)]; \
+    static uint16_t stats##Entries[STATE_STATS_STATES(names)]; \
+    static uint16_t stats##Transitions[STATE_STATS_STATES(names) * STATE_STATS_STATES(names)]; \
+    static StateStats_t stats = {machine, names, STATE_STATS_STATES(names), \
+        stats##Time, stats##Entries, stats##Transitions, 0, FALSE, 0, FALSE, NULL}
+#define STATE_STATS_OF(stats) (&(stats))
+#define STATE_STATS_EVENT(stats, event) StateStats_Event((stats), (event))
+#define STATE_STATS_TRANSITION(stats, from, to) StateStats_Transition((stats), (from), (to))
+#else
+#define STATE_STATS_DECLARE(stats, machine, names)
+#define STATE_STATS_OF(stats) NULL
+#define STATE_STATS_EVENT(stats, event)
+#define STATE_STATS_TRANSITION(stats, from, to)
+#endif
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct StateStats {
+    const char *machine;
+    const char **names; // the machine's StateNames
+    uint8_t numStates;
+    uint32_t *time; // ms in each state
+    uint16_t *entries; // times each state was entered
+    uint16_t *transitions; // [from * numStates + to]
+    uint8_t current;
+    uint8_t running; // FALSE while the machine above has it exited
+    uint32_t since; // ES_Timer_GetTime() when the clock last started
+    uint8_t listed; // in the summary yet
+    struct StateStats *next; // in the summary
+} StateStats_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function StateStats_Event(StateStats_t *stats, ES_Event ThisEvent)
+ * @param stats - a machine's counts, or NULL
+ * @param ThisEvent - the event the machine is being run with
+ * @return None.
+ * @brief ES_EXIT stops the clock on the current state, ES_ENTRY with the clock
+ *        stopped starts it again and counts an entry. Other events do nothing.
+ */
+void StateStats_Event(StateStats_t *stats, ES_Event ThisEvent);
+
+/**
+ * @Function StateStats_Transition(StateStats_t *stats, uint8_t from, uint8_t to)
+ * @param stats - a machine's counts, or NULL
+ * @param from, to - the state it leaves and the one it enters
+ * @return None.
+ */
+void StateStats_Transition(StateStats_t *stats, uint8_t from, uint8_t to);
+
+/**
+ * @Function StateStats_Print(const StateStats_t *stats)
+ * @param stats - a machine's counts
+ * @return None.
+ * @brief Prints the machine's name, then a line for each state entered with its
+ *        entries, milliseconds and the count of each transition out of it. The
+ *        state it is in now includes the time so far.
+ */
+void StateStats_Print(const StateStats_t *stats);
+
+/**
+ * @Function StateStats_PrintAll(void)
+ * @param None.
+ * @return None.
+ */
+void StateStats_PrintAll(void);
+
+/**
+ * @Function StateStats_ResetAll(void)
+ * @param None.
+ * @return None.
+ * @brief Zeroes every machine's counts, the clock of a running state starts
+ *        over from now.
+ */
+void StateStats_ResetAll(void);
+
+#endif /* STATE_STATS_H */
@@ -33,6 +33,8 @@
 #include "ProjectHSM.h"
 #include "StayingInBoundsTowerSubHSM.h"
 #include "TapeFollowingSubSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -56,18 +58,32 @@ static const char *StateNames[] = {
 	"ForwardRight",
 	"TurnAroundAgain",
 };
+STATE_STATS_DECLARE(Stats, "StayingInBoundsTowerSubHSM", StateNames);
 
 //Include any defines you need to do
-#define IN_BOUNDS_TOWER_TURN_AROUND_TICKS 1500
 #define IN_BOUNDS_TOWER_FORWARD_TICKS 500
 #define IN_BOUNDS_TOWER_BACK_UP_RIGHT_TICKS 500
-#define IN_BOUNDS_TOWER_TURN_AROUND_AGAIN_TICKS 1500
+//the turn arounds end on the pose, reset at the tape edge, checked this often.
+//Past straight back on purpose: the 1500ms turns these replace made about 240
+//degrees in FieldSim and Forward/ForwardRight are tuned to leave from there.
+#define IN_BOUNDS_TOWER_TURN_AROUND_DEGREES 240
+#define IN_BOUNDS_TOWER_TURN_CHECK_TICKS 20
 
 /*******************************************************************************
  * PRIVATE FUNCTION PROTOTYPES                                                 *
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void ReportWall(ES_Event *ThisEvent);
+static void MarkTapeEdge(ES_Event *ThisEvent);
+static uint8_t TurnedAround(const ES_Event *ThisEvent);
+static void KeepTurning(ES_Event *ThisEvent);
+static void EnterReverse(void);
+static void EnterTurnAround(void);
+static void EnterForward(void);
+static void EnterForwardRight(void);
+static void EnterBackUpRight(void);
+static void EnterTurnAroundAgain(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -75,9 +91,82 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static StayingInBoundsTowerSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a StayingInBoundsTowerSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, Reverse, NULL, NULL},
+};
+
+static const HSM_Transition_t ReverseTransitions[] = {
+    {FL_TAPE_SEE_WHITE_EVENT, HSM_ANY_PARAM, TurnAround, NULL, MarkTapeEdge},
+    {FR_TAPE_SEE_WHITE_EVENT, HSM_ANY_PARAM, TurnAround, NULL, MarkTapeEdge},
+};
+
+static const HSM_Transition_t TurnAroundTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, Forward, TurnedAround, NULL},
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, KeepTurning},
+};
+
+static const HSM_Transition_t ForwardTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, ForwardRight, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+};
+
+static const HSM_Transition_t BackUpRightTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, Forward, NULL, NULL},
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TurnAroundAgain, NULL, MarkTapeEdge},
+    {FR_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TurnAroundAgain, NULL, MarkTapeEdge},
+};
+
+static const HSM_Transition_t ForwardRightTransitions[] = {
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TurnAroundAgain, NULL, MarkTapeEdge},
+    {FR_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TurnAroundAgain, NULL, MarkTapeEdge},
+};
+
+static const HSM_Transition_t TurnAroundAgainTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, TurnedAround, ReportWall},
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, HSM_NO_TARGET, NULL, KeepTurning},
+};
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [Reverse] =
+    {EnterReverse, NULL, NULL, NULL, HSM_TRANSITIONS(ReverseTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(FL_TAPE_SEE_WHITE_EVENT) | HSM_EVENT(FR_TAPE_SEE_WHITE_EVENT)},
+    [TurnAround] =
+    {EnterTurnAround, NULL, NULL, NULL, HSM_TRANSITIONS(TurnAroundTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+    [Forward] =
+    {EnterForward, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT)},
+    [BackUpRight] =
+    {EnterBackUpRight, NULL, NULL, NULL, HSM_TRANSITIONS(BackUpRightTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT)},
+    [ForwardRight] =
+    {EnterForwardRight, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardRightTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) |
+        HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT)},
+    [TurnAroundAgain] =
+    {EnterTurnAroundAgain, NULL, NULL, NULL, HSM_TRANSITIONS(TurnAroundAgainTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t StayingInBoundsTowerSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -97,6 +186,9 @@ uint8_t InitStayingInBoundsTowerSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&StayingInBoundsTowerSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunStayingInBoundsTowerSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -120,126 +212,8 @@ uint8_t InitStayingInBoundsTowerSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunStayingInBoundsTowerSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    StayingInBoundsTowerSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                nextState = Reverse;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-
-            }
-            break;
-
-        case Reverse:
-            DriveStraight(-100);
-            if ((ThisEvent.EventType == FL_TAPE_SEE_WHITE_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_WHITE_EVENT)) {
-                nextState = TurnAround;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case TurnAround: // in the first state, replace this with correct names
-            if (ThisEvent.EventType == ES_ENTRY){
-                TankRight(100);
-                //find out the amount of time required to make a full 180 turn.
-                //Rotational distance is about 14 inches. Speed is about 8 inches/s
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_TURN_AROUND_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == 2)) {
-                nextState = Forward;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT; 
-            }
-            break;
-
-        case Forward:
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_FORWARD_TICKS);
-            }
-            if ((ThisEvent.EventType == FR_BUMP_EVENT) ||
-                    (ThisEvent.EventType == FL_BUMP_EVENT)) {
-                nextState = BackUpRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == 2)) {
-                nextState = ForwardRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case ForwardRight:
-            TurnSharpRight(100);
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                    (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                nextState = TurnAroundAgain;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                nextState = BackUpRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case BackUpRight:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnSharpRight(-100);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_BACK_UP_RIGHT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == 2)) {
-                nextState = Forward;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                nextState = TurnAroundAgain;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case TurnAroundAgain:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TankRight(100);
-                //find out the amount of time required to make a full 180 turn.
-                //Rotational distance is about 14 inches. Speed is about 8 inches/s
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_TURN_AROUND_AGAIN_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == 2)) {
-                ThisEvent.EventType = WALL_DETECTED_EVENT;
-            }
-            break;
-            
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunStayingInBoundsTowerSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunStayingInBoundsTowerSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&StayingInBoundsTowerSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -249,3 +223,52 @@ ES_Event RunStayingInBoundsTowerSubHSM(ES_Event ThisEvent) {
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+//an internal transition, ProjectHSM leaves StayingInBoundsTower on the event it hands back
+static void ReportWall(ES_Event *ThisEvent) {
+    ThisEvent->EventType = WALL_DETECTED_EVENT;
+}
+
+//the tape edge is the one landmark here, turns are measured from it
+static void MarkTapeEdge(ES_Event *ThisEvent) {
+    Bot_ResetPose(0, 0, 0);
+}
+
+//turning right from the tape edge, so the heading counts down from zero
+static uint8_t TurnedAround(const ES_Event *ThisEvent) {
+    BotPose_t pose = Bot_GetPose();
+
+    return (uint16_t) -pose.theta >= BOT_DEGREES(IN_BOUNDS_TOWER_TURN_AROUND_DEGREES);
+}
+
+static void KeepTurning(ES_Event *ThisEvent) {
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_TURN_CHECK_TICKS);
+    ThisEvent->EventType = ES_NO_EVENT;
+}
+
+static void EnterReverse(void) {
+    DriveStraight(-100);
+}
+
+static void EnterTurnAround(void) {
+    TankRight(100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_TURN_CHECK_TICKS);
+}
+
+static void EnterForward(void) {
+    DriveStraight(100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_FORWARD_TICKS);
+}
+
+static void EnterForwardRight(void) {
+    TurnSharpRight(100);
+}
+
+static void EnterBackUpRight(void) {
+    TurnSharpRight(-100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_BACK_UP_RIGHT_TICKS);
+}
+
+static void EnterTurnAroundAgain(void) {
+    TankRight(100);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, IN_BOUNDS_TOWER_TURN_CHECK_TICKS);
+}
@@ -7,8 +7,9 @@
 
 #include <Stepper.h>
 #include <stdio.h>
-#include <xc.h>
-#include <peripheral/timer.h>
+#include <HW_Regs.h>
+#include <EventRecorder.h>
+#include <Latency.h>
 
 
 
@@ -18,44 +19,123 @@
  ******************************************************************************/
 //#define STEPPER_TEST
 
-/* Note that you need to set the prescalar and peripheral clock appropriate to
- * the processor board that you are using. In order to calculate the minimal
- * prescalar: Prescalar = (2000*F_PB/(1000000*0xFFFF))+1, round down */
+/* Note that you need to set the peripheral clock appropriate to the processor
+ * board that you are using. The prescalar is picked per rate by CalculateStepRate,
+ * F_PB has to divide evenly by all of them for the rates to come out exact. */
 #ifndef F_CPU
 #define F_CPU       80000000L
 #define F_PB        (F_CPU/2)
 #define F_PB_DIV8   (F_PB/8)
-#define F_PB_DIV64  (F_PB/64)
-#define ONE_KHZ_RATE  (F_PB_DIV8-1)/1000
 #endif
 
 #define MED_HZ_RATE 77
-#define LOW_HZ_RATE 10
-#define LOW_REP_NUM 64
+
+// Timer3 prescalars, indexed by their TCKPS setting
+#define NUM_PRESCALES 8
+#define PROFILE_TCKPS 3 // 1:8, the ramp periods are in F_PB_DIV8 ticks
+
+// longest single timer period used, leaves room under 0xFFFF for the extra
+// ticks the last period of a step picks up
+#define MAX_PERIOD_TICKS 65000
 
 #define ONE_HUNDRED_HZ 100
 #define TWENTY_KILOHERTZ 20000
 
 #define DEFAULT_STEP_RATE ONE_HUNDRED_HZ
 
-#define LED_BANK1_3 LATDbits.LATD6
-#define LED_BANK1_2 LATDbits.LATD11
-#define LED_BANK1_1 LATDbits.LATD3
-#define LED_BANK1_0 LATDbits.LATD5
+// profiled moves keep the timer at 1:8 with no overflow reps, so the slowest
+// ramp rate is the one whose period still fits in PR3
+#define MIN_PROFILE_RATE (MED_HZ_RATE + 1)
+
+#define LED_BANK1_3 HW_PIN(LATD, 6)
+#define LED_BANK1_2 HW_PIN(LATD, 11)
+#define LED_BANK1_1 HW_PIN(LATD, 3)
+#define LED_BANK1_0 HW_PIN(LATD, 5)
+
+#ifdef DRV8811_DRIVE
+#define ShutDownDrive() HW_PIN_WRITE(DRV_ENABLE, 0)
+#define TurnOnDrive() HW_PIN_WRITE(DRV_ENABLE, 1)
+#else
+#define ShutDownDrive() (HW_PIN_WRITE(COIL_A_ENABLE, 0), HW_PIN_WRITE(COIL_B_ENABLE, 0))
+#define TurnOnDrive() (HW_PIN_WRITE(COIL_A_ENABLE, 1), HW_PIN_WRITE(COIL_B_ENABLE, 1))
+#endif
 
-#define ShutDownDrive() (COIL_A_ENABLE = 0, COIL_B_ENABLE = 0)
-#define TurnOnDrive() (COIL_A_ENABLE = 1, COIL_B_ENABLE = 1)
+#ifdef STEPPER_HOME_SWITCH
+#define HomeSwitchClosed() HW_PIN_READ(STEPPER_HOME_SWITCH)
+#else
+#define HomeSwitchClosed() FALSE
+#endif
+
+// Timer3 and its interrupt straight on the registers, these used to be plib
+// calls and now show up in the host register trace like the pins do
+#define Timer3SetPeriod(ticks) HW_SFR_WRITE(PR3, ticks)
+#define Timer3IntEnable() HW_SFR_WRITE(IEC0SET, _IEC0_T3IE_MASK)
+#define Timer3IntDisable() HW_SFR_WRITE(IEC0CLR, _IEC0_T3IE_MASK)
+#define Timer3IntClearFlag() HW_SFR_WRITE(IFS0CLR, _IFS0_T3IF_MASK)
+#define Timer3Close() (Timer3IntDisable(), HW_SFR_WRITE(T3CON, 0))
+
+// the DRV8811 wants STEP high for at least 1us, this spin is a few us at 80MHz
+#define DRV_STEP_PULSE_SPIN 80
+
+/* The H-bridge modes all walk one eight phase half-step table. Full step uses
+ * the even (both coils on) phases and wave drive the odd (one coil on) phases,
+ * so they step through it two at a time. */
+#if defined FULL_STEP_DRIVE || defined HALF_STEP_DRIVE || defined WAVE_DRIVE
+#define COIL_TABLE_DRIVE
+#endif
+
+#define NUM_COIL_PHASES 8
+#define COIL_PHASE_MASK (NUM_COIL_PHASES - 1)
+
+#ifdef HALF_STEP_DRIVE
+#define COIL_PHASE_STRIDE 1
+#else
+#define COIL_PHASE_STRIDE 2
+#endif
+
+#ifdef WAVE_DRIVE
+#define COIL_PHASE_START 1
+#else
+#define COIL_PHASE_START 0
+#endif
+
+// coil pattern bits: direction in the low bit and enable above it, per coil
+#define COIL_A_DIR_BIT 0x01
+#define COIL_A_ON_BIT  0x02
+#define COIL_B_DIR_BIT 0x04
+#define COIL_B_ON_BIT  0x08
+#define COIL_A_FWD (COIL_A_ON_BIT | COIL_A_DIR_BIT)
+#define COIL_A_REV (COIL_A_ON_BIT)
+#define COIL_B_FWD (COIL_B_ON_BIT | COIL_B_DIR_BIT)
+#define COIL_B_REV (COIL_B_ON_BIT)
 
 /*******************************************************************************
  * PRIVATE STRUCTS and TYPEDEFS                                                *
  ******************************************************************************/
 //integer round: (x - 1)/y + 1
+
+// One step interval at a given rate. The interval is whole + fraction/denominator
+// timer ticks, laid out as periods-1 timer periods of period ticks and a last one
+// of lastPeriod ticks. The fraction is carried Bresenham style: the last period
+// takes one extra tick whenever error wraps, so the rate is exact on average and
+// any one step is off by at most a single tick.
+typedef struct {
+    uint8_t tckps;
+    uint16_t periods;
+    uint16_t period;
+    uint16_t lastPeriod;
+    uint32_t fraction;
+    uint32_t denominator;
+    uint32_t error;
+} StepRate_t;
+
 /*******************************************************************************
  * PRIVATE VARIABLES                                                           *
  ******************************************************************************/
 
 static int32_t stepCount = 0;
-static uint32_t overflowReps = 0;
+static StepRate_t stepRate;
+static const uint16_t Prescales[NUM_PRESCALES] = {1, 2, 4, 8, 16, 32, 64, 256};
 static uint8_t stepDir = FORWARD;
 static uint16_t stepsPerSecondRate = DEFAULT_STEP_RATE;
 
@@ -63,33 +143,163 @@ static enum {
     off, inited, stepping, halted,
 } stepperState = off;
 
-static enum {
-    step_one, step_two, step_three, step_four
-} coilState = step_one;
+static const uint8_t CoilPhaseTable[NUM_COIL_PHASES] = {
+    COIL_A_FWD | COIL_B_FWD,
+    COIL_A_FWD,
+    COIL_A_FWD | COIL_B_REV,
+    COIL_B_REV,
+    COIL_A_REV | COIL_B_REV,
+    COIL_A_REV,
+    COIL_A_REV | COIL_B_FWD,
+    COIL_B_FWD,
+};
+
+// index into CoilPhaseTable, and how far it moves per step (+/- stride)
+static uint8_t coilPhase = COIL_PHASE_START;
+static int8_t phaseStep = COIL_PHASE_STRIDE;
+
+// trapezoidal move profile, accel of 0 means moves run at stepsPerSecondRate
+static uint16_t profileStartRate = 0;
+static uint16_t profileCruiseRate = 0;
+static uint16_t profileAccel = 0;
+
+// AVR446 ramp state. n is the step's position on an ideal ramp up from
+// standstill, kept as 4n so a start rate that falls between whole ramp steps
+// doesn't skew the acceleration. The period is in Timer3 ticks and rest carries
+// the division remainder so rounding does not build up over the ramp.
+typedef struct {
+    uint32_t period;
+    uint32_t cruisePeriod;
+    uint32_t rest;
+    int32_t n4;
+    int32_t n4Start;
+    uint8_t decelerating;
+} StepRamp_t;
+
+static StepRamp_t ramp;
+static uint8_t rampActive = FALSE;
+
+// which timer period of the current step is running
+static uint16_t timerLoopCount = 0;
+
+// Stepper_SetRate hands a new rate to the ISR here, which swaps it in at the
+// next step boundary. The flag is dropped while the shadow is being written so
+// the ISR never picks up half a rate.
+static volatile StepRate_t pendingRate;
+static volatile uint8_t rateChangePending = FALSE;
+
+// absolute position, moved by the ISR on every step taken
+static volatile int32_t stepPosition = 0;
+static int32_t minPosition = 0;
+static int32_t maxPosition = 0;
+static uint8_t limitsOn = FALSE;
+static volatile uint8_t homing = FALSE;
+
+// a profiled move that has to turn around ramps down first, the step interrupt
+// then starts the move back to moveTarget
+static volatile uint8_t movePending = FALSE;
+static int32_t moveTarget = 0;
 
 /*******************************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES                                                *
  ******************************************************************************/
 /**
- * @Function: CalculateOverflowPeriod(uint16_t rate);
- * @param pulse rate is steps per second (0 = 0.5Hz, special case)
- * @return period overflow for timer to match step rate
- * @remark Calculates the overflow period and sets the module variable
- *         overflowReps to match for the right step rate.
- *         Note: rate 0 is a special case corresponding to 0.5Hz
- * @author Gabriel Hugh Elkaim
- * @date 2012.01.28 23:21 */
-uint32_t CalculateOverflowPeriod(uint16_t rate);
+ * @Function: CalculateStepRate(uint16_t rate, StepRate_t *r);
+ * @param rate - steps per second (0 = 0.5Hz, special case)
+ * @param r - filled in with the prescalar and periods for that rate
+ * @return none
+ * @remark Picks the smallest prescalar whose step interval fits in one timer
+ *         period, for the finest resolution. Below about 2.4Hz even 1:256
+ *         doesn't fit and the step is split over several periods.
+ *         Only does the math, the timer is not touched. */
+static void CalculateStepRate(uint16_t rate, StepRate_t *r);
+
+/**
+ * @Function: NextPeriodTicks(StepRate_t *r, uint16_t period);
+ * @param r - step rate, its error carry moves on at the last period of a step
+ * @param period - which period of the step is starting, from 0
+ * @return timer ticks for that period
+ * @remark Called at every rollover for the period that just started. */
+static uint16_t NextPeriodTicks(StepRate_t *r, uint16_t period);
+
+/**
+ * @Function: NextTimerPeriod(uint16_t *ticks);
+ * @param ticks - set to the length of the timer period that just started
+ * @return TRUE if the rollover that started it was a step boundary
+ * @remark Keeps track of the periods within a step and takes up a pending
+ *         rate at the step boundary. Doesn't touch the timer, so the ISR and
+ *         the test harness timing model both run it. */
+static uint8_t NextTimerPeriod(uint16_t *ticks);
+
+/**
+ * @Function: LoadStepRate(void);
+ * @param none
+ * @return none
+ * @remark Puts stepRate on Timer3 from the top of a step. Timer has to be off. */
+static void LoadStepRate(void);
 
 /**
- * @Function: FullStepDrive(void)
+ * @Function: CoilStepDrive(void)
  * @param none
  * @return none
- * @remark Implements the full step drive state machine in terms of switching
- *         the coils in the right sequence.
- * @author Gabriel Hugh Elkaim
- * @date 2016.10.16 15:42 */
-static void FullStepDrive(void);
+ * @remark Moves one phase in the current direction and puts that phase's
+ *         pattern on the coils. Same path for every mode and direction.
+ */
+static void CoilStepDrive(void);
+
+/**
+ * @Function: ApplyCoilPhase(void)
+ * @param none
+ * @return none
+ * @remark Writes the current phase pattern to the coil direction and enable pins.
+ */
+static void ApplyCoilPhase(void);
+
+/**
+ * @Function: RampInit(StepRamp_t *r, uint16_t startRate, uint16_t cruiseRate, uint16_t accel)
+ * @param r - ramp to set up
+ * @param startRate, cruiseRate, accel - the profile, see Stepper_SetProfile
+ * @return none
+ * @remark Puts the ramp at the start rate, ready for the first step.
+ */
+static void RampInit(StepRamp_t *r, uint16_t startRate, uint16_t cruiseRate, uint16_t accel);
+
+/**
+ * @Function: RampNextPeriod(StepRamp_t *r, int32_t stepsLeft)
+ * @param r - ramp state, advanced by one step
+ * @param stepsLeft - steps still to go after the one just taken
+ * @return Timer3 period until the next step
+ * @remark Speeds up using c(n) = c(n-1) - 2c(n-1)/(4n+1) until the cruise
+ *         period, and once the steps left equal the steps it took to get up to
+ *         speed, walks back down with c(n-1) = c(n) + 2c(n)/(4n-1). One
+ *         divide per step, cheap enough to run in the ISR.
+ */
+static uint32_t RampNextPeriod(StepRamp_t *r, int32_t stepsLeft);
+
+/**
+ * @Function: DrvStepPulse(void)
+ * @param none
+ * @return none
+ * @remark Puts one STEP pulse out to the DRV8811, which steps on the rising edge.
+ */
+static void DrvStepPulse(void);
+
+/**
+ * @Function: StartPendingMove(void)
+ * @param none
+ * @return none
+ * @remark Called from the step interrupt once a ramp down for a turn around is
+ *         done: starts a new ramp toward moveTarget from where the stepper is.
+ */
+static void StartPendingMove(void);
+
+/**
+ * @Function: TimerRollover(void)
+ * @param none
+ * @return none
+ * @remark The body of the step interrupt, apart so the test harness can run it.
+ */
+static void TimerRollover(void);
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
@@ -100,53 +310,66 @@ static void FullStepDrive(void);
  */
 int8_t Stepper_Init(void)
 {
-    uint16_t overflowPeriod;
     if (stepperState != off) {
         return ERROR;
     }
     stepCount = 0;
-    overflowReps = 0;
     stepsPerSecondRate = DEFAULT_STEP_RATE;
+    rateChangePending = FALSE;
+    stepPosition = 0;
+    limitsOn = FALSE;
+    homing = FALSE;
+    movePending = FALSE;
     // Initialize hardware (no current flow)
-    COIL_A_DIRECTION = 1;
-    COIL_B_DIRECTION = 1;
-    TRIS_COIL_A_DIRECTION = 0;
-    TRIS_COIL_A_ENABLE = 0;
-    TRIS_COIL_B_DIRECTION = 0;
-    TRIS_COIL_B_ENABLE = 0;
-    // Calculate overflow time and prescalar
-    overflowPeriod = CalculateOverflowPeriod(stepsPerSecondRate);
+#ifdef DRV8811_DRIVE
+    HW_PIN_WRITE(DRV_STEP, 0);
+    HW_PIN_WRITE(DRV_ENABLE, 0);
+    HW_PIN_WRITE(DRV_DIR, DRV_DIR_FORWARD);
+    HW_PIN_WRITE(TRIS_DRV_STEP, 0);
+    HW_PIN_WRITE(TRIS_DRV_DIR, 0);
+    HW_PIN_WRITE(TRIS_DRV_ENABLE, 0);
+#else
+    HW_PIN_WRITE(COIL_A_DIRECTION, 1);
+    HW_PIN_WRITE(COIL_B_DIRECTION, 1);
+    HW_PIN_WRITE(TRIS_COIL_A_DIRECTION, 0);
+    HW_PIN_WRITE(TRIS_COIL_A_ENABLE, 0);
+    HW_PIN_WRITE(TRIS_COIL_B_DIRECTION, 0);
+    HW_PIN_WRITE(TRIS_COIL_B_ENABLE, 0);
+#endif
+    // Calculate prescalar and periods
+    CalculateStepRate(stepsPerSecondRate, &stepRate);
 
     // Setup timer and interrupt
-    OpenTimer3(T3_ON | T3_SOURCE_INT | T3_PS_1_8, overflowPeriod);
-    INTClearFlag(INT_T3);
-    INTSetVectorPriority(INT_TIMER_3_VECTOR, 3);
-    INTSetVectorSubPriority(INT_TIMER_3_VECTOR, 3);
-    INTEnable(INT_T3, INT_ENABLED);
-    T3CONbits.ON = 1;
+    HW_SFR_WRITE(T3CON, 0); // internal clock, 1:1, off
+    LoadStepRate();
+    Timer3IntClearFlag();
+    HW_FIELD_WRITE(IPC3, T3IP, 3);
+    HW_FIELD_WRITE(IPC3, T3IS, 3);
+    Timer3IntEnable();
+    HW_FIELD_WRITE(T3CON, ON, 1);
 
     //    mT3IntEnable(1);
     stepperState = inited;
     return SUCCESS;
 }
 
-/* Sets the module variable with rate, and changes the overflow period
- * of the TIMER3 to generate the correct interrupt and repetition number
- * to match the number of steps per second.
+/* Sets the module variable with rate, and leaves the new prescalar and
+ * periods for the ISR to take up at the next step boundary. The timer keeps
+ * running, so the step under way finishes at the old rate and the next one
+ * starts at the new rate: no step is cut short, stretched, lost or doubled.
+ * A rate set during a profiled move waits for the move to end.
  */
 int8_t Stepper_SetRate(uint16_t rate)
 {
-    uint16_t overflowPeriod;
-    stepsPerSecondRate = rate;
+    StepRate_t newRate;
     if ((rate > TWENTY_KILOHERTZ)) {
         return ERROR;
     }
-    T3CONbits.ON = 0; // halt timer3
-    overflowPeriod = CalculateOverflowPeriod(rate);
-    WritePeriod3(overflowPeriod);
-    if (stepperState != halted) {
-        T3CONbits.ON = 1; // restart timer3
-    }
+    stepsPerSecondRate = rate;
+    CalculateStepRate(rate, &newRate);
+    rateChangePending = FALSE;
+    pendingRate = newRate;
+    rateChangePending = TRUE;
     return SUCCESS;
 }
 
@@ -164,6 +387,10 @@ int8_t Stepper_SetSteps(uint8_t direction, int32_t steps)
     if (stepperState == off) return ERROR;
     if ((direction == FORWARD) || (direction == REVERSE)) {
         stepDir = direction;
+        phaseStep = (direction == FORWARD) ? COIL_PHASE_STRIDE : -COIL_PHASE_STRIDE;
+#ifdef DRV8811_DRIVE
+        HW_PIN_WRITE(DRV_DIR, (direction == FORWARD) ? DRV_DIR_FORWARD : !DRV_DIR_FORWARD);
+#endif
         stepCount = steps;
         return SUCCESS;
     }
@@ -185,6 +412,28 @@ int8_t Stepper_InitSteps(uint8_t direction, int32_t steps)
     return result;
 }
 
+/* Sets the ramp used by moves started after this. With an accel of zero moves
+ * step at the constant Stepper_SetRate rate, as before.
+ */
+int8_t Stepper_SetProfile(uint16_t startRate, uint16_t cruiseRate, uint16_t accel)
+{
+    if (stepperState == stepping) {
+        return ERROR;
+    }
+    if (accel == 0) {
+        profileAccel = 0;
+        return SUCCESS;
+    }
+    if ((startRate < MIN_PROFILE_RATE) || (cruiseRate < startRate) ||
+            (cruiseRate > TWENTY_KILOHERTZ)) {
+        return ERROR;
+    }
+    profileStartRate = startRate;
+    profileCruiseRate = cruiseRate;
+    profileAccel = accel;
+    return SUCCESS;
+}
+
 // Sets the enum for the stepper state to stepping
 
 int8_t Stepper_StartSteps(void)
@@ -192,8 +441,32 @@ int8_t Stepper_StartSteps(void)
     if ((stepCount == 0) || (stepperState == stepping)) {
         return ERROR;
     }
+    if (profileAccel) {
+        HW_FIELD_WRITE(T3CON, ON, 0); // halt timer3
+        RampInit(&ramp, profileStartRate, profileCruiseRate, profileAccel);
+        HW_FIELD_WRITE(T3CON, TCKPS, PROFILE_TCKPS);
+        Timer3SetPeriod(ramp.period - 1);
+        HW_SFR_WRITE(TMR3, 0);
+        rampActive = TRUE;
+        HW_FIELD_WRITE(T3CON, ON, 1);
+    } else if (rampActive) {
+        // back to the constant rate after a profiled move
+        HW_FIELD_WRITE(T3CON, ON, 0);
+        if (rateChangePending) {
+            stepRate = pendingRate;
+            rateChangePending = FALSE;
+        }
+        rampActive = FALSE;
+        LoadStepRate();
+        HW_FIELD_WRITE(T3CON, ON, 1);
+    }
     stepperState = stepping;
+#ifdef COIL_TABLE_DRIVE
+    ApplyCoilPhase(); // hold where we are until the first step
+#else
     TurnOnDrive();
+#endif
+    Latency_Actuated();
     return SUCCESS;
 }
 
@@ -203,6 +476,111 @@ int8_t Stepper_StopsSteps(void)
 {
     if ((stepperState == off) || (stepperState == halted)) return ERROR;
     stepperState = halted;
+    homing = FALSE;
+    movePending = FALSE;
+    Latency_Actuated();
+    return SUCCESS;
+}
+
+// Wrapper to return the absolute position
+
+int32_t Stepper_GetPosition(void)
+{
+    return stepPosition;
+}
+
+// Sets the soft travel limits the ISR and Stepper_MoveTo hold to
+
+int8_t Stepper_SetLimits(int32_t minPos, int32_t maxPos)
+{
+    if (minPos > maxPos) {
+        return ERROR;
+    }
+    minPosition = minPos;
+    maxPosition = maxPos;
+    limitsOn = TRUE;
+    return SUCCESS;
+}
+
+/* Works out the move from the current position with the step interrupt held
+ * off, so a step can't land between reading the position and setting the
+ * count. A move under way at a constant rate just takes the new count and
+ * direction, that rate being one it can start at. A profiled move keeps going
+ * if it can stop at the new target, speeding up again if it was slowing down
+ * for the old one; if not, it ramps down to its start rate as it would at the
+ * end of a move and the step interrupt turns it around from there.
+ */
+int8_t Stepper_MoveTo(int32_t position)
+{
+    int32_t distance, stopSteps;
+    uint8_t moving;
+
+    RECORD_COMMAND(RECORDER_STEPPER_MOVE, position);
+    if ((stepperState == off) || homing) {
+        return ERROR;
+    }
+    if (limitsOn && ((position < minPosition) || (position > maxPosition))) {
+        return ERROR;
+    }
+    Timer3IntDisable();
+    moving = (stepperState == stepping);
+    distance = position - stepPosition;
+    movePending = FALSE;
+    if (moving && rampActive) {
+        // the steps a ramp down from here takes, see RampNextPeriod
+        stopSteps = ((ramp.n4 - ramp.n4Start) >> 2) + 1;
+        if ((stepDir == FORWARD) ? (distance >= stopSteps) : (-distance >= stopSteps)) {
+            stepCount = (distance > 0) ? distance : -distance;
+            if (ramp.decelerating) {
+                // picks up speed again if the new target leaves room
+                ramp.decelerating = FALSE;
+                ramp.rest = 0;
+            }
+        } else {
+            if (!ramp.decelerating || (stepCount > stopSteps)) {
+                stepCount = stopSteps;
+                ramp.decelerating = TRUE;
+                ramp.rest = 0;
+            }
+            moveTarget = position;
+            movePending = TRUE;
+        }
+        distance = 0;
+    } else if (distance > 0) {
+        Stepper_SetSteps(FORWARD, distance);
+    } else if (distance < 0) {
+        Stepper_SetSteps(REVERSE, -distance);
+    } else if (stepperState == stepping) {
+        stepCount = 0;
+        stepperState = halted;
+    }
+    Timer3IntEnable();
+    if ((distance != 0) && (stepperState != stepping)) {
+        return Stepper_StartSteps();
+    }
+    // a move under way took the new target, stopped where it was, or is
+    // ramping down to turn around
+    if (moving) {
+        Latency_Actuated();
+    }
+    return SUCCESS;
+}
+
+// Starts a move toward home, the ISR zeroes the position when it gets there
+
+int8_t Stepper_Home(uint8_t direction, int32_t maxSteps)
+{
+    if ((stepperState == off) || (stepperState == stepping) || (maxSteps <= 0)) {
+        return ERROR;
+    }
+    if (Stepper_SetSteps(direction, maxSteps) == ERROR) {
+        return ERROR;
+    }
+    homing = TRUE;
+    if (Stepper_StartSteps() == ERROR) {
+        homing = FALSE;
+        return ERROR;
+    }
     return SUCCESS;
 }
 
@@ -217,14 +595,14 @@ int32_t Stepper_GetRemainingSteps(void)
 
 int8_t Stepper_GetDirection(void)
 {
-    return stepDir;
+    return (int8_t) RECORD_SENSOR(RECORDER_STEP_DIRECTION, (uint16_t) stepDir);
 }
 
 // wrapper function to check state
 
 int8_t Stepper_IsStepping(void)
 {
-    return (stepperState == stepping);
+    return RECORD_SENSOR(RECORDER_STEPPING, (stepperState == stepping));
 }
 
 int8_t Stepper_End(void)
@@ -232,21 +610,34 @@ int8_t Stepper_End(void)
     if (stepperState == off) {
         return ERROR;
     }
-    T3CONbits.ON = 0; // halt timer3
+    HW_FIELD_WRITE(T3CON, ON, 0); // halt timer3
     stepperState = off;
     ShutDownDrive();
     // turn hardware pins back to inputs
-    TRIS_COIL_A_DIRECTION = 1;
-    TRIS_COIL_A_ENABLE = 1;
-    TRIS_COIL_B_DIRECTION = 1;
-    TRIS_COIL_B_ENABLE = 1;
+#ifdef DRV8811_DRIVE
+    HW_PIN_WRITE(DRV_STEP, 0);
+    HW_PIN_WRITE(TRIS_DRV_STEP, 1);
+    HW_PIN_WRITE(TRIS_DRV_DIR, 1);
+    HW_PIN_WRITE(TRIS_DRV_ENABLE, 1);
+#else
+    HW_PIN_WRITE(TRIS_COIL_A_DIRECTION, 1);
+    HW_PIN_WRITE(TRIS_COIL_A_ENABLE, 1);
+    HW_PIN_WRITE(TRIS_COIL_B_DIRECTION, 1);
+    HW_PIN_WRITE(TRIS_COIL_B_ENABLE, 1);
+#endif
     // reset module variables
     stepCount = 0;
-    overflowReps = 0;
-    coilState = step_one;
+    coilPhase = COIL_PHASE_START;
     stepsPerSecondRate = DEFAULT_STEP_RATE;
+    profileAccel = 0;
+    rampActive = FALSE;
+    rateChangePending = FALSE;
+    stepPosition = 0;
+    limitsOn = FALSE;
+    homing = FALSE;
+    movePending = FALSE;
     // turn off timer and interrupt
-    CloseTimer3();
+    Timer3Close();
     return SUCCESS;
 }
 
@@ -254,80 +645,166 @@ int8_t Stepper_End(void)
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
-/* There are three possibilities for the step rate calculation that keep the
-   step rate error to under 0.2% of the desired value, from within 0.5 to 2KHz:
-   from 78 to 20Khz, Prescale is 1:8, Rollover = (F_PB/8-1)/PPS
-   from 10 to 77Hz, Prescale is 1:64, Rollover = (F_PB/64-1)/PPS
-   from 0.5 to 10Hz, Set rollover for a constant 1Khz, and increment to reach
-   the desired time, Prescale is 1:8, Rollover = (F_PB/8-1)/1000 and the number
-   of times to repeat is (1000-1)/PPS + 1                                     */
-uint32_t CalculateOverflowPeriod(uint16_t rate)
+/* The step interval is F_PB/(prescale*rate) ticks. F_PB divides evenly by
+   every prescalar, so the whole ticks and the remainder out of rate are exact
+   and the carry in NextPeriodTicks makes up the remainder. Any single step is
+   at most one tick off its ideal time (1/2000 of the step at 20KHz, less below)
+   and the error never builds up. From 20KHz down to about 2.4Hz one timer
+   period is one step, below that the step is split over up to five periods. */
+static void CalculateStepRate(uint16_t rate, StepRate_t *r)
 {
-    if (rate == 0) {
-        overflowReps = 2000;
-        return (ONE_KHZ_RATE);
+    uint32_t ticks, denominator, whole;
+    uint8_t i;
+
+    // rate 0 is 0.5Hz, a step every two seconds
+    denominator = (rate == 0) ? 1 : rate;
+    for (i = 0; i < NUM_PRESCALES; i++) {
+        ticks = ((rate == 0) ? 2 * F_PB : F_PB) / Prescales[i];
+        if (ticks / denominator <= MAX_PERIOD_TICKS) {
+            break;
+        }
     }
-    if (rate > MED_HZ_RATE) {
-        overflowReps = 0;
-        return ((F_PB_DIV8 - 1) / rate);
+    if (i == NUM_PRESCALES) {
+        i = NUM_PRESCALES - 1;
     }
-    if (rate > LOW_HZ_RATE) {
-       overflowReps = (1000 - 1) / rate;
-        return ONE_KHZ_RATE;
+    whole = ticks / denominator;
+    r->tckps = i;
+    r->periods = (whole + MAX_PERIOD_TICKS - 1) / MAX_PERIOD_TICKS;
+    r->period = whole / r->periods;
+    r->lastPeriod = whole - (uint32_t) r->period * (r->periods - 1);
+    r->fraction = ticks % denominator;
+    r->denominator = denominator;
+    r->error = 0;
+}
+
+static uint16_t NextPeriodTicks(StepRate_t *r, uint16_t period)
+{
+    if (period + 1 < r->periods) {
+        return r->period;
+    }
+    r->error += r->fraction;
+    if (r->error >= r->denominator) {
+        r->error -= r->denominator;
+        return r->lastPeriod + 1;
     }
-    // rate is less than 10Hz, switch to counted 1KHz pulses
-    overflowReps = (1000 - 1) / rate + 1;
-    return ONE_KHZ_RATE;
+    return r->lastPeriod;
 }
 
-// Function to implement full step drive
-void FullStepDrive(void)
+static uint8_t NextTimerPeriod(uint16_t *ticks)
 {
-    switch (coilState) {
-    case step_one:
-        // coil drive both forward
-        COIL_A_DIRECTION = 1;
-        COIL_B_DIRECTION = 1;
-        if (stepDir == FORWARD) {
-            coilState = step_two;
-        } else {
-            coilState = step_four;
-        }
-        break;
-
-    case step_two:
-        // coil drive A forward, B reverse
-        COIL_A_DIRECTION = 1;
-        COIL_B_DIRECTION = 0;
-        if (stepDir == FORWARD) {
-            coilState = step_three;
-        } else {
-            coilState = step_one;
+    uint8_t boundary = FALSE;
+
+    // a profiled move steps on every rollover, the ramp sets each period
+    timerLoopCount++;
+    if ((timerLoopCount >= stepRate.periods) || rampActive) {
+        timerLoopCount = 0;
+        boundary = TRUE;
+        if (rateChangePending && !(rampActive && (stepperState == stepping))) {
+            stepRate = pendingRate;
+            rateChangePending = FALSE;
+            rampActive = FALSE;
         }
-        break;
-
-    case step_three:
-        // coil drive both reverse
-        COIL_A_DIRECTION = 0;
-        COIL_B_DIRECTION = 0;
-        if (stepDir == FORWARD) {
-            coilState = step_four;
-        } else {
-            coilState = step_two;
+    }
+    *ticks = NextPeriodTicks(&stepRate, timerLoopCount);
+    return boundary;
+}
+
+static void LoadStepRate(void)
+{
+    HW_FIELD_WRITE(T3CON, TCKPS, stepRate.tckps);
+    Timer3SetPeriod(NextPeriodTicks(&stepRate, 0) - 1);
+    HW_SFR_WRITE(TMR3, 0);
+    timerLoopCount = 0;
+}
+
+static void RampInit(StepRamp_t *r, uint16_t startRate, uint16_t cruiseRate, uint16_t accel)
+{
+    r->period = F_PB_DIV8 / startRate;
+    r->cruisePeriod = F_PB_DIV8 / cruiseRate;
+    r->rest = 0;
+    // the step after c(n) runs at v = sqrt(2a(n + 1/2)), so the start rate
+    // sits at 4n = 2v^2/a - 2
+    r->n4Start = (2UL * startRate * startRate) / accel - 2;
+    if (r->n4Start < 1) {
+        r->n4Start = 1;
+    }
+    r->n4 = r->n4Start;
+    r->decelerating = FALSE;
+}
+
+static uint32_t RampNextPeriod(StepRamp_t *r, int32_t stepsLeft)
+{
+    uint32_t numerator, denominator;
+
+    // one extra step so the last interval comes back out at the start rate
+    if (!r->decelerating && (stepsLeft <= ((r->n4 - r->n4Start) >> 2) + 1)) {
+        r->decelerating = TRUE;
+        r->rest = 0;
+    }
+    if (r->decelerating) {
+        if (r->n4 > r->n4Start) {
+            numerator = 2 * r->period + r->rest;
+            denominator = r->n4 - 1;
+            r->period += numerator / denominator;
+            r->rest = numerator % denominator;
+            r->n4 -= 4;
         }
-        break;
-
-    case step_four:
-        // coil drive A reverse, B forward
-        COIL_A_DIRECTION = 0;
-        COIL_B_DIRECTION = 1;
-        if (stepDir == FORWARD) {
-            coilState = step_one;
-        } else {
-            coilState = step_three;
+    } else if (r->period > r->cruisePeriod) {
+        r->n4 += 4;
+        numerator = 2 * r->period + r->rest;
+        denominator = r->n4 + 1;
+        r->period -= numerator / denominator;
+        r->rest = numerator % denominator;
+        if (r->period < r->cruisePeriod) {
+            r->period = r->cruisePeriod;
         }
-        break;
     }
+    return r->period;
+}
+
+static void CoilStepDrive(void)
+{
+    // the mask wraps a negative step back around the table
+    coilPhase = (coilPhase + phaseStep) & COIL_PHASE_MASK;
+    ApplyCoilPhase();
+}
+
+static void ApplyCoilPhase(void)
+{
+    uint8_t pattern = CoilPhaseTable[coilPhase];
+
+    // one bit fields take the low bit of whatever they are assigned
+    HW_PIN_WRITE(COIL_A_DIRECTION, pattern);
+    HW_PIN_WRITE(COIL_A_ENABLE, pattern >> 1);
+    HW_PIN_WRITE(COIL_B_DIRECTION, pattern >> 2);
+    HW_PIN_WRITE(COIL_B_ENABLE, pattern >> 3);
+}
+
+static void DrvStepPulse(void)
+{
+    uint8_t i;
+
+    HW_PIN_WRITE(DRV_STEP, 1);
+    for (i = 0; i < DRV_STEP_PULSE_SPIN; i++) {
+        asm("nop");
+    }
+    HW_PIN_WRITE(DRV_STEP, 0);
+}
+
+static void StartPendingMove(void)
+{
+    int32_t distance = moveTarget - stepPosition;
+
+    movePending = FALSE;
+    if (distance == 0) {
+        return;
+    }
+    Stepper_SetSteps((distance > 0) ? FORWARD : REVERSE, (distance > 0) ? distance : -distance);
+    // the first step of the way back comes a start rate interval after the
+    // last one out, the same as any move starting from a stop
+    RampInit(&ramp, profileStartRate, profileCruiseRate, profileAccel);
+    Timer3SetPeriod(ramp.period - 1);
+    stepperState = stepping;
 }
 
 /****************************************************************************
@@ -338,7 +815,9 @@ void FullStepDrive(void)
  Returns: None.
 
  Description
-    Implements the Stepper motor FULL STEP drive state machine.
+    Implements the Stepper motor drive: one table step per step for the
+    H-bridge modes, one STEP pulse per step for the DRV8811, with the next
+    period from the ramp when profiled.
 
  Notes
     
@@ -347,17 +826,28 @@ void FullStepDrive(void)
  ****************************************************************************/
 void __ISR(_TIMER_3_VECTOR, ipl4auto) Timer3IntHandler(void)
 {
-    static uint16_t timerLoopCount = 0;
+    TimerRollover();
+}
 
-    timerLoopCount++;
-    if (timerLoopCount > overflowReps) {
-        timerLoopCount = 0;
+static void TimerRollover(void)
+{
+    uint16_t periodTicks;
+
+    if (NextTimerPeriod(&periodTicks)) {
+        if (!rampActive && (HW_FIELD_READ(T3CON, TCKPS) != stepRate.tckps)) {
+            // the new rate needs another prescalar, which only takes from a
+            // cleared timer: costs the few ticks since the rollover
+            HW_FIELD_WRITE(T3CON, ON, 0);
+            HW_FIELD_WRITE(T3CON, TCKPS, stepRate.tckps);
+            HW_SFR_WRITE(TMR3, 0);
+            HW_FIELD_WRITE(T3CON, ON, 1);
+        }
         // execute Stepper Drive state machine here
         switch (stepperState) {
         case off: // should not get here
-            T3CONbits.ON = 0; // halt timer3
+            HW_FIELD_WRITE(T3CON, ON, 0); // halt timer3
             ShutDownDrive();
-            CloseTimer3();
+            Timer3Close();
             break;
 
         case inited:
@@ -365,27 +855,64 @@ void __ISR(_TIMER_3_VECTOR, ipl4auto) Timer3IntHandler(void)
             if (stepCount < 0) {
                 stepCount = 0;
             }
+#ifdef DRV8811_DRIVE
+            // let go one period after the last step so that step still lands
+            ShutDownDrive();
+#endif
             break;
 
         case stepping:
+            if (homing && HomeSwitchClosed()) {
+                stepPosition = 0;
+                homing = FALSE;
+                stepCount = 0;
+                stepperState = halted;
+                break;
+            }
+            if (stepDir == FORWARD) {
+                if (limitsOn && !homing && (stepPosition >= maxPosition)) {
+                    stepCount = 0;
+                    stepperState = halted;
+                    break;
+                }
+                stepPosition++;
+            } else {
+                if (limitsOn && !homing && (stepPosition <= minPosition)) {
+                    stepCount = 0;
+                    stepperState = halted;
+                    break;
+                }
+                stepPosition--;
+            }
             if (--stepCount <= 0) {
                 stepperState = halted;
+                if (homing) {
+                    // ran the full distance against the stop
+                    stepPosition = 0;
+                    homing = FALSE;
+                }
+            } else if (rampActive) {
+                Timer3SetPeriod(RampNextPeriod(&ramp, stepCount) - 1);
             }
-            TurnOnDrive();
 
-#ifdef FULL_STEP_DRIVE
-            FullStepDrive();
-#endif // FULL_STATE_DRIVE
-#ifdef HALF_STEP_DRIVE
-#endif // HALF_STATE_DRIVE
-#ifdef WAVE_DRIVE
-#endif // WAVE_DRIVE
+#ifdef COIL_TABLE_DRIVE
+            CoilStepDrive(); // full, half and wave drive
+#endif
 #ifdef DRV8811_DRIVE
+            DrvStepPulse();
 #endif // DRV8811 DRIVE
             break;
         }
+        // the direction only changes here, after the last step out is taken
+        if ((stepperState == halted) && movePending) {
+            StartPendingMove();
+        }
     }
-    mT3ClearIntFlag();
+    if (!rampActive) {
+        // the timer has already started the next period, set its length
+        Timer3SetPeriod(periodTicks - 1);
+    }
+    Timer3IntClearFlag();
 }
 
 /*******************************************************************************
@@ -551,6 +1078,28 @@ void main(void)
     }
 
 
+    stepPosition = 10;
+    if ((Stepper_SetLimits(100, 0) != ERROR) || (Stepper_SetLimits(0, 100) != SUCCESS)) {
+        errors++;
+    }
+    if (Stepper_MoveTo(150) != ERROR) {
+        errors++;
+    }
+    result = Stepper_MoveTo(4);
+    if ((result != SUCCESS) || (stepDir != REVERSE) || (stepCount != 6) ||
+            (stepperState != stepping)) {
+        errors++;
+    }
+    Stepper_StopsSteps();
+    if (errors) {
+        printf("\r\nStepper_SetLimits() or Stepper_MoveTo() function failed");
+        while (1) {
+            ;
+        }
+    } else {
+        printf("\r\nStepper_SetLimits() and Stepper_MoveTo() function passed");
+    }
+
     stepperState = off;
     result = Stepper_End();
     if (result == SUCCESS) {
@@ -570,6 +1119,209 @@ void main(void)
         printf("\n\rStepper_End() function passed");
     }
 
+    // run a profiled move through the ramp math without the timer: the move
+    // should stay under cruise, end at the start rate, and take about as long
+    // as an ideal trapezoid, which is 0.96s for this one (+ the final interval)
+    {
+        StepRamp_t testRamp;
+        uint32_t period, totalTicks = 0, peakRate = 0;
+        int32_t left = 1000;
+        RampInit(&testRamp, 100, 2000, 4000);
+        period = testRamp.period;
+        while (left > 0) {
+            totalTicks += period;
+            if ((F_PB_DIV8 / period) > peakRate) {
+                peakRate = F_PB_DIV8 / period;
+            }
+            if (--left > 0) {
+                period = RampNextPeriod(&testRamp, left);
+            }
+        }
+        if ((peakRate > 2000) || (period < (F_PB_DIV8 / 101)) || (period > (F_PB_DIV8 / 99)) ||
+                (totalTicks < (F_PB_DIV8 / 100) * 96) || (totalTicks > (F_PB_DIV8 / 100) * 100)) {
+            errors++;
+        }
+        if (errors) {
+            printf("\r\nRampNextPeriod() profile failed: %d ticks, peak %dHz, last period %d",
+                    totalTicks, peakRate, period);
+            while (1) {
+                ;
+            }
+        } else {
+            printf("\r\nRampNextPeriod() profile passed");
+        }
+    }
+
+    // sweep every rate through the rate math without the timer: each step has
+    // to land on the floor of its ideal time in ticks, so it is never more than
+    // one tick off and the error can't build up, and a whole second of steps
+    // has to come out exact
+    {
+        StepRate_t testRate;
+        uint32_t rate, n, steps, ideal, total, worstPpm = 0, worstRate = 0;
+        uint16_t period;
+
+        for (rate = 0; rate <= TWENTY_KILOHERTZ; rate++) {
+            CalculateStepRate(rate, &testRate);
+            ideal = (testRate.period * (testRate.periods - 1) + testRate.lastPeriod) *
+                    testRate.denominator + testRate.fraction;
+            if ((ideal != ((rate == 0) ? 2 * F_PB : F_PB) / Prescales[testRate.tckps]) ||
+                    (testRate.lastPeriod >= 0xFFFF)) {
+                errors++;
+            }
+            steps = (testRate.denominator < 1000) ? testRate.denominator : 1000;
+            total = 0;
+            for (n = 1; n <= steps; n++) {
+                for (period = 0; period < testRate.periods; period++) {
+                    total += NextPeriodTicks(&testRate, period);
+                }
+                if (total != (uint32_t) (((uint64_t) ideal * n) / testRate.denominator)) {
+                    errors++;
+                }
+            }
+            // one tick of jitter against the step length
+            if ((1000000UL / (ideal / testRate.denominator)) > worstPpm) {
+                worstPpm = 1000000UL / (ideal / testRate.denominator);
+                worstRate = rate;
+            }
+            if (errors) {
+                printf("\r\nCalculateStepRate() failed at %dHz", rate);
+                while (1) {
+                    ;
+                }
+            }
+        }
+        printf("\r\nCalculateStepRate() passed 0.5Hz to 20KHz: average error 0, "
+                "worst step jitter one tick = %dppm at %dHz", worstPpm, worstRate);
+    }
+
+    // timing model of rate changes on the fly: run the rollover logic by hand,
+    // set a new rate partway into a step, and check every step comes out as one
+    // whole step at the rate in force when it started, and that a new rate is
+    // taken up at the very next step boundary
+    {
+        static const uint16_t modelRates[] = {100, 20000, 1, 78, 77, 5000, 0, 333, 19999};
+        uint32_t now = 0, lastStep = 0, prescale, stepPrescale;
+        int64_t miss;
+        uint16_t ticks, inForce = modelRates[0], requested = modelRates[0];
+        uint8_t k, steps, extra, pendingBefore;
+
+        stepperState = stepping;
+        rampActive = FALSE;
+        rateChangePending = FALSE;
+        CalculateStepRate(inForce, &stepRate);
+        timerLoopCount = 0;
+        ticks = NextPeriodTicks(&stepRate, 0);
+        prescale = stepPrescale = Prescales[stepRate.tckps];
+        for (k = 1; k <= sizeof (modelRates) / sizeof (modelRates[0]); k++) {
+            steps = 0;
+            extra = 0;
+            while ((steps < 3) || (extra++ < (k & 1))) {
+                now += ticks * prescale;
+                pendingBefore = rateChangePending;
+                if (NextTimerPeriod(&ticks)) {
+                    miss = (int64_t) (now - lastStep) * (inForce ? inForce : 1) -
+                            (inForce ? F_PB : 2 * F_PB);
+                    if (miss < 0) {
+                        miss = -miss;
+                    }
+                    if ((miss >= (int64_t) stepPrescale * (inForce ? inForce : 1)) ||
+                            rateChangePending) {
+                        errors++;
+                    }
+                    if (pendingBefore) {
+                        inForce = requested;
+                    }
+                    lastStep = now;
+                    stepPrescale = Prescales[stepRate.tckps];
+                    steps++;
+                }
+                prescale = Prescales[stepRate.tckps];
+            }
+            if (k < sizeof (modelRates) / sizeof (modelRates[0])) {
+                requested = modelRates[k];
+                Stepper_SetRate(requested);
+            }
+        }
+        stepperState = off;
+        rateChangePending = FALSE;
+        if (errors) {
+            printf("\r\nStepper_SetRate() on the fly failed going to %dHz", inForce);
+            while (1) {
+                ;
+            }
+        } else {
+            printf("\r\nStepper_SetRate() on the fly passed");
+        }
+    }
+
+    // profiled moves retargeted part way, with the step interrupt run by hand:
+    // one turning around has to ramp down to the start rate before it steps
+    // the other way, none may top cruise, and each has to end on the new
+    // target at the start rate. The third is caught ramping down and sent on.
+    {
+        static const int32_t retargets[][4] = {
+            // target, position to retarget at, new target, turn arounds
+            {1000, 150, 50, 1}, {1000, 150, 140, 1}, {400, 330, 800, 0}, {400, 300, 300, 1},
+        };
+        uint32_t period, stepPeriod = 0, outPeriod = 0;
+        uint32_t startPeriod = F_PB_DIV8 / 101, cruisePeriod = F_PB_DIV8 / 2000;
+        int32_t last, step, lastStep, turns, rollovers;
+        uint8_t k, retargeted;
+
+        Stepper_Init();
+        Timer3IntDisable(); // the harness is the interrupt from here
+        Stepper_SetProfile(100, 2000, 4000);
+        for (k = 0; k < sizeof (retargets) / sizeof (retargets[0]); k++) {
+            stepPosition = 0;
+            Stepper_MoveTo(retargets[k][0]);
+            period = HW_SFR_READ(PR3) + 1;
+            last = stepPosition;
+            lastStep = 0;
+            turns = 0;
+            retargeted = FALSE;
+            for (rollovers = 0; Stepper_IsStepping() && (rollovers < 100000); rollovers++) {
+                if (!retargeted && (stepPosition == retargets[k][1])) {
+                    Stepper_MoveTo(retargets[k][2]);
+                    retargeted = TRUE;
+                }
+                stepPeriod = period;
+                TimerRollover();
+                period = HW_SFR_READ(PR3) + 1;
+                step = stepPosition - last;
+                last = stepPosition;
+                if (step == 0) {
+                    continue;
+                }
+                // the last step out and the wait before the first one back
+                if ((lastStep != 0) && (step != lastStep)) {
+                    turns++;
+                    if ((outPeriod < startPeriod) || (stepPeriod < startPeriod)) {
+                        errors++;
+                    }
+                }
+                if (stepPeriod < cruisePeriod) {
+                    errors++;
+                }
+                outPeriod = stepPeriod;
+                lastStep = step;
+            }
+            if ((stepPosition != retargets[k][2]) || Stepper_IsStepping() || (turns != retargets[k][3]) ||
+                    (stepPeriod < startPeriod)) {
+                errors++;
+            }
+            if (errors) {
+                printf("\r\nStepper_MoveTo() retarget %d failed: at %d after %d turns, last period %d",
+                        k, stepPosition, turns, stepPeriod);
+                while (1) {
+                    ;
+                }
+            }
+        }
+        Stepper_End();
+        printf("\r\nStepper_MoveTo() retargeting a profiled move passed");
+    }
+
     printf("\n\rTerminating test harness");
     
 
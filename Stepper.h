@@ -17,6 +17,10 @@
  *           HALF_STEP_DRIVE
  *           WAVE_DRIVE
  *           DRV8811_DRIVE
+ *        The three H-bridge modes share one half-step coil table: full step takes
+ *        the two-coil phases, wave drive the one-coil phases, half step takes all.
+ *        DRV8811 mode only drives the STEP, DIR and ENABLE pins of the driver
+ *        chip and leaves the coil pins alone.
  *
  * STEPPER_TEST (in the .c file) conditionally compiles the test harness for the code. 
  * Make sure it is commented out for module useage.
@@ -28,6 +32,7 @@
 #define Stepper_H
 
 #include <BOARD.h>
+#include <HW_Regs.h>
 
 /*******************************************************************************
  * STEPPER MODE #DEFINES                                                       *
@@ -61,15 +66,30 @@
 #define FORWARD 1
 #define REVERSE 0
 
-#define TRIS_COIL_A_ENABLE TRISFbits.TRISF1     //PORTZ_04
-#define TRIS_COIL_A_DIRECTION TRISEbits.TRISE4  //PORTZ_03
-#define TRIS_COIL_B_ENABLE TRISDbits.TRISD8     //PORTZ_08
-#define TRIS_COIL_B_DIRECTION TRISEbits.TRISE2  //PORTZ_07
+#define TRIS_COIL_A_ENABLE HW_PIN(TRISF, 1)     //PORTZ_04
+#define TRIS_COIL_A_DIRECTION HW_PIN(TRISE, 4)  //PORTZ_03
+#define TRIS_COIL_B_ENABLE HW_PIN(TRISD, 8)     //PORTZ_08
+#define TRIS_COIL_B_DIRECTION HW_PIN(TRISE, 2)  //PORTZ_07
 
-#define COIL_A_ENABLE LATFbits.LATF1
-#define COIL_A_DIRECTION LATEbits.LATE4
-#define COIL_B_ENABLE LATDbits.LATD8
-#define COIL_B_DIRECTION LATEbits.LATE2
+#define COIL_A_ENABLE HW_PIN(LATF, 1)
+#define COIL_A_DIRECTION HW_PIN(LATE, 4)
+#define COIL_B_ENABLE HW_PIN(LATD, 8)
+#define COIL_B_DIRECTION HW_PIN(LATE, 2)
+
+#define TRIS_DRV_STEP HW_PIN(TRISD, 0)          //PORTZ_06
+#define TRIS_DRV_DIR HW_PIN(TRISF, 1)           //PORTZ_04
+#define TRIS_DRV_ENABLE HW_PIN(TRISE, 3)        //PORTZ_05
+
+#define DRV_STEP HW_PIN(LATD, 0)
+#define DRV_DIR HW_PIN(LATF, 1)
+#define DRV_ENABLE HW_PIN(LATE, 3)
+
+// DIR pin level for FORWARD, which raises the ball lift on the bot
+#define DRV_DIR_FORWARD 0
+
+// Home switch for Stepper_Home, reads 1 when the stepper is at home. Leave it
+// undefined to home open loop against the hard stop.
+//#define STEPPER_HOME_SWITCH HW_PIN(PORTE, 5)     //for example
 
 
 /*******************************************************************************
@@ -101,6 +121,19 @@ int8_t Stepper_SetRate(uint16_t rate);
  * @author Gabriel Hugh Elkaim, 2016.10.13 15:37 */
 uint16_t Stepper_GetRate(void);
 
+/**
+ * @Function Stepper_SetProfile(uint16_t startRate, uint16_t cruiseRate, uint16_t accel);
+ * @param startRate - steps per second a move starts and ends at, 78Hz or more
+ * @param cruiseRate - top speed in steps per second, up to 20KHz
+ * @param accel - steps per second per second, 0 turns profiling off
+ * @return SUCCESS or ERROR
+ * @brief Makes the following moves trapezoidal: ramp up from startRate at accel,
+ *        hold cruiseRate, then ramp down to finish the last step at startRate.
+ *        Short moves that can't reach cruise turn into a triangle. With
+ *        profiling off, moves step at the Stepper_SetRate rate.
+ * @note Can't be changed in the middle of a move. */
+int8_t Stepper_SetProfile(uint16_t startRate, uint16_t cruiseRate, uint16_t accel);
+
 /**
  * @Function: Stepper_SetSteps(char direction, unsigned int steps);
  * @param direction - stepper direction (FORWARD or REVERSE)
@@ -159,6 +192,45 @@ int8_t Stepper_GetDirection(void);
  * @author Gabriel Hugh Elkaim, 2016.10.13 15:37 */
 int8_t Stepper_IsStepping(void);
 
+/**
+ * @Function: Stepper_GetPosition(void);
+ * @return absolute position in steps, FORWARD counts up
+ * @brief Position is 0 where the stepper was at Stepper_Init, or at home after
+ *        Stepper_Home, and is kept by the step interrupt.
+ * @note Steps lost to a stall are not seen. */
+int32_t Stepper_GetPosition(void);
+
+/**
+ * @Function: Stepper_SetLimits(int32_t minPosition, int32_t maxPosition);
+ * @param minPosition, maxPosition - soft travel limits in steps
+ * @return SUCCESS or ERROR
+ * @brief Stepping stops at either limit whatever the command, and
+ *        Stepper_MoveTo won't take a target outside them. Limits are off until
+ *        this is called. */
+int8_t Stepper_SetLimits(int32_t minPosition, int32_t maxPosition);
+
+/**
+ * @Function: Stepper_MoveTo(int32_t position);
+ * @param position - absolute target in steps
+ * @return SUCCESS or ERROR
+ * @brief Steps straight to position from wherever the stepper is, turning a
+ *        move already under way around if needed. A profiled move ramps down
+ *        to its start rate before it turns around, or if it can't stop in time
+ *        for the new target, and comes back from there. Nothing happens if it
+ *        is already there, so no STEPPER_DONE_EVENT either. */
+int8_t Stepper_MoveTo(int32_t position);
+
+/**
+ * @Function: Stepper_Home(uint8_t direction, int32_t maxSteps);
+ * @param direction - direction home is in (FORWARD or REVERSE)
+ * @param maxSteps - most steps to take, more than the full travel
+ * @return SUCCESS or ERROR
+ * @brief Steps toward home with the soft limits off, and sets position 0 when
+ *        STEPPER_HOME_SWITCH closes, or without a switch once maxSteps are
+ *        done and the stepper has been run against the hard stop.
+ * @note Stopping a homing move with Stepper_StopsSteps leaves it unhomed. */
+int8_t Stepper_Home(uint8_t direction, int32_t maxSteps);
+
 /**
  * @Function: Stepper_End(void);
  * @return SUCCESS or ERROR
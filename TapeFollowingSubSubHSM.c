@@ -32,6 +32,8 @@
 #include "BOARD.h"
 #include "ProjectHSM.h"
 #include "TapeFollowingSubSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 
 /*******************************************************************************
  * MODULE #DEFINES                                                             *
@@ -49,6 +51,7 @@ static const char *StateNames[] = {
 	"ForwardRight",
 	"BackUpRight",
 };
+STATE_STATS_DECLARE(Stats, "TapeFollowingSubSubHSM", StateNames);
 
 //Include any defines you need to do
 #define BACK_UP_TICKS 500
@@ -60,6 +63,9 @@ static const char *StateNames[] = {
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void EnterBackUpRight(void);
+static void EnterForward(void);
+static void EnterForwardRight(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -67,9 +73,54 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static TapeFollowingSubSubHSMState_t CurrentState = InitPSubSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubSubState; // a TapeFollowingSubSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below. */
+static const HSM_Transition_t InitPSubSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+};
+
+static const HSM_Transition_t BackUpRightTransitions[] = {
+    {ES_TIMEOUT, SUB_SUB_TRANSITION_TIMER, Forward, NULL, NULL},
+    {BC_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, Forward, NULL, NULL},
+};
+
+static const HSM_Transition_t ForwardTransitions[] = {
+    {ES_TIMEOUT, SUB_SUB_TRANSITION_TIMER, ForwardRight, NULL, NULL},
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+    {FR_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+};
+
+static const HSM_Transition_t ForwardRightTransitions[] = {
+    {FL_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+    {FR_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, BackUpRight, NULL, NULL},
+};
+
+static const HSM_State_t States[] = {
+    [InitPSubSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [Forward] =
+    {EnterForward, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT)},
+    [ForwardRight] =
+    {EnterForwardRight, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardRightTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(FL_TAPE_SEE_BLACK_EVENT) | HSM_EVENT(FR_TAPE_SEE_BLACK_EVENT)},
+    [BackUpRight] =
+    {EnterBackUpRight, NULL, NULL, NULL, HSM_TRANSITIONS(BackUpRightTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT)},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t TapeFollowingSubSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
+
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                            *
@@ -89,6 +140,9 @@ uint8_t InitTapeFollowingSubSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubSubState;
+    if (HSM_Verify(&TapeFollowingSubSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunTapeFollowingSubSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -112,88 +166,8 @@ uint8_t InitTapeFollowingSubSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunTapeFollowingSubSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    TapeFollowingSubSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubSubState: // If current state is initial Psedudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                
-                nextState = BackUpRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT; 
-            }
-            break;
-
-        case BackUpRight:
-            if (ThisEvent.EventType == ES_ENTRY){
-               TurnSharpRight(-100); 
-               ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, BACK_UP_TICKS);
-            }
-            
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_SUB_TRANSITION_TIMER)) {
-                
-                nextState = Forward;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT)){
-                nextState = Forward;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case Forward: // in the first state, replace this with correct names
-            if (ThisEvent.EventType == ES_ENTRY){
-                DriveStraight(100);
-                ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, TAPE_FOLLOWING_FWRD_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_SUB_TRANSITION_TIMER)) {
-                nextState = ForwardRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                nextState = BackUpRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case ForwardRight:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnNormalRight(100);
-                ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, TAPE_FOLLOWING_FWRD_RIGHT_TICKS);
-            }
-            if ((ThisEvent.EventType == FL_TAPE_SEE_BLACK_EVENT) ||
-                (ThisEvent.EventType == FR_TAPE_SEE_BLACK_EVENT)) {
-                nextState = BackUpRight;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunTapeFollowingSubSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunTapeFollowingSubSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&TapeFollowingSubSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -203,3 +177,17 @@ ES_Event RunTapeFollowingSubSubHSM(ES_Event ThisEvent) {
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+static void EnterBackUpRight(void) {
+    TurnSharpRight(-100);
+    ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, BACK_UP_TICKS);
+}
+
+static void EnterForward(void) {
+    DriveStraight(100);
+    ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, TAPE_FOLLOWING_FWRD_TICKS);
+}
+
+static void EnterForwardRight(void) {
+    TurnNormalRight(100);
+    ES_Timer_InitTimer(SUB_SUB_TRANSITION_TIMER, TAPE_FOLLOWING_FWRD_RIGHT_TICKS);
+}
@@ -0,0 +1,52 @@
+/*
+ * File:   TestHarness.h
+ *
+ * What the module test harnesses (the XXX_TEST builds) share. They run on the
+ * Uno32 or on a PC against the HW_Regs register file, so the same checks and
+ * the same random sequence come out of both.
+ *
+ * Include it inside the harness's #ifdef, after setting TEST_HARNESS_SEED if
+ * the default sequence will not do:
+ *   TestHarness_Random(range) is a seeded LCG, 0 to range - 1.
+ *   TEST_HARNESS_END() goes at the end of main. On the Uno32 there is nothing to
+ *   return to, so it holds there with the output on the serial port; on a PC it
+ *   does nothing and main returns.
+ */
+
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+#ifndef TEST_HARNESS_SEED
+#define TEST_HARNESS_SEED 1
+#endif
+
+#ifdef __PIC32MX__
+#define TEST_HARNESS_END() while (1)
+#else
+#define TEST_HARNESS_END()
+#endif
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+static uint32_t TestHarnessSeed = TEST_HARNESS_SEED;
+
+/**
+ * @Function TestHarness_Random(uint32_t range)
+ * @param range - how many values to pick from
+ * @return the next value of the harness's sequence, 0 to range - 1
+ */
+static inline uint32_t TestHarness_Random(uint32_t range)
+{
+    TestHarnessSeed = TestHarnessSeed * 1103515245 + 12345;
+    return (TestHarnessSeed >> 8) % range;
+}
+
+#endif /* TEST_HARNESS_H */
@@ -0,0 +1,223 @@
+/*
+ * File:   TimerWheel.c
+ *
+ * Hashed timing wheel software timers, see TimerWheel.h.
+ */
+
+#include "BOARD.h"
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "TimerWheel.h"
+
+/*******************************************************************************
+ * PRIVATE #DEFINES                                                            *
+ ******************************************************************************/
+//#define TIMER_WHEEL_TEST
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_ROUNDS 0xFFFF
+
+/*******************************************************************************
+ * PRIVATE FUNCTION PROTOTYPES                                                 *
+ ******************************************************************************/
+
+static void Unlink(TimerWheel_Timer_t *timer);
+
+/*******************************************************************************
+ * PRIVATE MODULE VARIABLES                                                    *
+ ******************************************************************************/
+
+// the running timers, by the slot they expire in
+static TimerWheel_Timer_t *Slots[TIMER_WHEEL_SLOTS];
+// milliseconds the wheel has turned, and the time it last turned to
+static uint32_t Cursor;
+static uint32_t LastTime;
+static uint8_t Updated = FALSE;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                            *
+ ******************************************************************************/
+
+void TimerWheel_Init(TimerWheel_Timer_t *timer, uint8_t id, uint8_t (*post)(ES_Event ThisEvent))
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->rounds = 0;
+    timer->slot = 0;
+    timer->id = id;
+    timer->generation = 0;
+    timer->post = post;
+}
+
+void TimerWheel_Start(TimerWheel_Timer_t *timer, uint32_t ticks)
+{
+    TimerWheel_Timer_t **head;
+
+    Unlink(timer);
+    timer->generation++;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    ticks--;
+    timer->rounds = (ticks / TIMER_WHEEL_SLOTS > MAX_ROUNDS) ? MAX_ROUNDS : ticks / TIMER_WHEEL_SLOTS;
+    timer->slot = (Cursor + 1 + ticks) & SLOT_MASK;
+    head = &Slots[timer->slot];
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+void TimerWheel_Stop(TimerWheel_Timer_t *timer)
+{
+    Unlink(timer);
+    timer->generation++;
+}
+
+uint8_t TimerWheel_IsCurrent(const TimerWheel_Timer_t *timer, ES_Event ThisEvent)
+{
+    return (ThisEvent.EventType == ES_TIMEOUT) &&
+            (ThisEvent.EventParam == TIMER_WHEEL_PARAM(timer->id, timer->generation));
+}
+
+uint8_t TimerWheel_Update(uint32_t now)
+{
+    TimerWheel_Timer_t *timer;
+    TimerWheel_Timer_t *next;
+    ES_Event ThisEvent;
+    uint32_t elapsed;
+    uint8_t expired = FALSE;
+
+    // timers started before the first update count from it
+    if (Updated == FALSE) {
+        LastTime = now;
+        Updated = TRUE;
+    }
+    ThisEvent.EventType = ES_TIMEOUT;
+    for (elapsed = now - LastTime; elapsed > 0; elapsed--) {
+        Cursor++;
+        for (timer = Slots[Cursor & SLOT_MASK]; timer != NULL; timer = next) {
+            next = timer->next;
+            if (timer->rounds > 0) {
+                timer->rounds--;
+                continue;
+            }
+            Unlink(timer);
+            ThisEvent.EventParam = TIMER_WHEEL_PARAM(timer->id, timer->generation);
+            timer->post(ThisEvent);
+            expired = TRUE;
+        }
+    }
+    LastTime = now;
+    return expired;
+}
+
+/*******************************************************************************
+ * PRIVATE FUNCTIONS                                                           *
+ ******************************************************************************/
+
+static void Unlink(TimerWheel_Timer_t *timer)
+{
+    if (timer->pprev == NULL) {
+        return;
+    }
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/*******************************************************************************
+ * TEST HARNESS                                                                *
+ ******************************************************************************/
+#ifdef TIMER_WHEEL_TEST
+
+#include <stdio.h>
+#define TEST_HARNESS_SEED 12345
+#include "TestHarness.h"
+
+// Starts, restarts and stops a crowd of timers at random for a simulated stretch
+// of time, with the clock jumping ahead by up to TEST_LONGEST_JUMP now and then
+// like a slow pass through the event checkers, and checks each timeout against
+// a plain deadline kept for every timer. A jump can only make one late by the
+// length of the jump.
+#define TEST_TIMERS 40
+#define TEST_MILLISECONDS 200000UL
+#define TEST_LONGEST 2000
+#define TEST_LONGEST_JUMP 20
+
+static TimerWheel_Timer_t timers[TEST_TIMERS];
+static uint32_t deadline[TEST_TIMERS]; // 0 when stopped
+static uint32_t clock, fired, early, latest, stale, missed;
+
+static uint8_t CheckTimeout(ES_Event ThisEvent)
+{
+    uint8_t i = TIMER_WHEEL_ID(ThisEvent.EventParam) - TIMER_WHEEL_FIRST_ID;
+
+    if (TimerWheel_IsCurrent(&timers[i], ThisEvent) == FALSE) {
+        stale++;
+    } else if (clock < deadline[i]) {
+        early++;
+    } else if (clock - deadline[i] > latest) {
+        latest = clock - deadline[i];
+    }
+    deadline[i] = 0;
+    fired++;
+    return TRUE;
+}
+
+int main(void)
+{
+    uint32_t now, step, ticks, starts = 0, stops = 0;
+    uint8_t i;
+    ES_Event old;
+
+    BOARD_Init();
+    printf("\nTimerWheel test harness, %u timers, %lu ms", TEST_TIMERS, TEST_MILLISECONDS);
+    for (i = 0; i < TEST_TIMERS; i++) {
+        TimerWheel_Init(&timers[i], TIMER_WHEEL_FIRST_ID + i, CheckTimeout);
+    }
+    for (now = 1000; now < 1000 + TEST_MILLISECONDS; now += step) {
+        i = TestHarness_Random(TEST_TIMERS);
+        switch (TestHarness_Random(16)) {
+        case 0:
+            TimerWheel_Stop(&timers[i]);
+            deadline[i] = 0;
+            stops++;
+            break;
+        case 1:
+            ticks = 1 + TestHarness_Random(TEST_LONGEST);
+            TimerWheel_Start(&timers[i], ticks);
+            deadline[i] = now + ticks;
+            starts++;
+            break;
+        default:
+            break;
+        }
+        step = (TestHarness_Random(50) == 0) ? 1 + TestHarness_Random(TEST_LONGEST_JUMP) : 1;
+        clock = now + step;
+        TimerWheel_Update(clock);
+    }
+    for (i = 0; i < TEST_TIMERS; i++) {
+        missed += (deadline[i] != 0) && (deadline[i] < clock);
+    }
+    // a timeout from before a restart must not pass as the new one
+    TimerWheel_Start(&timers[0], 5);
+    old.EventType = ES_TIMEOUT;
+    old.EventParam = TIMER_WHEEL_PARAM(timers[0].id, timers[0].generation);
+    TimerWheel_Start(&timers[0], 5);
+    printf("\n%lu starts, %lu stops, %lu timeouts: %lu early, at most %lu ms late, %lu stale,"
+            " %lu missed", (unsigned long) starts, (unsigned long) stops, (unsigned long) fired,
+            (unsigned long) early, (unsigned long) latest, (unsigned long) stale,
+            (unsigned long) missed);
+    printf("\nrestarted timer's old timeout %s\n",
+            TimerWheel_IsCurrent(&timers[0], old) ? "taken, FAIL" : "dropped");
+    TEST_HARNESS_END();
+    return 0;
+}
+
+#endif // TIMER_WHEEL_TEST
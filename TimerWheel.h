@@ -0,0 +1,111 @@
+/*
+ * File:   TimerWheel.h
+ *
+ * Software timers on a hashed timing wheel, for when the 16 ES_Framework timers
+ * and their shared meanings (SUB_TRANSITION_TIMER for every sub-HSM) run out.
+ * A timer is a TimerWheel_Timer_t the user declares, so there can be as many as
+ * there is RAM for, each with a name from ES_Configure.h. Starting or stopping
+ * one is O(1), it is linked into or out of the list for the slot it expires in.
+ * TimerWheel_Update walks one slot per millisecond, and a timer further out
+ * than a turn of the wheel waits out the turns in that slot.
+ *
+ * Expiry posts ES_TIMEOUT to the timer's post function with the timer's name in
+ * the low byte of EventParam and its generation in the high byte. Every start
+ * and stop moves the generation on, so a timeout already queued when its timer
+ * was restarted or stopped can be told apart from the current one. The names
+ * start at TIMER_WHEEL_FIRST_ID, above the ES_Framework timer numbers, so the
+ * two never get mixed up.
+ *
+ * HSM_Engine states can own a timer. It is stopped when the state is exited,
+ * stale timeouts for it are dropped before the state sees them, and current
+ * ones reach the tables with just the name as EventParam.
+ *
+ * TIMER_WHEEL_TEST (in the .c file) conditionally compiles a test harness that
+ * checks every expiry against a plain list of deadlines.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "ES_Configure.h"   // defines ES_Event, INIT_EVENT, ENTRY_EVENT, and EXIT_EVENT
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                             *
+ ******************************************************************************/
+
+// slots in the wheel, one millisecond each, a power of two
+#define TIMER_WHEEL_SLOTS 64
+
+// lowest timer name, the ES_Framework timers are numbered below it
+#define TIMER_WHEEL_FIRST_ID 16
+
+// an expired timer's EventParam, and the parts of one
+#define TIMER_WHEEL_PARAM(id, generation) ((uint16_t) ((generation) << 8) | (id))
+#define TIMER_WHEEL_ID(param) ((param) & 0xFF)
+#define TIMER_WHEEL_GENERATION(param) ((param) >> 8)
+
+// a stopped timer as TimerWheel_Init leaves it, for one that has to have its
+// name before anything runs, like one an HSM_Engine state owns
+#define TIMER_WHEEL_TIMER(id, post) {NULL, NULL, 0, 0, (id), 0, (post)}
+
+/*******************************************************************************
+ * PUBLIC TYPEDEFS                                                             *
+ ******************************************************************************/
+
+typedef struct TimerWheel_Timer {
+    struct TimerWheel_Timer *next; // in the slot it expires in
+    struct TimerWheel_Timer **pprev; // what points at it, NULL when not running
+    uint16_t rounds; // turns of the wheel still to wait
+    uint8_t slot;
+    uint8_t id; // its name, TIMER_WHEEL_FIRST_ID or above
+    uint8_t generation; // moved on by every start and stop
+    uint8_t (*post)(ES_Event ThisEvent); // where ES_TIMEOUT goes
+} TimerWheel_Timer_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES                                                  *
+ ******************************************************************************/
+
+/**
+ * @Function TimerWheel_Init(TimerWheel_Timer_t *timer, uint8_t id, uint8_t (*post)(ES_Event))
+ * @param timer - the timer, stopped afterwards
+ * @param id - its name from ES_Configure.h
+ * @param post - the post function of the service its timeouts go to
+ * @return None.
+ */
+void TimerWheel_Init(TimerWheel_Timer_t *timer, uint8_t id, uint8_t (*post)(ES_Event ThisEvent));
+
+/**
+ * @Function TimerWheel_Start(TimerWheel_Timer_t *timer, uint32_t ticks)
+ * @param timer - the timer, restarted if it was running
+ * @param ticks - milliseconds from the last TimerWheel_Update, at least 1
+ * @return None.
+ */
+void TimerWheel_Start(TimerWheel_Timer_t *timer, uint32_t ticks);
+
+/**
+ * @Function TimerWheel_Stop(TimerWheel_Timer_t *timer)
+ * @param timer - the timer, running or not
+ * @return None.
+ * @brief Stops it, and makes any timeout of it still in a queue stale.
+ */
+void TimerWheel_Stop(TimerWheel_Timer_t *timer);
+
+/**
+ * @Function TimerWheel_IsCurrent(const TimerWheel_Timer_t *timer, ES_Event ThisEvent)
+ * @param timer - a timer
+ * @param ThisEvent - an event its service was run with
+ * @return TRUE if it is the timeout of the timer's latest start, FALSE for
+ *         any other event, including an older timeout of the same timer
+ */
+uint8_t TimerWheel_IsCurrent(const TimerWheel_Timer_t *timer, ES_Event ThisEvent);
+
+/**
+ * @Function TimerWheel_Update(uint32_t now)
+ * @param now - the time in milliseconds, ES_Timer_GetTime()
+ * @return TRUE if any timer expired
+ * @brief Expires the timers due up to now, posting their timeouts.
+ */
+uint8_t TimerWheel_Update(uint32_t now);
+
+#endif /* TIMER_WHEEL_H */
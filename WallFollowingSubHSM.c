@@ -32,6 +32,8 @@
 #include "BOARD.h"
 #include "ProjectHSM.h"
 #include "WallFollowingSubHSM.h"
+#include "Bot.h"
+#include "HSM_Engine.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -74,6 +76,7 @@ static const char *StateNames[] = {
 	"TrackWallHardLeft3",
 	"WallFound",
 };
+STATE_STATS_DECLARE(Stats, "WallFollowingSubHSM", StateNames);
 
 //Include any defines you need to do
 //was 375 - 6:50pm
@@ -95,11 +98,27 @@ static const char *StateNames[] = {
 #define WALL_ONE_FORWARD_TICKS 140
 #define WALL_ONE_BACK_UP_TICKS 300
 
+//bumps along the wall with a track wire reading each, the first and last averaged
+#define TRACK_WIRE_READS 8
+
 /*******************************************************************************
  * PRIVATE FUNCTION PROTOTYPES                                                 *
  ******************************************************************************/
 /* Prototypes for private functions for this machine. They should be functions
    relevant to the behavior of this state machine */
+static void StartFollowing(ES_Event *ThisEvent);
+static uint8_t MoreReadsToTake(const ES_Event *ThisEvent);
+static void TakeTrackWireRead(ES_Event *ThisEvent);
+static uint8_t TrackWireFound(const ES_Event *ThisEvent);
+static void ReportCorrectWall(ES_Event *ThisEvent);
+static void ResetTrackWireReads(void);
+static void EnterBackUpLeft(void);
+static void EnterForwardLeft(void);
+static void EnterWallHardLeft(void);
+static void EnterCornerHardLeft(void);
+static void EnterTrackBackUpLeft1(void);
+static void EnterTrackForwardLeft1(void);
+static void EnterTrackWallHardLeft1(void);
 
 /*******************************************************************************
  * PRIVATE MODULE VARIABLES                                                            *
@@ -107,20 +126,130 @@ static const char *StateNames[] = {
 /* You will need MyPriority and the state variable; you may need others as well.
  * The type of state variable should match that of enum in header file. */
 
-static WallFollowingSubHSMState_t CurrentState = InitPSubState; // <- change name to match ENUM
+static uint8_t CurrentState = InitPSubState; // a WallFollowingSubHSMState_t, HSM_Run moves it
 static uint8_t MyPriority;
 static int wireCounter = 0;
 
-static int TrackWireReadOne;
-static int TrackWireReadTwo;
-static int TrackWireReadThree;
-static int TrackWireReadFour;
-static int TrackWireReadFive;
-static int TrackWireReadSix;
-static int TrackWireReadSeven;
-static int TrackWireReadEight;
+static int TrackWireReads[TRACK_WIRE_READS];
 static int TrackWireReadAverage;
-static int StateCount;
+static int StateCount; // reads taken since the last corner or back up
+static const char *ReadNames[TRACK_WIRE_READS] = {
+    "One", "Two", "Three", "Four", "Five", "Six", "Seven", "Eight"
+};
+
+/* The machine as tables for HSM_Engine, one row per transition, kept sorted by
+ * event as ordered in ES_Configure.h. What each state does on the way in is in
+ * its Enter function below.
+ *
+ * Along the wall after a corner every bump takes a track wire reading and backs
+ * up for another, the rows for a bump are tried in order: the first seven reads
+ * go back to TrackBackUpLeft1, the eighth decides between reporting the correct
+ * wall to ProjectHSM and starting over from BackUpLeft. */
+#define BUMP_ROWS(bump) \
+    {bump, HSM_ANY_PARAM, TrackBackUpLeft1, MoreReadsToTake, TakeTrackWireRead}, \
+    {bump, HSM_ANY_PARAM, HSM_NO_TARGET, TrackWireFound, ReportCorrectWall}, \
+    {bump, HSM_ANY_PARAM, BackUpLeft, NULL, NULL}
+
+static const HSM_Transition_t InitPSubStateTransitions[] = {
+    {ES_INIT, HSM_ANY_PARAM, BackUpLeft, NULL, StartFollowing},
+};
+
+static const HSM_Transition_t BackUpLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, ForwardLeft, NULL, NULL},
+    {BC_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, ForwardLeft, NULL, NULL},
+};
+
+static const HSM_Transition_t ForwardLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, WallHardLeft, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+};
+
+static const HSM_Transition_t WallHardLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, CornerHardLeft, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, BackUpLeft, NULL, NULL},
+};
+
+static const HSM_Transition_t CornerHardLeftTransitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, TrackBackUpLeft1, NULL, NULL},
+    {FL_BUMP_EVENT, HSM_ANY_PARAM, TrackBackUpLeft1, NULL, NULL},
+    {FR_BUMP_EVENT, HSM_ANY_PARAM, TrackBackUpLeft1, NULL, NULL},
+    {FC_BUMP_EVENT, HSM_ANY_PARAM, TrackBackUpLeft1, NULL, NULL},
+};
+
+static const HSM_Transition_t TrackBackUpLeft1Transitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, TrackForwardLeft1, NULL, NULL},
+    {BC_TAPE_SEE_BLACK_EVENT, HSM_ANY_PARAM, TrackForwardLeft1, NULL, NULL},
+};
+
+static const HSM_Transition_t TrackForwardLeft1Transitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, TrackWallHardLeft1, NULL, NULL},
+    BUMP_ROWS(FL_BUMP_EVENT),
+    BUMP_ROWS(FR_BUMP_EVENT),
+    BUMP_ROWS(FC_BUMP_EVENT),
+};
+
+static const HSM_Transition_t TrackWallHardLeft1Transitions[] = {
+    {ES_TIMEOUT, SUB_TRANSITION_TIMER, CornerHardLeft, NULL, NULL},
+    BUMP_ROWS(FL_BUMP_EVENT),
+    BUMP_ROWS(FR_BUMP_EVENT),
+    BUMP_ROWS(FC_BUMP_EVENT),
+};
+
+#define BUMP_EVENTS (HSM_EVENT(FL_BUMP_EVENT) | HSM_EVENT(FR_BUMP_EVENT) | HSM_EVENT(FC_BUMP_EVENT))
+
+static const HSM_State_t States[] = {
+    [InitPSubState] =
+    {NULL, NULL, NULL, NULL, HSM_TRANSITIONS(InitPSubStateTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_INIT)},
+    [Forward] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [ForwardLeft] =
+    {EnterForwardLeft, NULL, NULL, NULL, HSM_TRANSITIONS(ForwardLeftTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | BUMP_EVENTS},
+    [WallHardLeft] =
+    {EnterWallHardLeft, NULL, NULL, NULL, HSM_TRANSITIONS(WallHardLeftTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | BUMP_EVENTS},
+    [CornerHardLeft] =
+    {EnterCornerHardLeft, NULL, NULL, NULL, HSM_TRANSITIONS(CornerHardLeftTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | BUMP_EVENTS},
+    [BackUpLeft] =
+    {EnterBackUpLeft, NULL, NULL, NULL, HSM_TRANSITIONS(BackUpLeftTransitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT)},
+    [TrackBackUpLeft1] =
+    {EnterTrackBackUpLeft1, NULL, NULL, NULL, HSM_TRANSITIONS(TrackBackUpLeft1Transitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | HSM_EVENT(BC_TAPE_SEE_BLACK_EVENT)},
+    [TrackBackUpLeft2] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [TrackBackUpLeft3] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [TrackForwardLeft1] =
+    {EnterTrackForwardLeft1, NULL, NULL, NULL, HSM_TRANSITIONS(TrackForwardLeft1Transitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | BUMP_EVENTS},
+    [TrackForwardLeft2] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [TrackForwardLeft3] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [TrackWallHardLeft1] =
+    {EnterTrackWallHardLeft1, NULL, NULL, NULL, HSM_TRANSITIONS(TrackWallHardLeft1Transitions), HSM_NO_STATE, 0,
+        HSM_EVENT(ES_TIMEOUT) | BUMP_EVENTS},
+    [TrackWallHardLeft2] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [TrackWallHardLeft3] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+    [WallFound] =
+    {NULL, NULL, NULL, NULL, HSM_NO_TRANSITIONS, HSM_NO_STATE, 0, 0},
+};
+
+//where each state's tables take each event, HSM_Verify fills them in
+static HSM_RowIndex_t Rows[sizeof(States) / sizeof(States[0])];
+
+const HSM_Machine_t WallFollowingSubHSM = {
+    States, sizeof(States) / sizeof(States[0]), &CurrentState, NULL, NULL, STATE_STATS_OF(Stats), Rows
+};
 
 
 /*******************************************************************************
@@ -141,6 +270,9 @@ uint8_t InitWallFollowingSubHSM(void) {
     ES_Event returnEvent;
 
     CurrentState = InitPSubState;
+    if (HSM_Verify(&WallFollowingSubHSM) == ERROR) {
+        return FALSE;
+    }
     returnEvent = RunWallFollowingSubHSM(INIT_EVENT);
     if (returnEvent.EventType == ES_NO_EVENT) {
         return TRUE;
@@ -164,566 +296,8 @@ uint8_t InitWallFollowingSubHSM(void) {
  * @author J. Edward Carryer, 2011.10.23 19:25
  * @author Gabriel H Elkaim, 2011.10.23 19:25 */
 ES_Event RunWallFollowingSubHSM(ES_Event ThisEvent) {
-    uint8_t makeTransition = FALSE; // use to flag transition
-    WallFollowingSubHSMState_t nextState; // <- change type to correct enum
-
     ES_Tattle(); // trace call stack
-
-    switch (CurrentState) {
-        case InitPSubState: // If current state is initial Pseudo State
-            if (ThisEvent.EventType == ES_INIT)// only respond to ES_Init
-            {
-                // this is where you would put any actions associated with the
-                // transition from the initial pseudo-state into the actual
-                // initial state
-
-                // now put the machine into the actual initial state
-                nextState = BackUpLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-                wireCounter = 0;
-            }
-            break;
-
-        case BackUpLeft:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnSharpLeft(-90);
-                
-                TrackWireReadOne = 0;
-                TrackWireReadTwo = 0;
-                TrackWireReadThree = 0;
-                TrackWireReadFour = 0;
-                TrackWireReadFive = 0;
-                TrackWireReadSix = 0;
-                TrackWireReadSeven = 0;
-                TrackWireReadAverage = 0;
-                TrackWireReadEight = 0;
-                StateCount = 0;
-
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_BACK_UP_LEFT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = ForwardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT)) {
-                nextState = ForwardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case ForwardLeft:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //TurnNormalLeft(100);
-                TurnNormalLeft(90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_FORWARD_LEFT_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = WallHardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                (ThisEvent.EventType == FC_BUMP_EVENT) ||
-                (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                nextState = BackUpLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case WallHardLeft:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnHardLeft(90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
-            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                (ThisEvent.EventType == FC_BUMP_EVENT) ||
-                (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                nextState = BackUpLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = CornerHardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-        case CornerHardLeft:
-            if (ThisEvent.EventType == ES_ENTRY) {
-                TurnHardLeft(90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORNER_HARD_LEFT_TICKS);
-                
-                TrackWireReadOne = 0;
-                TrackWireReadTwo = 0;
-                TrackWireReadThree = 0;
-                TrackWireReadFour = 0;
-                TrackWireReadFive = 0;
-                TrackWireReadSix = 0;
-                TrackWireReadSeven = 0;
-                TrackWireReadAverage = 0;
-                TrackWireReadEight = 0;
-                StateCount = 0;
-                
-                printf("\r\n\r\n");
-                printf("!!!!!!!!!!!!!!!!!!!!!!!!!!Corner!!!!!!!!!!!!!!!!!!!!!!!!!!");
-                printf("\r\n\r\n");
-            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                    (ThisEvent.EventType == FC_BUMP_EVENT) ||
-                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                nextState = TrackBackUpLeft1;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = TrackBackUpLeft1;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-
-            
-        case TrackBackUpLeft1:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnHardLeft(-90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_ONE_BACK_UP_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = TrackForwardLeft1;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-//            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT){
-//                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-//                nextState = WallFound;
-//                makeTransition = TRUE;
-//                printf("\r\n\r\n");
-//                printf("----------------------------------Track Wire-----------------------------------------");
-//                printf("\r\n\r\n");
-//                //ThisEvent.EventType = ES_NO_EVENT;
-//            }
-            if ((ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT)) {
-                nextState = TrackForwardLeft1;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-        case TrackForwardLeft1:
-            if (ThisEvent.EventType == ES_ENTRY){
-                //TurnNormalLeft(100);
-                TurnNormalLeft(90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_ONE_FORWARD_TICKS);
-            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = TrackWallHardLeft1;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-//            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-//                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-//                nextState = WallFound;
-//                makeTransition = TRUE;
-//                //ThisEvent.EventType = ES_NO_EVENT;
-//            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                (ThisEvent.EventType == FC_BUMP_EVENT) ||
-                (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                if (StateCount == 0) {
-                    TrackWireReadOne = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadOne: %d", TrackWireReadOne);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 1) {
-                    TrackWireReadTwo = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadTwo: %d", TrackWireReadTwo);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 2) {
-                    TrackWireReadThree = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadThree: %d", TrackWireReadThree);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 3) {
-                    TrackWireReadFour = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadFour: %d", TrackWireReadFour);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 4) {
-                    TrackWireReadFive = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadFive: %d", TrackWireReadFive);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 5) {
-                    TrackWireReadSix = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadSix: %d", TrackWireReadSix);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 6) {
-                    TrackWireReadSeven = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadSeven: %d", TrackWireReadSeven);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                }else if (StateCount == 7) {
-                    TrackWireReadEight = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadEight: %d", TrackWireReadEight);
-                    TrackWireReadAverage = (TrackWireReadOne + TrackWireReadEight)/2;
-                    
-                    printf("\r\n\r\n");
-                    printf("                 The value of TrackWireReadAverage (1 and 8) is: %d", TrackWireReadAverage);
-                    printf("\r\n\r\n");
-                    
-                    if (TrackWireReadAverage > TRACK_WIRE_THRESHOLD_NEW) {
-                        ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-                        //nextState = WallFound;
-                        makeTransition = TRUE;
-                    } else {
-                        nextState = BackUpLeft;
-                        makeTransition = TRUE;
-                        ThisEvent.EventType = ES_NO_EVENT;
-                    }
-                   
-                }
-              
-            }
-            break;
-
-        case TrackWallHardLeft1:
-            if (ThisEvent.EventType == ES_ENTRY){
-                TurnHardLeft(90);
-                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
-            }
-            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-                (ThisEvent.EventType == FC_BUMP_EVENT) ||
-                (ThisEvent.EventType == FR_BUMP_EVENT)) {
-                if (StateCount == 0) {
-                    TrackWireReadOne = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadOne: %d", TrackWireReadOne);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 1) {
-                    TrackWireReadTwo = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadTwo: %d", TrackWireReadTwo);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 2) {
-                    TrackWireReadThree = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadThree: %d", TrackWireReadThree);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 3) {
-                    TrackWireReadFour = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadFour: %d", TrackWireReadFour);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 4) {
-                    TrackWireReadFive = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadFive: %d", TrackWireReadFive);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 5) {
-                    TrackWireReadSix = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadSix: %d", TrackWireReadSix);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                } else if (StateCount == 6) {
-                    TrackWireReadSeven = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadSeven: %d", TrackWireReadSeven);
-                    
-                    StateCount++;
-                    nextState = TrackBackUpLeft1;
-                    makeTransition = TRUE;
-                    ThisEvent.EventType = ES_NO_EVENT;
-                }else if (StateCount == 7) {
-                    TrackWireReadEight = Bot_ReadTrackWireVoltage();
-                    printf("\r\n\r\n");
-                    printf("TrackWireReadEight: %d", TrackWireReadEight);
-                    TrackWireReadAverage = (TrackWireReadOne + TrackWireReadEight) / 2;
-                    
-                    printf("\r\n\r\n");
-                    printf("               The value of TrackWireReadAverage (1 and 8) is: %d", TrackWireReadAverage);
-                    printf("\r\n\r\n");
-                    
-                    if (TrackWireReadAverage > TRACK_WIRE_THRESHOLD_NEW) {
-                        ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-                        //nextState = WallFound;
-                        makeTransition = TRUE;
-                    } else {
-                        nextState = BackUpLeft;
-                        makeTransition = TRUE;
-                        ThisEvent.EventType = ES_NO_EVENT;
-                    }
-                   
-                }
-              
-            }
-//            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-//                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-//                nextState = WallFound;
-//                makeTransition = TRUE;
-//                //ThisEvent.EventType = ES_NO_EVENT;
-//            }
-            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-                nextState = CornerHardLeft;
-                makeTransition = TRUE;
-                ThisEvent.EventType = ES_NO_EVENT;
-            }
-            break;
-            
-//        case TrackBackUpLeft2:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnSharpLeft(-60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_BACK_UP_LEFT_TICKS);
-//            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = TrackForwardLeft2;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT){
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                nextState = WallFound;
-////                makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT)) {
-//                nextState = TrackForwardLeft2;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            break;
-//
-//        case TrackForwardLeft2:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnNormalLeft(60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_FORWARD_LEFT_TICKS);
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                nextState = WallFound;
-////                makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = TrackWallHardLeft2;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FC_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-//                nextState = TrackBackUpLeft3;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            break;
-//
-//        case TrackWallHardLeft2:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnHardLeft(60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
-//            }
-//            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FC_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-//                nextState = TrackBackUpLeft3;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                //nextState = WallFound;
-////                //makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = CornerHardLeft;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            break;
-//        case TrackBackUpLeft3:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnSharpLeft(-60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_BACK_UP_LEFT_TICKS);
-//            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = TrackForwardLeft3;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT){
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                nextState = WallFound;
-////                makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == BC_TAPE_SEE_BLACK_EVENT)) {
-//                nextState = TrackForwardLeft3;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            break;
-//
-//        case TrackForwardLeft3:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnNormalLeft(60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_FORWARD_LEFT_TICKS);
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                nextState = WallFound;
-////                makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = TrackWallHardLeft3;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FC_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-//                if (Bot_ReadTrackWireVoltage() > TRACK_WIRE_THRESHOLD_NEW) {
-//                    ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-//                    //nextState = WallFound;
-//                    makeTransition = TRUE;
-//                    
-//                } else {
-//                    nextState = BackUpLeft;
-//                    makeTransition = TRUE;
-//                    ThisEvent.EventType = ES_NO_EVENT;
-//                }
-//            }
-//            break;
-//
-//        case TrackWallHardLeft3:
-//            if (ThisEvent.EventType == ES_ENTRY) {
-//                TurnHardLeft(60);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
-//            }
-//            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FC_BUMP_EVENT) ||
-//                    (ThisEvent.EventType == FR_BUMP_EVENT)) {
-//                
-//                if (Bot_ReadTrackWireVoltage() > TRACK_WIRE_THRESHOLD_NEW) {
-//                    ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-//                    //nextState = WallFound;
-//                    makeTransition = TRUE;
-//                    
-//                } else {
-//                    nextState = BackUpLeft;
-//                    makeTransition = TRUE;
-//                    ThisEvent.EventType = ES_NO_EVENT;
-//                }
-//                    
-//            }
-////            if (ThisEvent.EventType == TRACK_WIRE_FOUND_EVENT) {
-////                ThisEvent.EventType = CORRECT_WALL_DETECTED_EVENT;
-////                nextState = WallFound;
-////                makeTransition = TRUE;
-////            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == SUB_TRANSITION_TIMER)) {
-//                nextState = CornerHardLeft;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }    
-//            break;
-            
-//        case WallFound:
-//            if (ThisEvent.EventType == ES_ENTRY){
-//                ThisEvent.EventType == CORRECT_WALL_DETECTED_EVENT;
-//                DriveStraight(0);
-//                ES_Timer_InitTimer(TOP_TRANSITION_TIMER, 100);
-//            }
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == TOP_TRANSITION_TIMER)){
-//                ThisEvent.EventType == CORRECT_WALL_DETECTED_EVENT;
-//            }
-//            break;
-            //        case Forward: // in the first state, replace this with correct names
-//            if (ThisEvent.EventType == ES_ENTRY){
-//                DriveStraight(100);
-//                ES_Timer_InitTimer(SUB_TRANSITION_TIMER, QUARTER_SECOND_TICKS);
-//            }
-//            
-//            if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == 2)) {
-//                nextState = ForwardLeft;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            if ((ThisEvent.EventType == FL_BUMP_EVENT) ||
-//                (ThisEvent.EventType == FC_BUMP_EVENT) ||
-//                (ThisEvent.EventType == FR_BUMP_EVENT)) {
-//                nextState = BackUpLeft;
-//                makeTransition = TRUE;
-//                ThisEvent.EventType = ES_NO_EVENT;
-//            }
-//            break;
-        default: // all unhandled states fall into here
-            break;
-    } // end switch on Current State
-
-    if (makeTransition == TRUE) { // making a state transition, send EXIT and ENTRY
-        // recursively call the current state with an exit event
-        RunWallFollowingSubHSM(EXIT_EVENT); // <- rename to your own Run function
-        CurrentState = nextState;
-        RunWallFollowingSubHSM(ENTRY_EVENT); // <- rename to your own Run function
-    }
-
+    ThisEvent = HSM_Run(&WallFollowingSubHSM, ThisEvent);
     ES_Tail(); // trace call stack end
     return ThisEvent;
 }
@@ -733,3 +307,91 @@ ES_Event RunWallFollowingSubHSM(ES_Event ThisEvent) {
  * PRIVATE FUNCTIONS                                                           *
  ******************************************************************************/
 
+static void StartFollowing(ES_Event *ThisEvent) {
+    wireCounter = 0;
+}
+
+static uint8_t MoreReadsToTake(const ES_Event *ThisEvent) {
+    return StateCount < (TRACK_WIRE_READS - 1);
+}
+
+static void TakeTrackWireRead(ES_Event *ThisEvent) {
+    TrackWireReads[StateCount] = Bot_ReadTrackWireVoltage();
+    printf("\r\n\r\n");
+    printf("TrackWireRead%s: %d", ReadNames[StateCount], TrackWireReads[StateCount]);
+
+    StateCount++;
+}
+
+/* Takes the last read itself: the rows for a bump only get here once the others
+ * are in, and the bump goes on to BackUpLeft if the average is too low. */
+static uint8_t TrackWireFound(const ES_Event *ThisEvent) {
+    TrackWireReads[TRACK_WIRE_READS - 1] = Bot_ReadTrackWireVoltage();
+    printf("\r\n\r\n");
+    printf("TrackWireReadEight: %d", TrackWireReads[TRACK_WIRE_READS - 1]);
+    TrackWireReadAverage = (TrackWireReads[0] + TrackWireReads[TRACK_WIRE_READS - 1]) / 2;
+
+    printf("\r\n\r\n");
+    printf("               The value of TrackWireReadAverage (1 and 8) is: %d", TrackWireReadAverage);
+    printf("\r\n\r\n");
+
+    return TrackWireReadAverage > TRACK_WIRE_THRESHOLD_NEW;
+}
+
+//an internal transition, ProjectHSM leaves WallFollowing on the event it hands back
+static void ReportCorrectWall(ES_Event *ThisEvent) {
+    ThisEvent->EventType = CORRECT_WALL_DETECTED_EVENT;
+}
+
+static void ResetTrackWireReads(void) {
+    uint8_t i;
+
+    for (i = 0; i < TRACK_WIRE_READS; i++) {
+        TrackWireReads[i] = 0;
+    }
+    TrackWireReadAverage = 0;
+    StateCount = 0;
+}
+
+static void EnterBackUpLeft(void) {
+    TurnSharpLeft(-90);
+    ResetTrackWireReads();
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_BACK_UP_LEFT_TICKS);
+}
+
+static void EnterForwardLeft(void) {
+    //TurnNormalLeft(100);
+    TurnNormalLeft(90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_FOLLOW_FORWARD_LEFT_TICKS);
+}
+
+static void EnterWallHardLeft(void) {
+    TurnHardLeft(90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
+}
+
+static void EnterCornerHardLeft(void) {
+    TurnHardLeft(90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, CORNER_HARD_LEFT_TICKS);
+    ResetTrackWireReads();
+
+    printf("\r\n\r\n");
+    printf("!!!!!!!!!!!!!!!!!!!!!!!!!!Corner!!!!!!!!!!!!!!!!!!!!!!!!!!");
+    printf("\r\n\r\n");
+}
+
+static void EnterTrackBackUpLeft1(void) {
+    TurnHardLeft(-90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_ONE_BACK_UP_TICKS);
+}
+
+static void EnterTrackForwardLeft1(void) {
+    //TurnNormalLeft(100);
+    TurnNormalLeft(90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_ONE_FORWARD_TICKS);
+}
+
+static void EnterTrackWallHardLeft1(void) {
+    TurnHardLeft(90);
+    ES_Timer_InitTimer(SUB_TRANSITION_TIMER, WALL_HARD_LEFT_TICKS);
+}